@@ -0,0 +1,774 @@
+#include "agent.hpp"
+#include "json.hpp"
+#include <openssl/crypto.h>
+#include <algorithm>
+#include <thread>
+#include <iostream>
+#include <stdexcept>
+#include <cerrno>
+#include <cstring>
+#include <cstdlib>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#ifdef __linux__
+#include <sys/epoll.h>
+#endif
+#include <fcntl.h>
+#include <unistd.h>
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0 // Callers ignore SIGPIPE instead
+#endif
+
+namespace Vault {
+
+namespace {
+    const size_t MAX_DEFAULT_THREADS = 4;
+    const int EVENTS_PER_WAIT = 16;
+    const size_t READ_CHUNK = 16 * 1024;
+
+    // epoll tags for the two descriptors that are not client connections
+    char LISTEN_TAG;
+    char WAKE_TAG;
+
+    void appendU32(std::string& out, uint32_t value) {
+        char bytes[4] = {static_cast<char>(value), static_cast<char>(value >> 8),
+                         static_cast<char>(value >> 16), static_cast<char>(value >> 24)};
+        out.append(bytes, 4);
+    }
+
+    uint32_t readU32(const char* data) {
+        const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data);
+        return bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | (static_cast<uint32_t>(bytes[3]) << 24);
+    }
+
+    void wipe(std::string& buffer) {
+        if (!buffer.empty()) OPENSSL_cleanse(&buffer[0], buffer.size());
+        buffer.clear();
+    }
+
+    bool readExact(int fd, char* out, size_t size) {
+        while (size > 0) {
+            ssize_t received = ::recv(fd, out, size, 0);
+            if (received < 0 && errno == EINTR) continue;
+            if (received <= 0) return false;
+            out += received;
+            size -= received;
+        }
+        return true;
+    }
+
+    bool sendAll(int fd, const char* data, size_t size) {
+        while (size > 0) {
+            ssize_t sent = ::send(fd, data, size, MSG_NOSIGNAL);
+            if (sent < 0) {
+                if (errno == EINTR) continue;
+                return false;
+            }
+            data += sent;
+            size -= sent;
+        }
+        return true;
+    }
+
+    // Read one frame body of at most `limit` bytes
+    bool readFrame(int fd, std::string& body, uint32_t limit) {
+        char header[4];
+        if (!readExact(fd, header, sizeof(header))) return false;
+        uint32_t length = readU32(header);
+        if (length > limit) return false;
+        body.resize(length);
+        return length == 0 || readExact(fd, &body[0], length);
+    }
+
+    // Patch the length of the frame that starts at `frameStart`
+    void finishFrame(std::string& out, size_t frameStart) {
+        uint32_t length = out.size() - frameStart - 4;
+        for (int i = 0; i < 4; ++i) {
+            out[frameStart + i] = static_cast<char>(length >> (8 * i));
+        }
+    }
+
+    // Send as much of `out` as the socket takes without blocking, and drop
+    // what was sent; false on a broken connection
+    bool sendSome(int fd, std::string& out) {
+        size_t sent = 0;
+        while (sent < out.size()) {
+            ssize_t written = ::send(fd, out.data() + sent, out.size() - sent, MSG_NOSIGNAL);
+            if (written >= 0) {
+                sent += written;
+            } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            } else if (errno != EINTR) {
+                return false;
+            }
+        }
+        if (sent > 0) {
+            OPENSSL_cleanse(&out[0], sent);
+            out.erase(0, sent);
+        }
+        return true;
+    }
+
+    // `frame` starts with four placeholder bytes for the length
+    bool sendFrame(int fd, std::string& frame) {
+        finishFrame(frame, 0);
+        return sendAll(fd, frame.data(), frame.size());
+    }
+
+    bool peerIsSelf(int fd) {
+        uid_t uid;
+#ifdef SO_PEERCRED
+        struct ucred cred;
+        socklen_t length = sizeof(cred);
+        if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &length) != 0) return false;
+        uid = cred.uid;
+#else
+        gid_t gid;
+        if (getpeereid(fd, &uid, &gid) != 0) return false;
+#endif
+        return uid == geteuid();
+    }
+
+    bool makeAddress(const std::string& path, sockaddr_un& address) {
+        std::memset(&address, 0, sizeof(address));
+        address.sun_family = AF_UNIX;
+        if (path.empty() || path.size() >= sizeof(address.sun_path)) {
+            errno = ENAMETOOLONG;
+            return false;
+        }
+        std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+        return true;
+    }
+
+    int connectTo(const std::string& path) {
+        sockaddr_un address;
+        if (!makeAddress(path, address)) return -1;
+        int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0) return -1;
+        fcntl(fd, F_SETFD, FD_CLOEXEC);
+        if (::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+            int error = errno;
+            ::close(fd);
+            errno = error;
+            return -1;
+        }
+        return fd;
+    }
+}
+
+std::string defaultAgentSocketPath() {
+    if (const char* path = std::getenv("SPM_AGENT_SOCKET")) {
+        if (*path) return path;
+    }
+    if (const char* runtimeDir = std::getenv("XDG_RUNTIME_DIR")) {
+        if (*runtimeDir) return std::string(runtimeDir) + "/password_manager-agent.sock";
+    }
+    return "/tmp/password_manager-agent-" + std::to_string(geteuid()) + ".sock";
+}
+
+// AgentServer Implementation
+struct AgentServer::Connection {
+    int fd;
+    std::string input;      // Received bytes; unanswered requests start at `consumed`
+    size_t consumed = 0;
+    std::string output;     // Responses not yet sent
+    std::mutex mutex;       // Held by whichever thread owns the connection
+
+    explicit Connection(int socket) : fd(socket) {}
+};
+
+AgentServer::AgentServer(PasswordManager& vault, std::string socketPath,
+                         std::chrono::seconds idleTimeout, size_t threads)
+    : vault(vault), socketPath(std::move(socketPath)), idleTimeout(idleTimeout),
+      threadCount(threads), listenFd(-1), epollFd(-1), wakeFds{-1, -1}, stopping(false),
+      lastRequest(0), writerStopping(false), requests(0), changes(0), saves(0),
+      failures(0), recentRate(0) {
+    if (threadCount == 0) {
+        threadCount = std::min<size_t>(MAX_DEFAULT_THREADS,
+                                       std::max(1u, std::thread::hardware_concurrency()));
+    }
+}
+
+AgentServer::~AgentServer() {
+    std::vector<Connection*> open(connections.begin(), connections.end());
+    for (Connection* connection : open) {
+        closeConnection(connection);
+    }
+    if (listenFd >= 0) {
+        ::close(listenFd);
+        ::unlink(socketPath.c_str());
+    }
+    for (int fd : {epollFd, wakeFds[0], wakeFds[1]}) {
+        if (fd >= 0) ::close(fd);
+    }
+}
+
+void AgentServer::stop() {
+    if (wakeFds[1] >= 0) {
+        char byte = 0;
+        ssize_t ignored = ::write(wakeFds[1], &byte, 1);
+        (void)ignored;
+    }
+}
+
+void AgentServer::touch() {
+    lastRequest.store(std::chrono::steady_clock::now().time_since_epoch().count(),
+                      std::memory_order_relaxed);
+}
+
+std::string AgentServer::statsJson() const {
+    auto uptime = std::chrono::steady_clock::now() - started;
+    size_t clients;
+    {
+        std::lock_guard<std::mutex> guard(connectionsMutex);
+        clients = connections.size();
+    }
+
+    Json::Writer stats;
+    stats.add("uptime_s", static_cast<size_t>(std::chrono::duration_cast<std::chrono::seconds>(uptime).count()))
+         .add("threads", threadCount)
+         .add("clients", clients)
+         .add("requests", static_cast<size_t>(requests.load()))
+         .add("requests_per_s", static_cast<size_t>(recentRate.load()))
+         .add("changes", static_cast<size_t>(changes.load()))
+         .add("saves", static_cast<size_t>(saves.load()))
+         .add("failed", static_cast<size_t>(failures.load()))
+         .add("read_p50_ns", static_cast<size_t>(readLatency.percentile(0.50)))
+         .add("read_p99_ns", static_cast<size_t>(readLatency.percentile(0.99)))
+         .add("write_p50_ns", static_cast<size_t>(writeLatency.percentile(0.50)))
+         .add("write_p99_ns", static_cast<size_t>(writeLatency.percentile(0.99)));
+    Trace::addJson(stats);
+    return stats.finish();
+}
+
+#ifdef __linux__
+
+bool AgentServer::listen() {
+    sockaddr_un address;
+    if (!makeAddress(socketPath, address)) {
+        std::cerr << "Error starting agent: socket path too long: " << socketPath << std::endl;
+        return false;
+    }
+
+    // Replace a socket left behind by a dead agent, but nothing else
+    struct stat st;
+    if (::lstat(socketPath.c_str(), &st) == 0) {
+        if (!S_ISSOCK(st.st_mode) || st.st_uid != geteuid()) {
+            std::cerr << "Error starting agent: " << socketPath
+                      << " exists and is not our socket" << std::endl;
+            return false;
+        }
+        int probe = connectTo(socketPath);
+        if (probe >= 0) {
+            ::close(probe);
+            std::cerr << "Error starting agent: an agent is already running on "
+                      << socketPath << std::endl;
+            return false;
+        }
+        ::unlink(socketPath.c_str());
+    }
+
+    if (::pipe2(wakeFds, O_CLOEXEC | O_NONBLOCK) != 0 ||
+        (epollFd = ::epoll_create1(EPOLL_CLOEXEC)) < 0) {
+        std::cerr << "Error starting agent: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+
+    int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        std::cerr << "Error starting agent: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+
+    // Owner-only from the moment the socket appears
+    mode_t oldMask = ::umask(0177);
+    bool bound = ::bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0;
+    int error = errno;
+    ::umask(oldMask);
+    if (!bound || ::listen(fd, SOMAXCONN) != 0) {
+        if (bound) {
+            error = errno;
+            ::unlink(socketPath.c_str());
+        }
+        ::close(fd);
+        std::cerr << "Error starting agent: " << std::strerror(error) << std::endl;
+        return false;
+    }
+    listenFd = fd;
+
+    // The listener is one-shot like the clients so only one thread accepts
+    // at a time; the wake pipe is never drained, so it wakes every thread
+    epoll_event listening{};
+    listening.events = EPOLLIN | EPOLLONESHOT;
+    listening.data.ptr = &LISTEN_TAG;
+    epoll_event wake{};
+    wake.events = EPOLLIN;
+    wake.data.ptr = &WAKE_TAG;
+    if (::epoll_ctl(epollFd, EPOLL_CTL_ADD, listenFd, &listening) != 0 ||
+        ::epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFds[0], &wake) != 0) {
+        std::cerr << "Error starting agent: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void AgentServer::serve() {
+    if (listenFd < 0) {
+        vault.lock();
+        return;
+    }
+
+    started = std::chrono::steady_clock::now();
+    touch();
+    std::thread writer(&AgentServer::writerLoop, this);
+    std::vector<std::thread> workers;
+    for (size_t i = 1; i < threadCount; ++i) {
+        workers.emplace_back(&AgentServer::eventLoop, this, false);
+    }
+    eventLoop(true);
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    {
+        std::lock_guard<std::mutex> guard(writerMutex);
+        writerStopping = true;
+    }
+    writerWake.notify_one();
+    writer.join();
+
+    ::close(listenFd);
+    ::unlink(socketPath.c_str());
+    listenFd = -1;
+    std::vector<Connection*> open(connections.begin(), connections.end());
+    for (Connection* connection : open) {
+        closeConnection(connection);
+    }
+    vault.lock();
+}
+
+void AgentServer::eventLoop(bool supervising) {
+    using Clock = std::chrono::steady_clock;
+    epoll_event events[EVENTS_PER_WAIT];
+    uint64_t countedRequests = requests.load();
+    Clock::time_point countedAt = Clock::now();
+
+    while (!stopping.load(std::memory_order_relaxed)) {
+        int ready = ::epoll_wait(epollFd, events, EVENTS_PER_WAIT, 1000);
+        if (ready < 0 && errno != EINTR) break;
+
+        for (int i = 0; i < ready; ++i) {
+            void* tag = events[i].data.ptr;
+            if (tag == &WAKE_TAG) {
+                stopping = true;
+            } else if (tag == &LISTEN_TAG) {
+                acceptClients();
+            } else {
+                resume(static_cast<Connection*>(tag));
+            }
+        }
+
+        if (!supervising) continue;
+        // One thread keeps the clocks: the request rate over the last
+        // second, and the auto-lock
+        Clock::time_point now = Clock::now();
+        if (now - countedAt >= std::chrono::seconds(1)) {
+            uint64_t total = requests.load();
+            auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(now - countedAt);
+            recentRate = (total - countedRequests) * 1000000 / std::max<int64_t>(1, elapsed.count());
+            countedRequests = total;
+            countedAt = now;
+        }
+        Clock::time_point last{Clock::duration(lastRequest.load(std::memory_order_relaxed))};
+        if (now - last >= idleTimeout) {
+            stop();
+        }
+    }
+}
+
+void AgentServer::acceptClients() {
+    while (true) {
+        int fd = ::accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR) continue;
+            break;      // EAGAIN: nothing left; anything else: retry on the next event
+        }
+
+        Connection* connection = nullptr;
+        if (peerIsSelf(fd)) {
+            std::lock_guard<std::mutex> guard(connectionsMutex);
+            if (connections.size() < MAX_AGENT_CLIENTS) {
+                connection = new Connection(fd);
+                connections.insert(connection);
+            }
+        }
+        if (!connection) {
+            ::close(fd);
+            continue;
+        }
+
+        epoll_event event{};
+        event.events = EPOLLIN | EPOLLONESHOT;
+        event.data.ptr = connection;
+        if (::epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event) != 0) {
+            closeConnection(connection);
+        }
+    }
+
+    epoll_event listening{};
+    listening.events = EPOLLIN | EPOLLONESHOT;
+    listening.data.ptr = &LISTEN_TAG;
+    ::epoll_ctl(epollFd, EPOLL_CTL_MOD, listenFd, &listening);
+}
+
+bool AgentServer::arm(Connection* connection, uint32_t events) {
+    epoll_event event{};
+    event.events = events | EPOLLONESHOT;
+    event.data.ptr = connection;
+    return ::epoll_ctl(epollFd, EPOLL_CTL_MOD, connection->fd, &event) == 0;
+}
+
+void AgentServer::resume(Connection* connection) {
+    bool keep;
+    {
+        std::lock_guard<std::mutex> owner(connection->mutex);
+        keep = pump(connection);
+    }
+    if (!keep) closeConnection(connection);
+}
+
+void AgentServer::closeConnection(Connection* connection) {
+    ::epoll_ctl(epollFd, EPOLL_CTL_DEL, connection->fd, nullptr);
+    ::close(connection->fd);
+    wipe(connection->input);
+    wipe(connection->output);
+    {
+        std::lock_guard<std::mutex> guard(connectionsMutex);
+        connections.erase(connection);
+    }
+    delete connection;
+}
+
+bool AgentServer::pump(Connection* connection) {
+    using Clock = std::chrono::steady_clock;
+    std::string& input = connection->input;
+
+    while (true) {
+        // Answer every complete request received so far
+        while (input.size() - connection->consumed >= 4) {
+            const char* frame = input.data() + connection->consumed;
+            uint32_t length = readU32(frame);
+            if (length > MAX_AGENT_REQUEST) return false;
+            if (input.size() - connection->consumed - 4 < length) break;
+
+            std::string_view request(frame + 4, length);
+            connection->consumed += 4 + length;
+            Clock::time_point received = Clock::now();
+            requests.fetch_add(1, std::memory_order_relaxed);
+            touch();
+
+            AgentOp op = request.empty() ? AgentOp() : static_cast<AgentOp>(request[0]);
+            if (op == AgentOp::Put || op == AgentOp::Remove) {
+                // The writer answers it and carries on with this connection
+                {
+                    std::lock_guard<std::mutex> guard(writerMutex);
+                    writeQueue.push_back(WriteJob{connection, std::string(request), received});
+                }
+                writerWake.notify_one();
+                return true;
+            }
+
+            size_t frameStart = connection->output.size();
+            connection->output.append(4, '\0');
+            handleRead(request, connection->output);
+            finishFrame(connection->output, frameStart);
+            readLatency.record(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                Clock::now() - received).count());
+        }
+
+        if (connection->consumed > 0) {
+            OPENSSL_cleanse(&input[0], connection->consumed);
+            input.erase(0, connection->consumed);
+            connection->consumed = 0;
+        }
+
+        if (!sendSome(connection->fd, connection->output)) return false;
+        if (!connection->output.empty()) return arm(connection, EPOLLOUT);
+
+        size_t used = input.size();
+        input.resize(used + READ_CHUNK);
+        ssize_t received = ::recv(connection->fd, &input[used], READ_CHUNK, 0);
+        input.resize(used + std::max<ssize_t>(received, 0));
+        if (received > 0) continue;
+        if (received < 0 && errno == EINTR) continue;
+        return received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK) && arm(connection, EPOLLIN);
+    }
+}
+
+#else
+
+bool AgentServer::listen() {
+    std::cerr << "Error starting agent: the agent needs Linux (epoll)" << std::endl;
+    return false;
+}
+
+void AgentServer::serve() {
+    vault.lock();
+}
+
+void AgentServer::closeConnection(Connection* connection) {
+    delete connection;
+}
+
+void AgentServer::resume(Connection*) {}
+
+#endif // __linux__
+
+void AgentServer::handleRead(std::string_view request, std::string& response) {
+    std::string_view payload = request.empty() ? request : request.substr(1);
+    switch (request.empty() ? AgentOp() : static_cast<AgentOp>(request[0])) {
+        case AgentOp::Ping:
+            response.push_back(static_cast<char>(AgentStatus::Ok));
+            return;
+
+        case AgentOp::Get: {
+            std::string username;
+            Crypto::SecureString password;   // Wiped when it goes out of scope
+            bool found;
+            {
+                std::shared_lock<std::shared_mutex> shared(vaultMutex);
+                found = !payload.empty() && vault.readCredential(payload, username, password);
+            }
+            if (!found) {
+                response.push_back(static_cast<char>(AgentStatus::NotFound));
+                return;
+            }
+            response.push_back(static_cast<char>(AgentStatus::Ok));
+            appendU32(response, username.size());
+            response.append(username);
+            response.append(password.view());
+            return;
+        }
+
+        case AgentOp::List: {
+            response.push_back(static_cast<char>(AgentStatus::Ok));
+            std::shared_lock<std::shared_mutex> shared(vaultMutex);
+            vault.forEachCredential([&](const CredentialSummary& entry) {
+                appendU32(response, entry.service.size());
+                response.append(entry.service);
+            });
+            return;
+        }
+
+        case AgentOp::Stats:
+            response.push_back(static_cast<char>(AgentStatus::Ok));
+            response.append(statsJson());
+            return;
+
+        case AgentOp::Lock:
+            response.push_back(static_cast<char>(AgentStatus::Ok));
+            stopping = true;
+            stop();
+            return;
+
+        default:
+            response.push_back(static_cast<char>(AgentStatus::BadRequest));
+            return;
+    }
+}
+
+void AgentServer::writerLoop() {
+    using Clock = std::chrono::steady_clock;
+    std::deque<WriteJob> batch;
+    std::vector<AgentStatus> results;
+
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(writerMutex);
+            writerWake.wait(lock, [this] { return writerStopping || !writeQueue.empty(); });
+            if (writeQueue.empty()) return;
+            batch.swap(writeQueue);
+        }
+
+        // Everything that queued up while the previous batch was saving
+        // shares one transaction and one save
+        results.clear();
+        {
+            std::unique_lock<std::shared_mutex> exclusive(vaultMutex);
+            Transaction transaction(vault);
+            bool changed = false;
+            for (const WriteJob& job : batch) {
+                AgentStatus status = transaction.isActive() ? applyChange(job.request)
+                                                            : AgentStatus::Failed;
+                changed = changed || status == AgentStatus::Ok;
+                results.push_back(status);
+            }
+            if (changed) {
+                saves.fetch_add(1, std::memory_order_relaxed);
+                if (!transaction.commit()) {
+                    for (AgentStatus& status : results) {
+                        if (status == AgentStatus::Ok) status = AgentStatus::Failed;
+                    }
+                }
+            }
+        }
+
+        for (size_t i = 0; i < batch.size(); ++i) {
+            WriteJob& job = batch[i];
+            if (results[i] == AgentStatus::Ok) changes.fetch_add(1, std::memory_order_relaxed);
+            if (results[i] == AgentStatus::Failed) failures.fetch_add(1, std::memory_order_relaxed);
+
+            {
+                std::lock_guard<std::mutex> owner(job.connection->mutex);
+                std::string& output = job.connection->output;
+                size_t frameStart = output.size();
+                output.append(4, '\0');
+                output.push_back(static_cast<char>(results[i]));
+                finishFrame(output, frameStart);
+            }
+            writeLatency.record(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                Clock::now() - job.received).count());
+            wipe(job.request);
+            resume(job.connection);
+        }
+        batch.clear();
+    }
+}
+
+AgentStatus AgentServer::applyChange(std::string_view request) {
+    std::string_view payload = request.substr(1);
+    if (static_cast<AgentOp>(request[0]) == AgentOp::Remove) {
+        if (payload.empty()) return AgentStatus::BadRequest;
+        return vault.removeCredential(std::string(payload)) ? AgentStatus::Ok : AgentStatus::NotFound;
+    }
+
+    // Put: service and username are length-prefixed, the password is the rest
+    std::string_view fields[3];
+    for (int i = 0; i < 2; ++i) {
+        if (payload.size() < 4 || readU32(payload.data()) > payload.size() - 4) {
+            return AgentStatus::BadRequest;
+        }
+        fields[i] = payload.substr(4, readU32(payload.data()));
+        payload.remove_prefix(4 + fields[i].size());
+    }
+    fields[2] = payload;
+    if (fields[0].empty()) return AgentStatus::BadRequest;
+
+    std::string password(fields[2]);
+    bool added = vault.addCredential(std::string(fields[0]), std::string(fields[1]), password);
+    wipe(password);
+    return added ? AgentStatus::Ok : AgentStatus::Failed;
+}
+
+// AgentClient Implementation
+AgentClient::~AgentClient() {
+    if (fd >= 0) ::close(fd);
+}
+
+bool AgentClient::connect(const std::string& socketPath) {
+    if (fd >= 0) {
+        ::close(fd);
+        fd = -1;
+    }
+    int connected = connectTo(socketPath);
+    if (connected < 0) return false;
+
+    // A socket in a shared directory could belong to someone else
+    if (!peerIsSelf(connected)) {
+        ::close(connected);
+        errno = EPERM;
+        return false;
+    }
+    fd = connected;
+    return true;
+}
+
+AgentStatus AgentClient::request(AgentOp op, std::string_view payload, std::string& response) {
+    if (fd < 0) {
+        throw std::runtime_error("Not connected to an agent");
+    }
+
+    std::string frame(4, '\0');
+    frame.push_back(static_cast<char>(op));
+    frame.append(payload);
+    bool ok = sendFrame(fd, frame) && readFrame(fd, response, MAX_AGENT_RESPONSE);
+    wipe(frame);
+    if (!ok || response.empty()) {
+        throw std::runtime_error("Lost connection to the agent");
+    }
+
+    AgentStatus status = static_cast<AgentStatus>(response[0]);
+    response.erase(0, 1);
+    return status;
+}
+
+bool AgentClient::ping() {
+    std::string response;
+    return request(AgentOp::Ping, std::string_view(), response) == AgentStatus::Ok;
+}
+
+bool AgentClient::get(std::string_view service, std::string& username, std::string& password) {
+    std::string response;
+    if (request(AgentOp::Get, service, response) != AgentStatus::Ok) {
+        return false;
+    }
+    if (response.size() < 4 || readU32(response.data()) > response.size() - 4) {
+        wipe(response);
+        throw std::runtime_error("Malformed agent response");
+    }
+    uint32_t usernameLength = readU32(response.data());
+    username.assign(response, 4, usernameLength);
+    password.assign(response, 4 + usernameLength, std::string::npos);
+    wipe(response);
+    return true;
+}
+
+bool AgentClient::list(std::vector<std::string>& services) {
+    std::string response;
+    services.clear();
+    if (request(AgentOp::List, std::string_view(), response) != AgentStatus::Ok) {
+        return false;
+    }
+    size_t offset = 0;
+    while (offset < response.size()) {
+        size_t left = response.size() - offset;
+        if (left < 4 || readU32(response.data() + offset) > left - 4) {
+            throw std::runtime_error("Malformed agent response");
+        }
+        uint32_t length = readU32(response.data() + offset);
+        services.emplace_back(response, offset + 4, length);
+        offset += 4 + length;
+    }
+    return true;
+}
+
+AgentStatus AgentClient::put(std::string_view service, std::string_view username,
+                             std::string_view password) {
+    std::string payload;
+    appendU32(payload, service.size());
+    payload.append(service);
+    appendU32(payload, username.size());
+    payload.append(username);
+    payload.append(password);
+    std::string response;
+    AgentStatus status = request(AgentOp::Put, payload, response);
+    wipe(payload);
+    return status;
+}
+
+AgentStatus AgentClient::remove(std::string_view service) {
+    std::string response;
+    return request(AgentOp::Remove, service, response);
+}
+
+bool AgentClient::stats(std::string& json) {
+    return request(AgentOp::Stats, std::string_view(), json) == AgentStatus::Ok;
+}
+
+bool AgentClient::lock() {
+    std::string response;
+    return request(AgentOp::Lock, std::string_view(), response) == AgentStatus::Ok;
+}
+
+} // namespace Vault
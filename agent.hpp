@@ -0,0 +1,254 @@
+#ifndef AGENT_HPP
+#define AGENT_HPP
+
+#include "vault.hpp"
+#include "trace.hpp"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+#include <cstdint>
+
+namespace Vault {
+    /*
+     * Agent protocol: length-prefixed binary frames over a Unix domain
+     * socket. Every frame is a little-endian uint32 body length followed by
+     * the body. A request body is an AgentOp byte and its payload; a
+     * response body is an AgentStatus byte and its payload. Strings inside
+     * a payload are a uint32 length and the bytes, except for the last.
+     *   Ping   ()                            -> Ok ()
+     *   Get    (service)                     -> Ok (username, password)
+     *   List   ()                            -> Ok (uint32 length and name,
+     *                                           for every service)
+     *   Lock   ()                            -> Ok (), then the agent locks
+     *                                           the vault and exits
+     *   Put    (service, username, password) -> Ok (), once saved
+     *   Remove (service)                     -> Ok (), once saved
+     *   Stats  ()                            -> Ok (JSON object)
+     * A connection may pipeline requests; responses come back in order.
+     */
+    enum class AgentOp : uint8_t {
+        Ping = 1,
+        Get = 2,
+        List = 3,
+        Lock = 4,
+        Put = 5,
+        Remove = 6,
+        Stats = 7
+    };
+
+    enum class AgentStatus : uint8_t {
+        Ok = 0,
+        NotFound = 1,
+        BadRequest = 2,
+        Failed = 3      // The change could not be saved and was undone
+    };
+
+    const uint32_t MAX_AGENT_REQUEST = 64 * 1024;
+    const uint32_t MAX_AGENT_RESPONSE = 256 * 1024 * 1024;
+    const size_t MAX_AGENT_CLIENTS = 1024;
+
+    /**
+     * Socket the agent listens on: $SPM_AGENT_SOCKET if set, else
+     * password_manager-agent.sock in $XDG_RUNTIME_DIR, else a per-user
+     * name in /tmp
+     * @return Socket path
+     */
+    std::string defaultAgentSocketPath();
+
+    /**
+     * Serves an unlocked vault to many concurrent clients, so that a lookup
+     * costs a socket round trip and one decryption instead of a key
+     * derivation. Only processes running as the same user may connect.
+     *
+     * A fixed pool of threads waits on one epoll set; each connection is
+     * armed one-shot, so exactly one thread handles it at a time and
+     * requests are answered in order without a thread per client. Lookups
+     * run under a shared lock on the vault. Changes go to a single writer
+     * thread that applies whatever has queued up as one transaction with
+     * one save, and answers each request once its change is on disk.
+     *
+     * The agent locks the vault and stops after `idleTimeout` without
+     * requests, like the interactive auto-lock. Linux only (epoll).
+     */
+    class AgentServer {
+    public:
+        /**
+         * @param vault Unlocked vault; must outlive the server
+         * @param socketPath Socket to create
+         * @param idleTimeout Stop after this long without a request
+         * @param threads Threads serving connections, the caller of serve()
+         *        included (0 means one per hardware thread, at most 4)
+         */
+        AgentServer(PasswordManager& vault, std::string socketPath,
+                    std::chrono::seconds idleTimeout, size_t threads = 0);
+        ~AgentServer();
+
+        AgentServer(const AgentServer&) = delete;
+        AgentServer& operator=(const AgentServer&) = delete;
+
+        /**
+         * Create the socket, owner-only. A stale socket from an agent that
+         * died is replaced; a live one is not.
+         * @return true if listening
+         */
+        bool listen();
+
+        /**
+         * Serve requests until stop(), a Lock request or the idle timeout;
+         * the vault is locked on return
+         */
+        void serve();
+
+        /**
+         * Make serve() return. Safe to call from other threads and from
+         * signal handlers.
+         */
+        void stop();
+
+        /**
+         * Counters and latencies as a JSON object, as the Stats request
+         * returns them, followed by the vault's phase timings (trace.hpp)
+         * @return JSON text
+         */
+        std::string statsJson() const;
+
+    private:
+        struct Connection;
+
+        struct WriteJob {
+            Connection* connection;
+            std::string request;
+            std::chrono::steady_clock::time_point received;
+        };
+
+        // Wait for and handle events until stopping; the supervising
+        // thread also keeps the request rate and the idle timer
+        void eventLoop(bool supervising);
+        void acceptClients();
+        // Take ownership of a connection, pump it, and close it if needed
+        void resume(Connection* connection);
+        // Answer buffered requests and read more until a change goes to
+        // the writer, output backs up or input runs dry; then re-arm.
+        // Expects the connection's mutex held; false means close it.
+        bool pump(Connection* connection);
+        bool arm(Connection* connection, uint32_t events);
+        void closeConnection(Connection* connection);
+        void handleRead(std::string_view request, std::string& response);
+        void writerLoop();
+        AgentStatus applyChange(std::string_view request);
+        void touch();
+
+        PasswordManager& vault;
+        std::string socketPath;
+        std::chrono::seconds idleTimeout;
+        size_t threadCount;
+        int listenFd;
+        int epollFd;
+        int wakeFds[2];                     // Self-pipe that stop() writes to
+        std::atomic<bool> stopping;
+        std::atomic<int64_t> lastRequest;   // steady_clock ticks
+
+        std::shared_mutex vaultMutex;       // Shared for lookups, unique for changes
+
+        mutable std::mutex connectionsMutex;
+        std::unordered_set<Connection*> connections;
+
+        std::mutex writerMutex;
+        std::condition_variable writerWake;
+        std::deque<WriteJob> writeQueue;
+        bool writerStopping;
+
+        // Statistics
+        std::chrono::steady_clock::time_point started;
+        std::atomic<uint64_t> requests;
+        std::atomic<uint64_t> changes;
+        std::atomic<uint64_t> saves;
+        std::atomic<uint64_t> failures;
+        std::atomic<uint64_t> recentRate;   // Requests/s over the last second
+        Trace::LatencyHistogram readLatency;    // Request received to response ready
+        Trace::LatencyHistogram writeLatency;   // Request received to change saved
+    };
+
+    /**
+     * Client side of the agent protocol. Requests throw std::runtime_error
+     * if the connection fails mid-way.
+     */
+    class AgentClient {
+    public:
+        AgentClient() = default;
+        ~AgentClient();
+
+        AgentClient(const AgentClient&) = delete;
+        AgentClient& operator=(const AgentClient&) = delete;
+
+        /**
+         * Connect to an agent, refusing one run by another user
+         * @param socketPath Agent socket
+         * @return true if connected; errno describes a failure
+         */
+        bool connect(const std::string& socketPath);
+
+        /**
+         * @return true if the agent answered
+         */
+        bool ping();
+
+        /**
+         * Look up a credential
+         * @param service Service name
+         * @param username Receives the username
+         * @param password Receives the password
+         * @return true if found
+         */
+        bool get(std::string_view service, std::string& username, std::string& password);
+
+        /**
+         * @param services Receives every service name, sorted
+         * @return true if the agent answered
+         */
+        bool list(std::vector<std::string>& services);
+
+        /**
+         * Add or update a credential; returns once the agent has saved it
+         * @param service Service name
+         * @param username Username
+         * @param password Password
+         * @return Ok, BadRequest, or Failed if the save failed
+         */
+        AgentStatus put(std::string_view service, std::string_view username,
+                        std::string_view password);
+
+        /**
+         * Remove a credential; returns once the agent has saved the change
+         * @param service Service name
+         * @return Ok, NotFound, or Failed if the save failed
+         */
+        AgentStatus remove(std::string_view service);
+
+        /**
+         * @param json Receives the agent's counters and latencies
+         * @return true if the agent answered
+         */
+        bool stats(std::string& json);
+
+        /**
+         * Ask the agent to lock the vault and exit
+         * @return true if the agent acknowledged
+         */
+        bool lock();
+
+    private:
+        AgentStatus request(AgentOp op, std::string_view payload, std::string& response);
+
+        int fd = -1;
+    };
+}
+
+#endif // AGENT_HPP
@@ -0,0 +1,144 @@
+#include "batch.hpp"
+#include "json.hpp"
+#include <stdexcept>
+#include <string>
+
+namespace Vault {
+
+namespace {
+    const std::string EMPTY;
+    const int MAX_GENERATED_LENGTH = 128;
+
+    const std::string& requireString(const Json::Object& request, const char* name) {
+        const Json::Field* field = request.find(name);
+        if (!field || !field->isString || field->value.empty()) {
+            throw std::runtime_error(std::string("missing \"") + name + "\"");
+        }
+        return field->value;
+    }
+
+    // Apply one request, adding its output fields to `result`. A malformed
+    // request throws; one that is well formed but fails sets `error`.
+    bool apply(PasswordManager& vault, const Json::Object& request, Json::Writer& result,
+               bool& mutated, std::string& error) {
+        const std::string& op = requireString(request, "op");
+        result.add("op", op);
+
+        if (op == "add") {
+            const std::string& service = requireString(request, "service");
+            const std::string& username = request.getString("username", EMPTY);
+            const Json::Field* password = request.find("password");
+            const Json::Field* generate = request.find("generate");
+
+            std::string generated;
+            if (generate && generate->value == "true") {
+                int length = 16;
+                if (const Json::Field* requested = request.find("length")) {
+                    try {
+                        length = std::stoi(requested->value);
+                    } catch (const std::exception&) {
+                        throw std::runtime_error("\"length\" must be a number");
+                    }
+                    if (length < 8 || length > MAX_GENERATED_LENGTH) {
+                        throw std::runtime_error("\"length\" must be between 8 and " +
+                                                 std::to_string(MAX_GENERATED_LENGTH));
+                    }
+                }
+                generated = Utils::generatePassword(length, true);
+            } else if (!password || !password->isString) {
+                throw std::runtime_error("missing \"password\"");
+            }
+
+            bool ok = vault.addCredential(service, username,
+                                          generated.empty() ? password->value : generated);
+            mutated = mutated || ok;
+            result.add("service", service);
+            if (ok && !generated.empty()) {
+                result.add("password", generated);
+            }
+            Utils::secureErase(generated);
+            if (!ok) error = "could not store credential";
+            return ok;
+        }
+
+        if (op == "get") {
+            const std::string& service = requireString(request, "service");
+            CredentialView credential = vault.getCredential(service);
+            result.add("service", service);
+            if (!credential) {
+                error = "not found";
+                return false;
+            }
+            result.add("username", credential.username).add("password", credential.password);
+            return true;
+        }
+
+        if (op == "remove") {
+            const std::string& service = requireString(request, "service");
+            result.add("service", service);
+            if (!vault.removeCredential(service)) {
+                error = "not found";
+                return false;
+            }
+            mutated = true;
+            return true;
+        }
+
+        if (op == "list") {
+            result.add("services", vault.getServices());
+            return true;
+        }
+
+        throw std::runtime_error("unknown op \"" + op + "\"");
+    }
+}
+
+BatchSummary runBatch(PasswordManager& vault, std::istream& ops, std::ostream& out) {
+    BatchSummary summary;
+    bool mutated = false;
+
+    // Changes stay in memory until the single save below; if that fails
+    // they are rolled back with it
+    Transaction transaction(vault);
+
+    std::string line;
+    size_t lineNumber = 0;
+    while (std::getline(ops, line)) {
+        ++lineNumber;
+        if (line.find_first_not_of(" \t\r") == std::string::npos) continue;
+        ++summary.operations;
+
+        Json::Writer result;
+        result.add("line", lineNumber);
+        bool ok = false;
+        std::string error;
+        Json::Object request;
+        try {
+            request = Json::Object::parse(line);
+            ok = apply(vault, request, result, mutated, error);
+        } catch (const std::exception& e) {
+            error = e.what();
+        }
+        request.wipe();
+        result.add("ok", ok);
+        if (!ok) {
+            result.add("error", error);
+            ++summary.failed;
+        }
+
+        out << result.finish() << '\n';
+        result.wipe();
+        Utils::secureErase(line);
+    }
+
+    summary.saved = mutated ? transaction.commit() : true;
+
+    Json::Writer commit;
+    commit.add("op", "save").add("ok", summary.saved)
+          .add("operations", summary.operations).add("failed", summary.failed);
+    out << commit.finish() << '\n';
+    out.flush();
+    return summary;
+}
+
+} // namespace Vault
@@ -0,0 +1,35 @@
+#ifndef BATCH_HPP
+#define BATCH_HPP
+
+#include "vault.hpp"
+#include <istream>
+#include <ostream>
+
+namespace Vault {
+    // Outcome of a batch run
+    struct BatchSummary {
+        size_t operations = 0;
+        size_t failed = 0;
+        bool saved = false;    // Mutations reached disk (trivially true without any)
+    };
+
+    /**
+     * Apply a stream of operations to an unlocked vault, one JSON object
+     * per line:
+     *   {"op":"add","service":"...","username":"...","password":"..."}
+     *   {"op":"add","service":"...","username":"...","generate":true,"length":20}
+     *   {"op":"get","service":"..."}
+     *   {"op":"remove","service":"..."}
+     *   {"op":"list"}
+     * The run is one transaction: every operation works on memory only and
+     * the vault is saved once, after the last line. A failed line is
+     * reported and skipped; a failed save discards every change.
+     * @param vault Unlocked vault with no open transaction
+     * @param ops Operations, JSON Lines; blank lines are ignored
+     * @param out Receives one JSON result per operation, then one for the save
+     * @return Counts of operations and failures
+     */
+    BatchSummary runBatch(PasswordManager& vault, std::istream& ops, std::ostream& out);
+}
+
+#endif // BATCH_HPP
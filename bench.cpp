@@ -0,0 +1,890 @@
+// Performance benchmarks for the password manager hot paths.
+// Build and run with: make bench (results also go to bench_results.json)
+//
+// Each case builds its fixture (vaults, payloads) outside the timed loops,
+// so any subset picked with --filter measures the same thing as a full run.
+#include "crypto.hpp"
+#include "vault.hpp"
+#include "batch.hpp"
+#include "import_export.hpp"
+#include "agent.hpp"
+#include "json.hpp"
+#include "trace.hpp"
+#include "bench.hpp"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iterator>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <functional>
+#include <algorithm>
+#include <stdexcept>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <thread>
+#include <unistd.h>
+
+namespace {
+
+const std::string BENCH_PASSWORD = "Bench!Passw0rd#2024";
+
+struct BenchResult {
+    std::string name;
+    int iterations;
+    double meanMs;
+};
+
+template <typename Fn>
+BenchResult runBenchmark(const std::string& name, int iterations, Fn&& fn) {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i) {
+        fn();
+    }
+    auto elapsed = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - start).count();
+    return {name, iterations, elapsed / iterations};
+}
+
+// Every result printed so far, tagged with the case that produced it,
+// for the JSON report
+struct RecordedResult {
+    std::string benchCase;
+    BenchResult result;
+};
+std::vector<RecordedResult> recorded;
+std::string currentCase;
+
+void printResult(const BenchResult& result) {
+    recorded.push_back({currentCase, result});
+
+    // Pick a unit that keeps a few significant digits
+    double value = result.meanMs;
+    const char* unit = "ms";
+    if (value < 0.001) {
+        value *= 1e6;
+        unit = "ns";
+    } else if (value < 1.0) {
+        value *= 1e3;
+        unit = "us";
+    }
+    std::cout << "  " << std::left << std::setw(44) << result.name
+              << std::right << std::setw(10) << std::fixed << std::setprecision(2)
+              << value << " " << unit << "/op " << std::setw(12) << std::setprecision(0)
+              << 1000.0 / result.meanMs << " ops/s  (" << result.iterations << " runs)\n";
+}
+
+// Vaults go to $BENCH_DIR (default /tmp); point it at the disk that
+// matters when measuring fsync costs
+std::string tempVaultPath(const std::string& tag) {
+    const char* dir = std::getenv("BENCH_DIR");
+    return std::string(dir ? dir : "/tmp") + "/spm_bench_" + tag + "_" +
+           std::to_string(getpid()) + ".dat";
+}
+
+// Fill a fresh vault with `count` credentials, compacted into a single
+// snapshot, and return its path
+std::string buildVault(const std::string& tag, int count) {
+    std::string path = tempVaultPath(tag);
+    std::remove(path.c_str());
+    std::remove((path + ".journal").c_str());
+
+    Vault::PasswordManager vault(path);
+    vault.initializeVault(BENCH_PASSWORD);
+    std::vector<Vault::Credential> batch;
+    batch.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        batch.emplace_back("service-" + std::to_string(i),
+                           "user" + std::to_string(i) + "@example.com",
+                           Vault::Utils::generatePassword(20));
+    }
+    Vault::Transaction transaction(vault);
+    vault.addCredentials(batch);
+    transaction.commit(); // One snapshot, no journal
+    vault.lock();
+    return path;
+}
+
+// Plaintext payload in the pre-envelope text layout, sized like the
+// credentials buildVault() writes
+std::string legacyPayload(int count) {
+    std::string payload = "CREDENTIALS_START\n" + std::to_string(count) + "\n";
+    for (int i = 0; i < count; ++i) {
+        payload += "SERVICE:service-" + std::to_string(i) + "\nUSERNAME:user" +
+                   std::to_string(i) + "@example.com\nPASSWORD:" +
+                   Vault::Utils::generatePassword(20) + "\n---\n";
+    }
+    return payload;
+}
+
+// Unlock cost: the original two-pass path (verify by decrypting, then
+// decrypt again) against a single derivation checked by the key check
+void benchUnlock(int entries) {
+    std::cout << "\nunlock (" << entries << " entries)\n";
+    std::string path = buildVault("unlock", entries);
+
+    // Single-payload container as written before envelope encryption
+    Crypto::EncryptedData encrypted = Crypto::encrypt(legacyPayload(entries), BENCH_PASSWORD);
+    Crypto::EncryptedData legacy = encrypted;
+    legacy.keyCheck.clear();
+
+    printResult(runBenchmark("crypto: verify-by-decrypt + decrypt (before)", 5, [&] {
+        Crypto::verifyPassword(legacy, BENCH_PASSWORD);
+        Crypto::decrypt(legacy, BENCH_PASSWORD);
+    }));
+    printResult(runBenchmark("crypto: derive + key check + decrypt (after)", 5, [&] {
+        Crypto::SecureBuffer key = Crypto::deriveSecureKey(BENCH_PASSWORD, encrypted.salt,
+                                                           encrypted.kdf);
+        Crypto::verifyKey(encrypted, key);
+        Crypto::decrypt(encrypted, key);
+    }));
+    printResult(runBenchmark("PasswordManager::unlock", 5, [&] {
+        Vault::PasswordManager vault(path);
+        vault.unlock(BENCH_PASSWORD);
+    }));
+    printResult(runBenchmark("PasswordManager::unlock (wrong password)", 5, [&] {
+        Vault::PasswordManager vault(path);
+        vault.unlock("not-the-password");
+    }));
+
+    std::remove(path.c_str());
+}
+
+// Unlock decrypts only the index; passwords are opened one at a time
+void benchEnvelope(int entries) {
+    std::cout << "\nenvelope (" << entries << " entries)\n";
+    std::string path = buildVault("envelope", entries);
+
+    Vault::PasswordManager vault(path);
+    vault.unlock(BENCH_PASSWORD);
+    printResult(runBenchmark("loadVault (index only, secrets stay sealed)", 20, [&] {
+        vault.loadVault();
+    }));
+
+    int next = 0;
+    printResult(runBenchmark("getCredential: open one secret", 100000, [&] {
+        Bench::doNotOptimize(
+            vault.getCredential("service-" + std::to_string(next++ % entries)).password.size());
+    }));
+
+    vault.lock();
+    std::remove(path.c_str());
+    std::remove((path + ".journal").c_str());
+}
+
+// Full save and reload: serialization, encryption and the payload parser
+void benchSaveLoad(int entries) {
+    std::cout << "\nsave/load (" << entries << " entries)\n";
+    std::string path = buildVault("saveload", entries);
+
+    Vault::PasswordManager vault(path);
+    vault.unlock(BENCH_PASSWORD);
+    printResult(runBenchmark("PasswordManager::saveVault", 10, [&] {
+        vault.saveVault();
+    }));
+    printResult(runBenchmark("PasswordManager::loadVault", 10, [&] {
+        vault.loadVault();
+    }));
+
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    std::cout << "  vault file size: " << file.tellg() << " bytes\n";
+
+    vault.lock();
+    std::remove(path.c_str());
+    std::remove((path + ".journal").c_str());
+}
+
+// Per-mutation cost with the journal should not depend on vault size
+void benchMutations(int entries) {
+    std::cout << "\nmutations (" << entries << " entries)\n";
+    std::string path = buildVault("mutate", entries);
+
+    Vault::PasswordManager vault(path);
+    vault.unlock(BENCH_PASSWORD);
+    int next = 0;
+    printResult(runBenchmark("addCredential (journal append)", 500, [&] {
+        vault.addCredential("new-" + std::to_string(next++), "user", "Pa55word!");
+    }));
+    printResult(runBenchmark("removeCredential (journal append)", 500, [&] {
+        vault.removeCredential("new-" + std::to_string(--next));
+    }));
+    printResult(runBenchmark("saveVault (compaction)", 10, [&] {
+        vault.saveVault();
+    }));
+    printResult(runBenchmark("Transaction: 500 adds + commit", 10, [&] {
+        Vault::Transaction transaction(vault);
+        for (int i = 0; i < 500; ++i) {
+            vault.addCredential("tx-" + std::to_string(i), "user", "Pa55word!");
+        }
+        transaction.commit();
+    }));
+
+    vault.lock();
+    std::remove(path.c_str());
+    std::remove((path + ".journal").c_str());
+}
+
+// Bulk load through the batch runner: one unlock, every add in memory and
+// a single save, against one journal append per add
+void benchBatch(int records) {
+    std::cout << "\nbatch (" << records << " adds into an empty vault)\n";
+
+    std::string ops;
+    for (int i = 0; i < records; ++i) {
+        ops += "{\"op\":\"add\",\"service\":\"service-" + std::to_string(i) +
+               "\",\"username\":\"user" + std::to_string(i) +
+               "@example.com\",\"password\":\"" + Vault::Utils::generatePassword(20, false) + "\"}\n";
+    }
+
+    for (bool batched : {false, true}) {
+        std::string path = buildVault(batched ? "batch" : "batch_journal", 0);
+        Vault::PasswordManager vault(path);
+        vault.setDurability(Vault::Durability::None);
+        BenchResult result = runBenchmark(batched ? "runBatch (unlock + adds + one save)"
+                                                  : "unlock + addCredential each (journal)", 1, [&] {
+            vault.unlock(BENCH_PASSWORD);
+            if (batched) {
+                std::istringstream in(ops);
+                std::ostringstream out;
+                Vault::runBatch(vault, in, out);
+            } else {
+                for (int i = 0; i < records; ++i) {
+                    vault.addCredential("service-" + std::to_string(i),
+                                        "user" + std::to_string(i) + "@example.com", "Pa55word!");
+                }
+                vault.flush();
+            }
+        });
+        printResult(result);
+        std::cout << "    " << std::setprecision(0) << records * 1000.0 / result.meanMs
+                  << " records/s\n";
+        vault.lock();
+        std::remove(path.c_str());
+        std::remove((path + ".journal").c_str());
+    }
+}
+
+// Bulk import of a browser-style CSV and the same rows as JSON Lines:
+// parsing alone, then the whole import (parse, seal, one save)
+void benchImport(int rows) {
+    std::cout << "\nimport (" << rows << " rows, "
+              << Crypto::cryptoPool().size() << " threads)\n";
+
+    std::string csv = "name,url,username,password\n";
+    std::string jsonl;
+    for (int i = 0; i < rows; ++i) {
+        std::string id = std::to_string(i);
+        std::string password = Vault::Utils::generatePassword(20, false);
+        csv += "service-" + id + ",https://service-" + id + ".example.com/login,user" + id +
+               "@example.com," + password + "\n";
+        jsonl += "{\"service\":\"service-" + id + "\",\"username\":\"user" + id +
+                 "@example.com\",\"password\":\"" + password + "\"}\n";
+    }
+
+    const struct {
+        const char* name;
+        Vault::TransferFormat format;
+        const std::string& text;
+    } inputs[] = {
+        {"CSV", Vault::TransferFormat::Csv, csv},
+        {"JSON Lines", Vault::TransferFormat::JsonLines, jsonl},
+    };
+    for (const auto& input : inputs) {
+        size_t skipped = 0;
+        BenchResult parse = runBenchmark(std::string(input.name) + " parse", 3, [&] {
+            Vault::parseCredentials(input.text, input.format, skipped);
+        });
+        printResult(parse);
+        std::cout << "    " << std::setprecision(0) << rows * 1000.0 / parse.meanMs << " rows/s\n";
+
+        std::string source = tempVaultPath("import_source");
+        std::ofstream(source, std::ios::binary) << input.text;
+        std::string path = buildVault("import", 0);
+        Vault::PasswordManager vault(path);
+        vault.setDurability(Vault::Durability::None);
+        vault.unlock(BENCH_PASSWORD);
+        BenchResult import = runBenchmark(std::string(input.name) + " import (parse + seal + save)", 1, [&] {
+            Vault::importCredentials(vault, source, input.format);
+        });
+        printResult(import);
+        std::cout << "    " << std::setprecision(0) << rows * 1000.0 / import.meanMs << " rows/s\n";
+        vault.lock();
+        std::remove(source.c_str());
+        std::remove(path.c_str());
+    }
+}
+
+// Mutation throughput at each durability level
+void benchDurability(int entries) {
+    std::cout << "\ndurability (" << entries << " entries, 200 adds per level)\n";
+    std::string path = buildVault("durability", entries);
+
+    struct Level {
+        const char* name;
+        Vault::Durability durability;
+    };
+    const Level levels[] = {
+        {"Durability::None", Vault::Durability::None},
+        {"Durability::GroupCommit (50 ms window)", Vault::Durability::GroupCommit},
+        {"Durability::Full", Vault::Durability::Full},
+    };
+
+    Vault::PasswordManager vault(path);
+    vault.unlock(BENCH_PASSWORD);
+    int next = 0;
+    for (const Level& level : levels) {
+        vault.setDurability(level.durability);
+        printResult(runBenchmark(level.name, 200, [&] {
+            vault.addCredential("durable-" + std::to_string(next++), "user", "Pa55word!");
+        }));
+    }
+
+    vault.lock();
+    std::remove(path.c_str());
+    std::remove((path + ".journal").c_str());
+}
+
+// Lookup and listing cost on a large in-memory store
+void benchLookup(int entries) {
+    std::cout << "\nlookup (" << entries << " entries)\n";
+    std::string path = buildVault("lookup", entries);
+
+    Vault::PasswordManager vault(path);
+    vault.unlock(BENCH_PASSWORD);
+
+    std::vector<std::string> names;
+    for (int i = 0; i < entries; ++i) {
+        names.push_back("service-" + std::to_string((i * 7919) % entries));
+    }
+
+    size_t next = 0;
+    printResult(runBenchmark("getCredential (hit)", 1000000, [&] {
+        auto cred = vault.getCredential(names[next++ % names.size()]);
+        Bench::doNotOptimize(cred.password.size());
+    }));
+    printResult(runBenchmark("getCredential (miss)", 1000000, [&] {
+        auto cred = vault.getCredential("missing-service");
+        Bench::doNotOptimize(cred.password.size());
+    }));
+    // Whole-vault passes: about two million entries visited per benchmark
+    int passes = std::max(1, 2000000 / entries);
+    printResult(runBenchmark("getServices", passes, [&] {
+        Bench::doNotOptimize(vault.getServices().size());
+    }));
+    printResult(runBenchmark("list: getServices + getCredential each", passes, [&] {
+        for (const auto& service : vault.getServices()) {
+            Bench::doNotOptimize(vault.getCredential(service).username.size());
+        }
+    }));
+    printResult(runBenchmark("list: forEachCredential", passes, [&] {
+        vault.forEachCredential([&](const Vault::CredentialSummary& cred) {
+            Bench::doNotOptimize(cred.username.size());
+        });
+    }));
+
+    vault.lock();
+    std::remove(path.c_str());
+    std::remove((path + ".journal").c_str());
+}
+
+// Lookups through the agent: what a script pays per secret once the vault
+// is unlocked, against unlocking for every lookup
+void benchAgent(int entries) {
+    std::cout << "\nagent (" << entries << " entries)\n";
+    std::string path = buildVault("agent", entries);
+    std::string socketPath = tempVaultPath("agent") + ".sock";
+
+    Vault::PasswordManager vault(path);
+    printResult(runBenchmark("unlock + getCredential (no agent)", 3, [&] {
+        vault.unlock(BENCH_PASSWORD);
+        vault.getCredential("service-1");
+        vault.lock();
+    }));
+
+    vault.unlock(BENCH_PASSWORD);
+    Vault::AgentServer server(vault, socketPath, std::chrono::seconds(60));
+    if (!server.listen()) return;
+    std::thread serving([&] { server.serve(); });
+
+    std::string username;
+    std::string password;
+    int next = 0;
+    {
+        Vault::AgentClient client;
+        client.connect(socketPath);
+        printResult(runBenchmark("AgentClient::get (one connection)", 20000, [&] {
+            client.get("service-" + std::to_string(next++ % entries), username, password);
+        }));
+    }
+    printResult(runBenchmark("connect + AgentClient::get", 2000, [&] {
+        Vault::AgentClient once;
+        once.connect(socketPath);
+        once.get("service-" + std::to_string(next++ % entries), username, password);
+    }));
+
+    // Many clients at once: lookups share the vault lock, and changes
+    // from concurrent clients are saved together
+    const int clients = 8;
+    auto concurrently = [&](const std::string& name, int perClient,
+                            const std::function<void(Vault::AgentClient&, int)>& request) {
+        auto start = std::chrono::steady_clock::now();
+        std::vector<std::thread> threads;
+        for (int c = 0; c < clients; ++c) {
+            threads.emplace_back([&, c] {
+                Vault::AgentClient client;
+                client.connect(socketPath);
+                for (int i = 0; i < perClient; ++i) request(client, c * perClient + i);
+            });
+        }
+        for (std::thread& thread : threads) thread.join();
+        double elapsed = std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - start).count();
+        printResult({name, clients * perClient, elapsed / (clients * perClient)});
+    };
+    concurrently("AgentClient::get (8 clients)", 20000, [&](Vault::AgentClient& client, int i) {
+        std::string user;
+        std::string pass;
+        client.get("service-" + std::to_string(i % entries), user, pass);
+    });
+    concurrently("AgentClient::put (8 clients)", 200, [&](Vault::AgentClient& client, int i) {
+        client.put("service-" + std::to_string(i % entries), "user", "new-password");
+    });
+
+    Vault::AgentClient control;
+    control.connect(socketPath);
+    std::string stats;
+    if (control.stats(stats)) std::cout << "  " << stats << "\n";
+    control.lock();
+    serving.join();
+    std::remove(path.c_str());
+    std::remove((path + ".journal").c_str());
+}
+
+// Payload encryption at several sizes, with a key that is already
+// derived: one sealed record, and the chunked stream snapshots use
+void benchPayload() {
+    std::cout << "\npayload (" << Crypto::cipherSuiteName(Crypto::preferredCipherSuite())
+              << ", " << Crypto::cryptoPool().size() << " threads)\n";
+
+    Crypto::SecureBuffer key = Crypto::generateSecureKey();
+    Crypto::Cipher cipher(key, Crypto::preferredCipherSuite());
+    const uint8_t aad[] = {'a', 'a', 'd'};
+    for (size_t size : {size_t(1) << 10, size_t(64) << 10, size_t(1) << 20, size_t(16) << 20}) {
+        std::string label = size < (1 << 20) ? std::to_string(size >> 10) + " KiB"
+                                             : std::to_string(size >> 20) + " MiB";
+        // About 64 MiB of work per benchmark
+        int iterations = static_cast<int>(std::clamp<size_t>((size_t(64) << 20) / size, 3, 20000));
+        std::vector<uint8_t> plaintext(size, 'x');
+        std::vector<uint8_t> sealed = cipher.seal(plaintext.data(), size, aad, sizeof(aad));
+        Crypto::SecureBuffer opened;
+        std::vector<uint8_t> stream;
+        stream.reserve(Crypto::StreamEncryptor::sealedSize(size));
+
+        printResult(runBenchmark("Cipher::seal " + label, iterations, [&] {
+            Bench::doNotOptimize(cipher.seal(plaintext.data(), size, aad, sizeof(aad)).size());
+        }));
+        printResult(runBenchmark("Cipher::open " + label, iterations, [&] {
+            Bench::doNotOptimize(cipher.open(sealed.data(), sealed.size(), aad, sizeof(aad), opened));
+        }));
+        printResult(runBenchmark("stream seal " + label, iterations, [&] {
+            stream.clear();
+            Crypto::StreamEncryptor encryptor(cipher, {}, [&](const uint8_t* data, size_t length) {
+                stream.insert(stream.end(), data, data + length);
+            });
+            encryptor.update(plaintext.data(), plaintext.size());
+            encryptor.finish();
+        }));
+        printResult(runBenchmark("stream open " + label, iterations, [&] {
+            size_t total = 0;
+            Crypto::StreamDecryptor decryptor(cipher, {}, [&](const uint8_t*, size_t length) {
+                total += length;
+            });
+            decryptor.update(stream.data(), stream.size());
+            decryptor.finish();
+            Bench::doNotOptimize(total);
+        }));
+    }
+}
+
+// The credential index on its own, without encryption or file I/O
+void benchIndex(int entries) {
+    std::cout << "\nindex (" << entries << " entries)\n";
+    std::string path = buildVault("index", entries);
+    Vault::PasswordManager vault(path);
+    vault.unlock(BENCH_PASSWORD);
+    std::string index = Vault::RecordFormat::serialize(vault);
+    std::string secrets = Vault::RecordFormat::secrets(vault);
+    int iterations = std::max(3, 2000000 / entries);
+
+    printResult(runBenchmark("serializeCredentials", iterations, [&] {
+        Bench::doNotOptimize(Vault::RecordFormat::serialize(vault).size());
+    }));
+    printResult(runBenchmark("deserializeCredentials", iterations, [&] {
+        Vault::RecordFormat::deserialize(vault, index, secrets);
+        Bench::doNotOptimize(vault.getCredentialCount());
+    }));
+    vault.lock();
+    std::remove(path.c_str());
+    std::remove((path + ".journal").c_str());
+}
+
+// Password generation and the strength meter the CLI runs on every entry
+void benchPasswords() {
+    std::cout << "\npasswords\n";
+
+    printResult(runBenchmark("generatePassword(16)", 100000, [&] {
+        Bench::doNotOptimize(Vault::Utils::generatePassword(16).size());
+    }));
+    printResult(runBenchmark("generatePassword(64, no symbols)", 100000, [&] {
+        Bench::doNotOptimize(Vault::Utils::generatePassword(64, false).size());
+    }));
+    const std::string samples[] = {"password", "Tr0ub4dor&3", Vault::Utils::generatePassword(32)};
+    for (const std::string& sample : samples) {
+        printResult(runBenchmark("validatePasswordStrength (" + std::to_string(sample.size()) +
+                                 " chars)", 20000, [&] {
+            Bench::doNotOptimize(Vault::PasswordManager::validatePasswordStrength(sample).first);
+        }));
+    }
+}
+
+// What the phase timers add to each timed call; TRACE=0 builds time an
+// empty scope
+void benchTrace() {
+    std::cout << "\ntrace (" << (Trace::ENABLED ? "enabled" : "compiled out") << ")\n";
+
+    printResult(runBenchmark("Trace::Scope", 1000000, [] {
+        Trace::Scope trace(Trace::Phase::Encrypt);
+    }));
+    Trace::LatencyHistogram histogram;
+    uint64_t next = 0;
+    printResult(runBenchmark("LatencyHistogram::record", 1000000, [&] {
+        histogram.record(next++ * 977);
+    }));
+    printResult(runBenchmark("LatencyHistogram::percentile", 10000, [&] {
+        next += histogram.percentile(0.99);
+    }));
+    Trace::reset();
+}
+
+// Per-call cost of sealing and opening password-sized records: one-shot
+// calls set up the key every time, a Cipher reuses keyed contexts
+void benchRecords() {
+    std::cout << "\nsmall records (32 bytes, "
+              << Crypto::cipherSuiteName(Crypto::preferredCipherSuite()) << ")\n";
+
+    Crypto::SecureBuffer key = Crypto::generateSecureKey();
+    Crypto::Cipher cipher(key, Crypto::preferredCipherSuite());
+    std::vector<uint8_t> record(32, 'p');
+    const uint8_t aad[] = {'a', 'a', 'd'};
+    std::vector<uint8_t> sealed = cipher.seal(record.data(), record.size(), aad, sizeof(aad));
+    Crypto::SecureString opened;
+
+    printResult(runBenchmark("sealRecord (key setup per call)", 200000, [&] {
+        Bench::doNotOptimize(Crypto::sealRecord(key, cipher.suite(), record.data(), record.size(),
+                                                aad, sizeof(aad)).size());
+    }));
+    printResult(runBenchmark("Cipher::seal (pooled context)", 200000, [&] {
+        Bench::doNotOptimize(cipher.seal(record.data(), record.size(), aad, sizeof(aad)).size());
+    }));
+    printResult(runBenchmark("openRecord (key setup per call)", 200000, [&] {
+        Bench::doNotOptimize(Crypto::openRecord(key, cipher.suite(), sealed.data(), sealed.size(),
+                                                aad, sizeof(aad), opened));
+    }));
+    printResult(runBenchmark("Cipher::open (pooled context)", 200000, [&] {
+        Bench::doNotOptimize(cipher.open(sealed.data(), sealed.size(), aad, sizeof(aad), opened));
+    }));
+}
+
+// Bulk encryption throughput of each cipher suite on one thread, against
+// the CBC payload decryption older vaults still go through when migrated
+void benchCipherSuites(size_t megabytes) {
+    std::cout << "\ncipher suites (" << megabytes << " MiB, one thread, AES acceleration: "
+              << (Crypto::hasAesAcceleration() ? "yes" : "no") << ")\n";
+
+    std::string plaintext(megabytes * 1024 * 1024, 'x');
+    Crypto::SecureBuffer key = Crypto::generateSecureKey();
+    Crypto::EncryptedData legacy = Crypto::encrypt(plaintext, BENCH_PASSWORD);
+    Crypto::SecureBuffer legacyKey = Crypto::deriveSecureKey(BENCH_PASSWORD, legacy.salt, legacy.kdf);
+    Crypto::setCryptoThreads(1);
+
+    auto report = [&](const BenchResult& result) {
+        printResult(result);
+        std::cout << "    " << std::setprecision(0) << megabytes * 1000.0 / result.meanMs
+                  << " MiB/s\n";
+    };
+    report(runBenchmark("AES-256-CBC decrypt (legacy payload)", 3, [&] {
+        Bench::doNotOptimize(Crypto::decrypt(legacy, legacyKey).size());
+    }));
+
+    const Crypto::CipherSuite suites[] = {Crypto::CipherSuite::Aes256Gcm,
+                                          Crypto::CipherSuite::ChaCha20Poly1305};
+    for (Crypto::CipherSuite suite : suites) {
+        Crypto::Cipher cipher(key, suite);
+        std::vector<uint8_t> sealed;
+        sealed.reserve(Crypto::StreamEncryptor::sealedSize(plaintext.size()));
+        report(runBenchmark(std::string(Crypto::cipherSuiteName(suite)) + " seal", 3, [&] {
+            sealed.clear();
+            Crypto::StreamEncryptor encryptor(cipher, {}, [&](const uint8_t* data, size_t length) {
+                sealed.insert(sealed.end(), data, data + length);
+            });
+            encryptor.update(reinterpret_cast<const uint8_t*>(plaintext.data()), plaintext.size());
+            encryptor.finish();
+        }));
+        report(runBenchmark(std::string(Crypto::cipherSuiteName(suite)) + " open", 3, [&] {
+            Crypto::StreamDecryptor decryptor(cipher, {}, [](const uint8_t*, size_t) {});
+            decryptor.update(sealed.data(), sealed.size());
+            decryptor.finish();
+        }));
+    }
+
+    Crypto::setCryptoThreads(0);
+}
+
+// Chunked stream throughput against the number of crypto threads; the
+// speed-up is relative to a single thread
+void benchParallelStream(size_t megabytes) {
+    std::cout << "\nparallel stream (" << megabytes << " MiB, "
+              << std::thread::hardware_concurrency() << " hardware threads)\n";
+
+    std::vector<uint8_t> plaintext(megabytes * 1024 * 1024, 0x5A);
+    std::vector<uint8_t> sealed;
+    sealed.reserve(Crypto::StreamEncryptor::sealedSize(plaintext.size()));
+    Crypto::SecureBuffer key = Crypto::generateSecureKey();
+    Crypto::Cipher cipher(key, Crypto::preferredCipherSuite());
+
+    std::vector<size_t> threadCounts;
+    size_t hardware = std::max(1u, std::thread::hardware_concurrency());
+    for (size_t threads = 1; threads < hardware; threads *= 2) {
+        threadCounts.push_back(threads);
+    }
+    threadCounts.push_back(hardware);
+
+    double sealBase = 0;
+    double openBase = 0;
+    for (size_t threads : threadCounts) {
+        Crypto::setCryptoThreads(threads);
+
+        BenchResult seal = runBenchmark("seal, " + std::to_string(threads) + " threads", 3, [&] {
+            sealed.clear();
+            Crypto::StreamEncryptor encryptor(cipher, {}, [&](const uint8_t* data, size_t length) {
+                sealed.insert(sealed.end(), data, data + length);
+            });
+            encryptor.update(plaintext.data(), plaintext.size());
+            encryptor.finish();
+        });
+        size_t opened = 0;
+        BenchResult open = runBenchmark("open, " + std::to_string(threads) + " threads", 3, [&] {
+            Crypto::StreamDecryptor decryptor(cipher, {}, [&](const uint8_t*, size_t length) {
+                opened += length;
+            });
+            decryptor.update(sealed.data(), sealed.size());
+            decryptor.finish();
+            Bench::doNotOptimize(opened);
+        });
+
+        if (threads == 1) {
+            sealBase = seal.meanMs;
+            openBase = open.meanMs;
+        }
+        for (const auto& [result, base] : {std::make_pair(seal, sealBase),
+                                           std::make_pair(open, openBase)}) {
+            printResult(result);
+            std::cout << "    " << std::setprecision(0)
+                      << megabytes * 1000.0 / result.meanMs << " MiB/s, speed-up x"
+                      << std::setprecision(2) << base / result.meanMs << "\n";
+        }
+    }
+
+    Crypto::setCryptoThreads(0);
+}
+
+// Key derivation cost: the fixed PBKDF2 default against each memory-hard
+// KDF calibrated to the CLI's 250 ms unlock target on this host
+void benchKdf() {
+    std::cout << "\nkey derivation (250 ms target)\n";
+
+    std::vector<uint8_t> salt = Crypto::generateRandomBytes(Crypto::SALT_SIZE);
+    std::vector<Crypto::KdfParams> candidates = {Crypto::KdfParams()};
+    for (Crypto::KdfAlgorithm algorithm : {Crypto::KdfAlgorithm::Scrypt,
+                                           Crypto::KdfAlgorithm::Argon2id}) {
+        if (!Crypto::isKdfSupported(algorithm)) {
+            std::cout << "  " << Crypto::kdfName(algorithm) << ": not available in this OpenSSL\n";
+            continue;
+        }
+        auto start = std::chrono::steady_clock::now();
+        candidates.push_back(Crypto::calibrateKdf(algorithm, std::chrono::milliseconds(250)));
+        std::cout << "  " << Crypto::kdfName(algorithm) << " calibrated in " << std::fixed << std::setprecision(0)
+                  << std::chrono::duration<double, std::milli>(
+                         std::chrono::steady_clock::now() - start).count() << " ms\n";
+    }
+
+    printResult(runBenchmark("deriveKey (PBKDF2, " + std::to_string(Crypto::PBKDF2_ITERATIONS) +
+                             " iterations)", 3, [&] {
+        Crypto::deriveKey(BENCH_PASSWORD, salt);
+    }));
+    for (const Crypto::KdfParams& kdf : candidates) {
+        printResult(runBenchmark(Crypto::describeKdf(kdf), 3, [&] {
+            Crypto::deriveSecureKey(BENCH_PASSWORD, salt, kdf);
+        }));
+    }
+}
+
+// Derivation time against the thread count at a fixed cost (8 lanes), so
+// the security level stays the same while cores are added
+void benchKdfThreads() {
+    std::cout << "\nkey derivation threads (8 lanes, "
+              << std::thread::hardware_concurrency() << " hardware threads)\n";
+
+    std::vector<uint8_t> salt = Crypto::generateRandomBytes(Crypto::SALT_SIZE);
+    Crypto::KdfParams scrypt;
+    scrypt.algorithm = Crypto::KdfAlgorithm::Scrypt;
+    scrypt.iterations = 1;
+    scrypt.memoryKiB = 16 * 1024;
+    scrypt.parallelism = 8;
+    Crypto::KdfParams argon2;
+    argon2.algorithm = Crypto::KdfAlgorithm::Argon2id;
+    argon2.iterations = Crypto::ARGON2_PASSES;
+    argon2.memoryKiB = 128 * 1024;
+    argon2.parallelism = 8;
+
+    uint32_t hardware = std::max(1u, std::thread::hardware_concurrency());
+    for (Crypto::KdfParams kdf : {scrypt, argon2}) {
+        if (!Crypto::isKdfSupported(kdf.algorithm)) continue;
+        double base = 0;
+        for (uint32_t threads = 1; threads <= kdf.parallelism; threads *= 2) {
+            kdf.threads = threads;
+            BenchResult result = runBenchmark(Crypto::describeKdf(kdf), 3, [&] {
+                Crypto::deriveSecureKey(BENCH_PASSWORD, salt, kdf);
+            });
+            if (threads == 1) base = result.meanMs;
+            printResult(result);
+            std::cout << "    speed-up x" << std::setprecision(2) << base / result.meanMs << "\n";
+            if (threads >= hardware) break;
+        }
+    }
+}
+
+struct BenchCase {
+    std::string name;
+    std::function<void()> run;
+};
+
+// Every case, in run order. Names are stable so results can be compared
+// between builds; the number is the vault or input size.
+std::vector<BenchCase> benchCases() {
+    return {
+        {"kdf", [] { benchKdf(); }},
+        {"kdf-threads", [] { benchKdfThreads(); }},
+        {"unlock/2000", [] { benchUnlock(2000); }},
+        {"envelope/2000", [] { benchEnvelope(2000); }},
+        {"envelope/20000", [] { benchEnvelope(20000); }},
+        {"saveload/1000", [] { benchSaveLoad(1000); }},
+        {"saveload/100000", [] { benchSaveLoad(100000); }},
+        {"mutations/1000", [] { benchMutations(1000); }},
+        {"mutations/20000", [] { benchMutations(20000); }},
+        {"durability/1000", [] { benchDurability(1000); }},
+        {"batch/100000", [] { benchBatch(100000); }},
+        {"import/1000000", [] { benchImport(1000000); }},
+        {"lookup/1000", [] { benchLookup(1000); }},
+        {"lookup/100000", [] { benchLookup(100000); }},
+        {"lookup/1000000", [] { benchLookup(1000000); }},
+        {"agent/2000", [] { benchAgent(2000); }},
+        {"payload", [] { benchPayload(); }},
+        {"index/1000", [] { benchIndex(1000); }},
+        {"index/100000", [] { benchIndex(100000); }},
+        {"passwords", [] { benchPasswords(); }},
+        {"trace", [] { benchTrace(); }},
+        {"records", [] { benchRecords(); }},
+        {"cipher-suites/64", [] { benchCipherSuites(64); }},
+        {"parallel-stream/256", [] { benchParallelStream(256); }},
+    };
+}
+
+// Write the recorded results as one JSON document: the machine they ran
+// on, then one object per benchmark named "<case>/<benchmark>"
+void writeJson(const std::string& path) {
+    char date[32];
+    std::time_t now = std::time(nullptr);
+    std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", std::gmtime(&now));
+
+    Json::Writer context;
+    context.add("date", std::string_view(date))
+           .add("host_threads", static_cast<size_t>(std::thread::hardware_concurrency()))
+           .add("crypto_threads", Crypto::cryptoPool().size())
+           .add("cipher_suite", Crypto::cipherSuiteName(Crypto::preferredCipherSuite()))
+           .add("aes_acceleration", Crypto::hasAesAcceleration())
+           .add("vault_format", static_cast<size_t>(Crypto::VAULT_FORMAT_VERSION));
+
+    std::string text = "{\"context\":" + context.finish() + ",\n\"benchmarks\":[";
+    for (size_t i = 0; i < recorded.size(); ++i) {
+        const BenchResult& result = recorded[i].result;
+        Json::Writer entry;
+        entry.add("name", recorded[i].benchCase + "/" + result.name)
+             .add("case", recorded[i].benchCase)
+             .add("iterations", static_cast<size_t>(result.iterations))
+             .add("ns_per_op", result.meanMs * 1e6)
+             .add("ops_per_s", 1000.0 / result.meanMs);
+        text += (i == 0 ? "\n" : ",\n") + entry.finish();
+    }
+    text += "\n]}\n";
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out << text;
+    if (!out.flush()) throw std::runtime_error("cannot write " + path);
+}
+
+void printBenchUsage(const char* program) {
+    std::cerr << "Usage: " << program << " [--filter TEXT] [--json FILE] [--list]\n"
+              << "  --filter TEXT  Run only the cases whose name contains TEXT\n"
+              << "  --json FILE    Also write the results to FILE as JSON\n"
+              << "  --list         Print the case names and exit\n";
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    std::string filter;
+    std::string jsonPath;
+    bool listOnly = false;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--filter" && i + 1 < argc) {
+            filter = argv[++i];
+        } else if (arg == "--json" && i + 1 < argc) {
+            jsonPath = argv[++i];
+        } else if (arg == "--list") {
+            listOnly = true;
+        } else {
+            printBenchUsage(argv[0]);
+            return arg == "--help" || arg == "-h" ? 0 : 2;
+        }
+    }
+
+    std::vector<BenchCase> cases = benchCases();
+    if (listOnly) {
+        for (const BenchCase& benchCase : cases) std::cout << benchCase.name << "\n";
+        return 0;
+    }
+
+    std::cout << "🏁 Secure Password Manager benchmarks\n";
+
+    try {
+        for (const BenchCase& benchCase : cases) {
+            if (benchCase.name.find(filter) == std::string::npos) continue;
+            currentCase = benchCase.name;
+            benchCase.run();
+        }
+        if (!jsonPath.empty()) {
+            writeJson(jsonPath);
+            std::cout << "\n" << recorded.size() << " results written to " << jsonPath << "\n";
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Benchmark failed: " << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,18 @@
+#ifndef BENCH_HPP
+#define BENCH_HPP
+
+// Helpers shared by the benchmark driver and the perf-test harness
+namespace Bench {
+    /**
+     * Make the compiler treat a value as read by code it cannot see, so the
+     * work that produced it is neither removed nor hoisted out of a timed
+     * loop. Costs no instructions of its own.
+     * @param value Result of the timed work
+     */
+    template <typename T>
+    inline void doNotOptimize(const T& value) {
+        asm volatile("" : : "r,m"(value) : "memory");
+    }
+}
+
+#endif // BENCH_HPP
@@ -1,12 +1,29 @@
 #include "crypto.hpp"
+#include "trace.hpp"
 #include <openssl/evp.h>
 #include <openssl/rand.h>
 #include <openssl/sha.h>
 #include <openssl/aes.h>
 #include <openssl/kdf.h>
+#include <openssl/crypto.h>
+#include <openssl/hmac.h>
+#if OPENSSL_VERSION_NUMBER >= 0x30200000L
+#include <openssl/core_names.h>
+#include <openssl/params.h>
+#include <openssl/thread.h>
+#endif
+#if defined(__aarch64__) && defined(__linux__)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
 #include <stdexcept>
+#include <algorithm>
+#include <climits>
 #include <cstring>
 #include <iostream>
+#include <memory>
+#include <thread>
+#include <atomic>
 
 #ifndef AES_BLOCK_SIZE
 #define AES_BLOCK_SIZE 16
@@ -14,9 +31,177 @@
 
 namespace Crypto {
 
+namespace {
+    const uint8_t VAULT_MAGIC[4] = {'S', 'P', 'M', 'V'};
+
+    using CipherCtxPtr = std::unique_ptr<EVP_CIPHER_CTX, decltype(&EVP_CIPHER_CTX_free)>;
+
+    CipherCtxPtr newCipherCtx() {
+        CipherCtxPtr ctx(EVP_CIPHER_CTX_new(), &EVP_CIPHER_CTX_free);
+        if (!ctx) {
+            throw std::runtime_error("Failed to create cipher context");
+        }
+        return ctx;
+    }
+
+    // Look a cipher up once and keep it for the life of the process.
+    // Passing EVP_aes_256_gcm() and the like to an init call makes
+    // OpenSSL 3 fetch the implementation from its provider every time.
+    const EVP_CIPHER* fetchCipher(const char* name, const EVP_CIPHER* (*builtin)()) {
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+        (void)builtin;
+        const EVP_CIPHER* cipher = EVP_CIPHER_fetch(nullptr, name, nullptr);
+        if (!cipher) {
+            throw std::runtime_error(std::string("Cipher not available: ") + name);
+        }
+        return cipher;
+#else
+        (void)name;
+        return builtin();
+#endif
+    }
+
+    const EVP_CIPHER* aeadCipher(CipherSuite suite) {
+        switch (suite) {
+            case CipherSuite::Aes256Gcm: {
+                static const EVP_CIPHER* gcm = fetchCipher("AES-256-GCM", EVP_aes_256_gcm);
+                return gcm;
+            }
+            case CipherSuite::ChaCha20Poly1305: {
+                static const EVP_CIPHER* chacha = fetchCipher("ChaCha20-Poly1305",
+                                                              EVP_chacha20_poly1305);
+                return chacha;
+            }
+        }
+        throw std::runtime_error("Unsupported cipher suite");
+    }
+
+    const EVP_CIPHER* cbcCipher() {
+        static const EVP_CIPHER* cbc = fetchCipher("AES-256-CBC", EVP_aes_256_cbc);
+        return cbc;
+    }
+
+    // Context for one-shot operations, reused across calls on the same
+    // thread instead of allocated each time. It is reset on release, so no
+    // key schedule outlives the call; a nested use gets a context of its own.
+    class ScratchContext {
+    public:
+        ScratchContext() {
+            static thread_local CipherCtxPtr shared = newCipherCtx();
+            static thread_local bool busy = false;
+            if (busy) {
+                owned = newCipherCtx();
+                ctx = owned.get();
+            } else {
+                busy = true;
+                inUse = &busy;
+                ctx = shared.get();
+            }
+        }
+
+        ~ScratchContext() {
+            EVP_CIPHER_CTX_reset(ctx);
+            if (inUse) *inUse = false;
+        }
+
+        ScratchContext(const ScratchContext&) = delete;
+        ScratchContext& operator=(const ScratchContext&) = delete;
+
+        EVP_CIPHER_CTX* get() const { return ctx; }
+
+    private:
+        CipherCtxPtr owned{nullptr, &EVP_CIPHER_CTX_free};
+        EVP_CIPHER_CTX* ctx = nullptr;
+        bool* inUse = nullptr;
+    };
+
+    // Seal under `nonce` with a context that already holds the key;
+    // `out` receives [ciphertext][tag]
+    void aeadSeal(EVP_CIPHER_CTX* ctx, const uint8_t* nonce,
+                  const uint8_t* aad, size_t aadLength,
+                  const uint8_t* plaintext, size_t length, uint8_t* out) {
+        int len = 0;
+        if (EVP_EncryptInit_ex(ctx, nullptr, nullptr, nullptr, nonce) != 1 ||
+            (aadLength > 0 && EVP_EncryptUpdate(ctx, nullptr, &len, aad, aadLength) != 1) ||
+            EVP_EncryptUpdate(ctx, out, &len, plaintext, length) != 1 ||
+            EVP_EncryptFinal_ex(ctx, out + len, &len) != 1 ||
+            EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_GET_TAG, GCM_TAG_SIZE, out + length) != 1) {
+            throw std::runtime_error("Encryption failed");
+        }
+    }
+
+    // Open [ciphertext][tag] sealed under `nonce` with a context that
+    // already holds the key; `out` is wiped if the data is not authentic
+    bool aeadOpen(EVP_CIPHER_CTX* ctx, const uint8_t* nonce,
+                  const uint8_t* aad, size_t aadLength,
+                  const uint8_t* sealed, size_t length, uint8_t* out) {
+        size_t bodyLength = length - GCM_TAG_SIZE;
+        uint8_t tag[GCM_TAG_SIZE];
+        std::memcpy(tag, sealed + bodyLength, GCM_TAG_SIZE);
+        int len = 0;
+        
+        if (EVP_DecryptInit_ex(ctx, nullptr, nullptr, nullptr, nonce) != 1 ||
+            (aadLength > 0 && EVP_DecryptUpdate(ctx, nullptr, &len, aad, aadLength) != 1) ||
+            EVP_DecryptUpdate(ctx, out, &len, sealed, bodyLength) != 1 ||
+            EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_SET_TAG, GCM_TAG_SIZE, tag) != 1 ||
+            EVP_DecryptFinal_ex(ctx, out + len, &len) != 1) {
+            OPENSSL_cleanse(out, bodyLength);
+            return false;
+        }
+        return true;
+    }
+
+    EncryptedView viewOf(const EncryptedData& encData) {
+        EncryptedView view;
+        view.version = encData.version;
+        view.salt = encData.salt;
+        view.iv = encData.iv;
+        view.ciphertext = encData.ciphertext;
+        view.kdf = encData.kdf;
+        view.cipherSuite = encData.cipherSuite;
+        view.keyCheck = encData.keyCheck;
+        view.wrappedKey = encData.wrappedKey;
+        view.secrets = encData.secrets;
+        return view;
+    }
+}
+
+// SecureBuffer Implementation
+SecureBuffer::SecureBuffer(size_t size)
+    : bytes(static_cast<uint8_t*>(secureArena().allocate(size))), length(size) {}
+
+SecureBuffer::~SecureBuffer() {
+    clear();
+}
+
+SecureBuffer::SecureBuffer(SecureBuffer&& other) noexcept
+    : bytes(other.bytes), length(other.length) {
+    other.bytes = nullptr;
+    other.length = 0;
+}
+
+SecureBuffer& SecureBuffer::operator=(SecureBuffer&& other) noexcept {
+    if (this != &other) {
+        clear();
+        bytes = other.bytes;
+        length = other.length;
+        other.bytes = nullptr;
+        other.length = 0;
+    }
+    return *this;
+}
+
+void SecureBuffer::clear() {
+    // The arena wipes the block
+    secureArena().deallocate(bytes, length);
+    bytes = nullptr;
+    length = 0;
+}
+
 std::vector<uint8_t> deriveKey(const std::string& password, 
                               const std::vector<uint8_t>& salt, 
                               int iterations) {
+    Trace::Scope trace(Trace::Phase::DeriveKey);
     std::vector<uint8_t> key(AES_KEY_SIZE);
     
     if (PKCS5_PBKDF2_HMAC(password.c_str(), password.length(),
@@ -29,6 +214,419 @@ std::vector<uint8_t> deriveKey(const std::string& password,
     return key;
 }
 
+SecureBuffer deriveSecureKey(const std::string& password,
+                             ByteSpan salt,
+                             int iterations) {
+    Trace::Scope trace(Trace::Phase::DeriveKey);
+    SecureBuffer key(AES_KEY_SIZE);
+    
+    if (PKCS5_PBKDF2_HMAC(password.c_str(), password.length(),
+                          salt.data, salt.size,
+                          iterations, EVP_sha256(),
+                          AES_KEY_SIZE, key.data()) != 1) {
+        throw std::runtime_error("Key derivation failed");
+    }
+    
+    return key;
+}
+
+namespace {
+    // scrypt (RFC 7914). OpenSSL runs the p lanes one after another; they
+    // are independent, so here each one can run on its own crypto thread.
+    inline uint32_t rotl(uint32_t x, int n) {
+        return (x << n) | (x >> (32 - n));
+    }
+
+    void salsa208(uint32_t b[16]) {
+        uint32_t x[16];
+        std::memcpy(x, b, sizeof(x));
+        for (int round = 0; round < 8; round += 2) {
+            x[4] ^= rotl(x[0] + x[12], 7);   x[8] ^= rotl(x[4] + x[0], 9);
+            x[12] ^= rotl(x[8] + x[4], 13);  x[0] ^= rotl(x[12] + x[8], 18);
+            x[9] ^= rotl(x[5] + x[1], 7);    x[13] ^= rotl(x[9] + x[5], 9);
+            x[1] ^= rotl(x[13] + x[9], 13);  x[5] ^= rotl(x[1] + x[13], 18);
+            x[14] ^= rotl(x[10] + x[6], 7);  x[2] ^= rotl(x[14] + x[10], 9);
+            x[6] ^= rotl(x[2] + x[14], 13);  x[10] ^= rotl(x[6] + x[2], 18);
+            x[3] ^= rotl(x[15] + x[11], 7);  x[7] ^= rotl(x[3] + x[15], 9);
+            x[11] ^= rotl(x[7] + x[3], 13);  x[15] ^= rotl(x[11] + x[7], 18);
+            x[1] ^= rotl(x[0] + x[3], 7);    x[2] ^= rotl(x[1] + x[0], 9);
+            x[3] ^= rotl(x[2] + x[1], 13);   x[0] ^= rotl(x[3] + x[2], 18);
+            x[6] ^= rotl(x[5] + x[4], 7);    x[7] ^= rotl(x[6] + x[5], 9);
+            x[4] ^= rotl(x[7] + x[6], 13);   x[5] ^= rotl(x[4] + x[7], 18);
+            x[11] ^= rotl(x[10] + x[9], 7);  x[8] ^= rotl(x[11] + x[10], 9);
+            x[9] ^= rotl(x[8] + x[11], 13);  x[10] ^= rotl(x[9] + x[8], 18);
+            x[12] ^= rotl(x[15] + x[14], 7); x[13] ^= rotl(x[12] + x[15], 9);
+            x[14] ^= rotl(x[13] + x[12], 13); x[15] ^= rotl(x[14] + x[13], 18);
+        }
+        for (int i = 0; i < 16; ++i) {
+            b[i] += x[i];
+        }
+    }
+
+    // BlockMix over 2r 64-byte blocks; even outputs first, then odd
+    void blockMix(const uint32_t* in, uint32_t* out, size_t r) {
+        uint32_t x[16];
+        std::memcpy(x, in + (2 * r - 1) * 16, sizeof(x));
+        for (size_t i = 0; i < 2 * r; ++i) {
+            for (int k = 0; k < 16; ++k) {
+                x[k] ^= in[i * 16 + k];
+            }
+            salsa208(x);
+            std::memcpy(out + ((i & 1) * r + i / 2) * 16, x, sizeof(x));
+        }
+    }
+
+    // ROMix on one lane of 128 * r bytes, in place
+    void roMix(uint8_t* lane, size_t r, uint64_t n, uint32_t* v, uint32_t* xy) {
+        size_t words = 32 * r;
+        uint32_t* x = xy;
+        uint32_t* y = xy + words;
+        for (size_t k = 0; k < words; ++k) {
+            const uint8_t* p = lane + 4 * k;
+            x[k] = p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24);
+        }
+        for (uint64_t i = 0; i < n; ++i) {
+            std::memcpy(v + i * words, x, words * sizeof(uint32_t));
+            blockMix(x, y, r);
+            std::swap(x, y);
+        }
+        for (uint64_t i = 0; i < n; ++i) {
+            uint64_t j = x[(2 * r - 1) * 16] & (n - 1);
+            for (size_t k = 0; k < words; ++k) {
+                x[k] ^= v[j * words + k];
+            }
+            blockMix(x, y, r);
+            std::swap(x, y);
+        }
+        for (size_t k = 0; k < words; ++k) {
+            for (int shift = 0; shift < 32; shift += 8) {
+                lane[4 * k + shift / 8] = (x[k] >> shift) & 0xFF;
+            }
+        }
+    }
+}
+
+void scrypt(const std::string& password, ByteSpan salt, uint64_t n, uint32_t r, uint32_t p,
+            uint32_t threads, uint8_t* out, size_t outLength) {
+    const size_t laneBytes = 128 * static_cast<size_t>(r);
+    const uint64_t maxTableBytes = static_cast<uint64_t>(MAX_KDF_MEMORY_KIB) * 1024;
+    if (n < 2 || (n & (n - 1)) != 0 || r == 0 || p == 0 || n > maxTableBytes / laneBytes) {
+        throw std::runtime_error("Invalid key derivation parameters");
+    }
+    const size_t tableBytes = n * laneBytes;
+
+    SecureBuffer lanes(laneBytes * p);
+    if (PKCS5_PBKDF2_HMAC(password.data(), password.size(), salt.data, salt.size, 1,
+                          EVP_sha256(), lanes.size(), lanes.data()) != 1) {
+        throw std::runtime_error("Key derivation failed");
+    }
+
+    // Each thread fills its own N-block table, so memory grows with the
+    // thread count rather than the lane count. The count comes from the
+    // vault header, unchecked before the key is, so it is cut down until
+    // the tables fit in MAX_KDF_MEMORY_KIB together; the key is the same.
+    std::atomic<size_t> nextLane{0};
+    size_t workers = std::min<size_t>({threads, p, cryptoPool().size(),
+                                       std::max<uint64_t>(1, maxTableBytes / tableBytes)});
+    cryptoPool().run(workers, [&](size_t) {
+        size_t tableWords = tableBytes / sizeof(uint32_t);
+        std::unique_ptr<uint32_t[]> table(new uint32_t[tableWords]);
+        std::unique_ptr<uint32_t[]> scratch(new uint32_t[64 * r]);
+        for (size_t lane = nextLane++; lane < p; lane = nextLane++) {
+            roMix(lanes.data() + lane * laneBytes, r, n, table.get(), scratch.get());
+        }
+        OPENSSL_cleanse(table.get(), tableWords * sizeof(uint32_t));
+        OPENSSL_cleanse(scratch.get(), 64 * r * sizeof(uint32_t));
+    });
+
+    if (PKCS5_PBKDF2_HMAC(password.data(), password.size(), lanes.data(), lanes.size(), 1,
+                          EVP_sha256(), outLength, out) != 1) {
+        throw std::runtime_error("Key derivation failed");
+    }
+}
+
+namespace {
+    SecureBuffer deriveScrypt(const std::string& password, ByteSpan salt, const KdfParams& kdf) {
+        Trace::Scope trace(Trace::Phase::DeriveKey);
+        SecureBuffer key(AES_KEY_SIZE);
+        scrypt(password, salt, kdf.memoryKiB, SCRYPT_BLOCK_SIZE, kdf.parallelism, kdf.threads,
+               key.data(), key.size());
+        return key;
+    }
+
+    SecureBuffer deriveArgon2id(const std::string& password, ByteSpan salt, const KdfParams& kdf) {
+        Trace::Scope trace(Trace::Phase::DeriveKey);
+#if OPENSSL_VERSION_NUMBER >= 0x30200000L
+        EVP_KDF* argon2 = EVP_KDF_fetch(nullptr, "ARGON2ID", nullptr);
+        if (!argon2) {
+            throw std::runtime_error("Argon2id is not available in this OpenSSL");
+        }
+        EVP_KDF_CTX* ctx = EVP_KDF_CTX_new(argon2);
+        EVP_KDF_free(argon2);
+        if (!ctx) {
+            throw std::runtime_error("Failed to create KDF context");
+        }
+
+        uint32_t passes = kdf.iterations;
+        uint32_t memory = kdf.memoryKiB;
+        uint32_t lanes = kdf.parallelism;
+        // Argon2 runs its lanes on OpenSSL's own thread pool
+        uint32_t threads = std::min<uint32_t>(kdf.threads,
+                                              std::max(1u, std::thread::hardware_concurrency()));
+        if (threads > 1 && OSSL_get_max_threads(nullptr) < threads) {
+            OSSL_set_max_threads(nullptr, threads);
+        }
+        OSSL_PARAM params[] = {
+            OSSL_PARAM_construct_octet_string(OSSL_KDF_PARAM_PASSWORD,
+                const_cast<char*>(password.data()), password.size()),
+            OSSL_PARAM_construct_octet_string(OSSL_KDF_PARAM_SALT,
+                const_cast<uint8_t*>(salt.data), salt.size),
+            OSSL_PARAM_construct_uint32(OSSL_KDF_PARAM_ITER, &passes),
+            OSSL_PARAM_construct_uint32(OSSL_KDF_PARAM_ARGON2_MEMCOST, &memory),
+            OSSL_PARAM_construct_uint32(OSSL_KDF_PARAM_ARGON2_LANES, &lanes),
+            OSSL_PARAM_construct_uint32(OSSL_KDF_PARAM_THREADS, &threads),
+            OSSL_PARAM_construct_end()
+        };
+
+        SecureBuffer key(AES_KEY_SIZE);
+        int ok = EVP_KDF_derive(ctx, key.data(), key.size(), params);
+        if (ok != 1 && threads > 1) {
+            // Builds without a thread pool, or a pool already busy, refuse
+            // extra threads; the key is the same on one
+            threads = 1;
+            ok = EVP_KDF_derive(ctx, key.data(), key.size(), params);
+        }
+        EVP_KDF_CTX_free(ctx);
+        if (ok != 1) {
+            throw std::runtime_error("Key derivation failed");
+        }
+        return key;
+#else
+        (void)password;
+        (void)salt;
+        (void)kdf;
+        throw std::runtime_error("Argon2id needs OpenSSL 3.2 or later");
+#endif
+    }
+
+    // Wall-clock time of one derivation with the given parameters
+    double timeKdf(const KdfParams& kdf) {
+        static const std::string password = "calibration";
+        std::vector<uint8_t> salt(SALT_SIZE, 0);
+        auto start = std::chrono::steady_clock::now();
+        deriveSecureKey(password, salt, kdf);
+        return std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - start).count();
+    }
+}
+
+SecureBuffer deriveSecureKey(const std::string& password,
+                             ByteSpan salt,
+                             const KdfParams& kdf) {
+    validateKdfParams(kdf);
+    switch (kdf.algorithm) {
+        case KdfAlgorithm::Pbkdf2Sha256:
+            return deriveSecureKey(password, salt, static_cast<int>(kdf.iterations));
+        case KdfAlgorithm::Scrypt:
+            return deriveScrypt(password, salt, kdf);
+        case KdfAlgorithm::Argon2id:
+            return deriveArgon2id(password, salt, kdf);
+    }
+    throw std::runtime_error("Unsupported key derivation function");
+}
+
+void validateKdfParams(const KdfParams& kdf) {
+    bool valid = false;
+    switch (kdf.algorithm) {
+        case KdfAlgorithm::Pbkdf2Sha256:
+            valid = kdf.iterations > 0 && kdf.iterations <= INT_MAX &&
+                    kdf.memoryKiB == 0 && kdf.parallelism == 1 && kdf.threads == 1;
+            break;
+        case KdfAlgorithm::Scrypt:
+            // N must be a power of two above 1
+            valid = kdf.iterations == 1 && kdf.memoryKiB >= 2 &&
+                    (kdf.memoryKiB & (kdf.memoryKiB - 1)) == 0 &&
+                    kdf.memoryKiB <= MAX_KDF_MEMORY_KIB &&
+                    kdf.parallelism >= 1 && kdf.parallelism <= MAX_KDF_PARALLELISM;
+            break;
+        case KdfAlgorithm::Argon2id:
+            // Argon2 needs at least 8 KiB per lane
+            valid = kdf.iterations >= 1 && kdf.iterations <= INT_MAX &&
+                    kdf.parallelism >= 1 && kdf.parallelism <= MAX_KDF_PARALLELISM &&
+                    kdf.memoryKiB >= 8 * kdf.parallelism &&
+                    kdf.memoryKiB <= MAX_KDF_MEMORY_KIB;
+            break;
+    }
+    if (!valid || kdf.threads < 1 || kdf.threads > kdf.parallelism) {
+        throw std::runtime_error("Invalid key derivation parameters");
+    }
+}
+
+bool isKdfSupported(KdfAlgorithm algorithm) {
+    switch (algorithm) {
+        case KdfAlgorithm::Pbkdf2Sha256:
+        case KdfAlgorithm::Scrypt:
+            return true;
+        case KdfAlgorithm::Argon2id: {
+#if OPENSSL_VERSION_NUMBER >= 0x30200000L
+            static const bool available = [] {
+                EVP_KDF* argon2 = EVP_KDF_fetch(nullptr, "ARGON2ID", nullptr);
+                EVP_KDF_free(argon2);
+                return argon2 != nullptr;
+            }();
+            return available;
+#else
+            return false;
+#endif
+        }
+    }
+    return false;
+}
+
+KdfAlgorithm preferredKdf() {
+    return isKdfSupported(KdfAlgorithm::Argon2id) ? KdfAlgorithm::Argon2id
+                                                  : KdfAlgorithm::Scrypt;
+}
+
+KdfParams calibrateKdf(KdfAlgorithm algorithm, std::chrono::milliseconds target,
+                       uint32_t parallelism) {
+    double targetMs = static_cast<double>(target.count());
+    uint32_t hardware = std::max(1u, std::thread::hardware_concurrency());
+    KdfParams kdf;
+    kdf.algorithm = algorithm;
+
+    switch (algorithm) {
+        case KdfAlgorithm::Pbkdf2Sha256: {
+            // Cost is linear in iterations; time a trial long enough to measure
+            kdf.iterations = 10000;
+            double elapsed = timeKdf(kdf);
+            while (elapsed < 20.0 && kdf.iterations < static_cast<uint32_t>(PBKDF2_ITERATIONS)) {
+                kdf.iterations *= 4;
+                elapsed = timeKdf(kdf);
+            }
+            double scaled = kdf.iterations * targetMs / std::max(elapsed, 0.001);
+            kdf.iterations = static_cast<uint32_t>(std::clamp(scaled,
+                static_cast<double>(PBKDF2_ITERATIONS), static_cast<double>(INT_MAX)));
+            break;
+        }
+        case KdfAlgorithm::Scrypt: {
+            // Cost is linear in N, which must stay a power of two: take the
+            // one nearest the target on a log scale. Each thread holds a
+            // table of N KiB, so the cap applies to all of them together.
+            kdf.iterations = 1;
+            kdf.parallelism = std::clamp(parallelism, 1u, MAX_KDF_PARALLELISM);
+            kdf.threads = std::min(kdf.parallelism, hardware);
+            kdf.memoryKiB = MIN_SCRYPT_MEMORY_KIB;
+            double elapsed = timeKdf(kdf);
+            while (static_cast<uint64_t>(kdf.memoryKiB) * kdf.threads < MAX_CALIBRATED_MEMORY_KIB &&
+                   elapsed * 2 <= targetMs * 1.41) {
+                kdf.memoryKiB *= 2;
+                elapsed *= 2;
+            }
+            break;
+        }
+        case KdfAlgorithm::Argon2id: {
+            // Spend the budget on memory first, then on extra passes
+            kdf.iterations = ARGON2_PASSES;
+            kdf.parallelism = std::clamp(parallelism, 1u, MAX_KDF_PARALLELISM);
+            kdf.threads = std::min(kdf.parallelism, hardware);
+            kdf.memoryKiB = MIN_ARGON2_MEMORY_KIB;
+            double elapsed = std::max(timeKdf(kdf), 0.001);
+            double memory = kdf.memoryKiB * targetMs / elapsed;
+            if (memory > MAX_CALIBRATED_MEMORY_KIB) {
+                double passes = kdf.iterations * memory / MAX_CALIBRATED_MEMORY_KIB;
+                kdf.iterations = static_cast<uint32_t>(std::min(passes, 64.0));
+                memory = MAX_CALIBRATED_MEMORY_KIB;
+            }
+            // Whole MiB, and never below the floor
+            kdf.memoryKiB = std::max(MIN_ARGON2_MEMORY_KIB,
+                                     static_cast<uint32_t>(memory) / 1024 * 1024);
+            break;
+        }
+    }
+
+    validateKdfParams(kdf);
+    return kdf;
+}
+
+const char* kdfName(KdfAlgorithm algorithm) {
+    switch (algorithm) {
+        case KdfAlgorithm::Pbkdf2Sha256:
+            return "PBKDF2-HMAC-SHA256";
+        case KdfAlgorithm::Scrypt:
+            return "scrypt";
+        case KdfAlgorithm::Argon2id:
+            return "Argon2id";
+    }
+    return "unknown";
+}
+
+std::string describeKdf(const KdfParams& kdf) {
+    std::string description = kdfName(kdf.algorithm);
+    switch (kdf.algorithm) {
+        case KdfAlgorithm::Pbkdf2Sha256:
+            description += " (" + std::to_string(kdf.iterations) + " iterations)";
+            break;
+        case KdfAlgorithm::Scrypt: {
+            int log2N = 0;
+            while ((1u << log2N) < kdf.memoryKiB) ++log2N;
+            description += " (N=2^" + std::to_string(log2N) +
+                           ", r=" + std::to_string(SCRYPT_BLOCK_SIZE) +
+                           ", p=" + std::to_string(kdf.parallelism) +
+                           ", " + std::to_string(kdf.memoryKiB / 1024) + " MiB";
+            break;
+        }
+        case KdfAlgorithm::Argon2id:
+            description += " (t=" + std::to_string(kdf.iterations) +
+                           ", " + std::to_string(kdf.memoryKiB / 1024) + " MiB" +
+                           ", " + std::to_string(kdf.parallelism) + " lanes";
+            break;
+    }
+    if (kdf.algorithm != KdfAlgorithm::Pbkdf2Sha256) {
+        description += ", " + std::to_string(kdf.threads) +
+                       (kdf.threads == 1 ? " thread)" : " threads)");
+    }
+    return description;
+}
+
+SecureBuffer generateSecureKey() {
+    SecureBuffer key(AES_KEY_SIZE);
+    if (RAND_bytes(key.data(), key.size()) != 1) {
+        throw std::runtime_error("Random byte generation failed");
+    }
+    return key;
+}
+
+bool hasAesAcceleration() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("aes") && __builtin_cpu_supports("pclmul");
+#elif defined(__aarch64__) && defined(__linux__)
+    unsigned long caps = getauxval(AT_HWCAP);
+    return (caps & HWCAP_AES) && (caps & HWCAP_PMULL);
+#elif defined(__aarch64__) && defined(__APPLE__)
+    return true; // Every Apple arm64 core has the crypto extensions
+#else
+    return false;
+#endif
+}
+
+CipherSuite preferredCipherSuite() {
+    static const CipherSuite preferred = hasAesAcceleration() ? CipherSuite::Aes256Gcm
+                                                              : CipherSuite::ChaCha20Poly1305;
+    return preferred;
+}
+
+const char* cipherSuiteName(CipherSuite suite) {
+    switch (suite) {
+        case CipherSuite::Aes256Gcm:
+            return "AES-256-GCM";
+        case CipherSuite::ChaCha20Poly1305:
+            return "ChaCha20-Poly1305";
+    }
+    return "unknown";
+}
+
 std::vector<uint8_t> generateRandomBytes(int size) {
     std::vector<uint8_t> bytes(size);
     if (RAND_bytes(bytes.data(), size) != 1) {
@@ -37,179 +635,894 @@ std::vector<uint8_t> generateRandomBytes(int size) {
     return bytes;
 }
 
+
+std::string decrypt(const EncryptedData& encData, const std::string& password) {
+    // Derive key from password using stored salt
+    SecureBuffer key = deriveSecureKey(password, encData.salt, encData.kdf);
+    return decrypt(encData, key);
+}
+
 EncryptedData encrypt(const std::string& plaintext, const std::string& password) {
-    EncryptedData result;
+    // Fresh salt per call, so every call pays for a full key derivation
+    std::vector<uint8_t> salt = generateRandomBytes(SALT_SIZE);
+    KdfParams kdf;
+    SecureBuffer key = deriveSecureKey(password, salt, kdf);
+    Trace::Scope trace(Trace::Phase::Encrypt);
     
-    // Generate random salt and IV
-    result.salt = generateRandomBytes(SALT_SIZE);
+    EncryptedData result;
+    result.salt = salt;
+    result.kdf = kdf;
+    result.keyCheck = computeKeyCheck(key, salt, kdf);
     result.iv = generateRandomBytes(AES_IV_SIZE);
     
-    // Derive key from password
-    std::vector<uint8_t> key = deriveKey(password, result.salt);
+    // Initialize encryption
+    ScratchContext ctx;
+    if (EVP_EncryptInit_ex(ctx.get(), cbcCipher(), nullptr, key.data(), result.iv.data()) != 1) {
+        throw std::runtime_error("Encryption initialization failed");
+    }
+    
+    // Calculate maximum ciphertext length
+    int max_len = plaintext.length() + AES_BLOCK_SIZE;
+    result.ciphertext.resize(max_len);
     
-    // Initialize encryption context
-    EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();
-    if (!ctx) {
-        throw std::runtime_error("Failed to create cipher context");
+    int len = 0;
+    int total_len = 0;
+    
+    // Encrypt the plaintext
+    if (EVP_EncryptUpdate(ctx.get(), result.ciphertext.data(), &len,
+                         reinterpret_cast<const unsigned char*>(plaintext.c_str()),
+                         plaintext.length()) != 1) {
+        throw std::runtime_error("Encryption update failed");
     }
+    total_len += len;
     
-    try {
-        // Initialize encryption
-        if (EVP_EncryptInit_ex(ctx, EVP_aes_256_cbc(), nullptr, key.data(), result.iv.data()) != 1) {
-            throw std::runtime_error("Encryption initialization failed");
+    // Finalize encryption (add padding)
+    if (EVP_EncryptFinal_ex(ctx.get(), result.ciphertext.data() + total_len, &len) != 1) {
+        throw std::runtime_error("Encryption finalization failed");
+    }
+    total_len += len;
+    
+    // Resize to actual length
+    result.ciphertext.resize(total_len);
+    return result;
+}
+
+std::string decrypt(const EncryptedData& encData, const SecureBuffer& key) {
+    SecureBuffer plaintext;
+    size_t length = decrypt(viewOf(encData), key, plaintext);
+    return std::string(reinterpret_cast<const char*>(plaintext.data()), length);
+}
+
+size_t decrypt(const EncryptedView& encData, const SecureBuffer& key, SecureBuffer& plaintext) {
+    Trace::Scope trace(Trace::Phase::Decrypt);
+    if (key.size() != AES_KEY_SIZE) {
+        throw std::runtime_error("Invalid decryption key");
+    }
+    if (encData.iv.size != static_cast<size_t>(AES_IV_SIZE) || encData.ciphertext.size > INT_MAX) {
+        throw std::runtime_error("Invalid encrypted data format");
+    }
+    
+    ScratchContext ctx;
+    if (EVP_DecryptInit_ex(ctx.get(), cbcCipher(), nullptr, key.data(), encData.iv.data) != 1) {
+        throw std::runtime_error("Decryption initialization failed");
+    }
+    
+    // Padding only ever shrinks the output, so the ciphertext size is enough
+    plaintext = SecureBuffer(encData.ciphertext.size + AES_BLOCK_SIZE);
+    int len = 0;
+    int total_len = 0;
+    
+    // Decrypt the ciphertext
+    if (EVP_DecryptUpdate(ctx.get(), plaintext.data(), &len,
+                         encData.ciphertext.data, encData.ciphertext.size) != 1) {
+        throw std::runtime_error("Decryption update failed - incorrect password?");
+    }
+    total_len += len;
+    
+    // Finalize decryption (remove padding)
+    if (EVP_DecryptFinal_ex(ctx.get(), plaintext.data() + total_len, &len) != 1) {
+        plaintext.clear();
+        throw std::runtime_error("Decryption finalization failed - incorrect password?");
+    }
+    total_len += len;
+    
+    return total_len;
+}
+
+std::vector<uint8_t> computeKeyCheck(const SecureBuffer& key,
+                                     ByteSpan salt,
+                                     const KdfParams& kdf) {
+    static const char label[] = "SPMV-KEY-CHECK";
+    
+    auto appendWord = [](std::vector<uint8_t>& out, uint32_t value) {
+        for (int shift = 0; shift < 32; shift += 8) {
+            out.push_back((value >> shift) & 0xFF);
         }
-        
-        // Calculate maximum ciphertext length
-        int max_len = plaintext.length() + AES_BLOCK_SIZE;
-        result.ciphertext.resize(max_len);
-        
-        int len = 0;
-        int total_len = 0;
-        
-        // Encrypt the plaintext
-        if (EVP_EncryptUpdate(ctx, result.ciphertext.data(), &len,
-                             reinterpret_cast<const unsigned char*>(plaintext.c_str()),
-                             plaintext.length()) != 1) {
-            throw std::runtime_error("Encryption update failed");
+    };
+    
+    std::vector<uint8_t> message(label, label + sizeof(label) - 1);
+    appendWord(message, kdf.iterations);
+    message.insert(message.end(), salt.data, salt.data + salt.size);
+    // The other KDF parameters only exist from version 6; PBKDF2 vaults
+    // keep the check they have always had. The thread count only sets the
+    // speed, so it is left out.
+    if (kdf.algorithm != KdfAlgorithm::Pbkdf2Sha256) {
+        appendWord(message, static_cast<uint32_t>(kdf.algorithm));
+        appendWord(message, kdf.memoryKiB);
+        appendWord(message, kdf.parallelism);
+    }
+    
+    std::vector<uint8_t> check(KEY_CHECK_SIZE);
+    unsigned int checkLen = 0;
+    if (!HMAC(EVP_sha256(), key.data(), key.size(), message.data(), message.size(),
+              check.data(), &checkLen) || checkLen != check.size()) {
+        throw std::runtime_error("Key check computation failed");
+    }
+    return check;
+}
+
+bool verifyKey(const EncryptedData& encData, const SecureBuffer& key) {
+    return verifyKey(viewOf(encData), key);
+}
+
+bool verifyKey(const EncryptedView& encData, const SecureBuffer& key) {
+    if (encData.keyCheck.size != static_cast<size_t>(KEY_CHECK_SIZE)) {
+        return false;
+    }
+    std::vector<uint8_t> expected = computeKeyCheck(key, encData.salt, encData.kdf);
+    return CRYPTO_memcmp(expected.data(), encData.keyCheck.data, expected.size()) == 0;
+}
+
+SecureBuffer deriveSubkey(const SecureBuffer& key, const std::string& label) {
+    SecureBuffer subkey(AES_KEY_SIZE);
+    unsigned int subkeyLen = 0;
+    if (!HMAC(EVP_sha256(), key.data(), key.size(),
+              reinterpret_cast<const unsigned char*>(label.data()), label.size(),
+              subkey.data(), &subkeyLen) || subkeyLen != subkey.size()) {
+        throw std::runtime_error("Subkey derivation failed");
+    }
+    return subkey;
+}
+
+std::vector<uint8_t> sealRecord(const SecureBuffer& key, CipherSuite suite,
+                                const uint8_t* plaintext, size_t length,
+                                const uint8_t* aad, size_t aadLength) {
+    if (key.size() != AES_KEY_SIZE) {
+        throw std::runtime_error("Invalid encryption key");
+    }
+    
+    std::vector<uint8_t> sealed(GCM_NONCE_SIZE + length + GCM_TAG_SIZE);
+    if (RAND_bytes(sealed.data(), GCM_NONCE_SIZE) != 1) {
+        throw std::runtime_error("Random byte generation failed");
+    }
+    
+    ScratchContext ctx;
+    if (EVP_EncryptInit_ex(ctx.get(), aeadCipher(suite), nullptr, key.data(), nullptr) != 1) {
+        throw std::runtime_error("Encryption initialization failed");
+    }
+    aeadSeal(ctx.get(), sealed.data(), aad, aadLength, plaintext, length,
+             sealed.data() + GCM_NONCE_SIZE);
+    return sealed;
+}
+
+namespace {
+    // Verify and decrypt a sealed record into `out`, which must have room
+    // for length - GCM_NONCE_SIZE - GCM_TAG_SIZE bytes
+    bool openInto(const SecureBuffer& key, CipherSuite suite,
+                  const uint8_t* sealed, size_t length,
+                  const uint8_t* aad, size_t aadLength,
+                  uint8_t* out) {
+        if (key.size() != AES_KEY_SIZE) {
+            throw std::runtime_error("Invalid decryption key");
         }
-        total_len += len;
         
-        // Finalize encryption (add padding)
-        if (EVP_EncryptFinal_ex(ctx, result.ciphertext.data() + total_len, &len) != 1) {
-            throw std::runtime_error("Encryption finalization failed");
+        ScratchContext ctx;
+        if (EVP_DecryptInit_ex(ctx.get(), aeadCipher(suite), nullptr, key.data(), nullptr) != 1) {
+            throw std::runtime_error("Decryption initialization failed");
         }
-        total_len += len;
-        
-        // Resize to actual length
-        result.ciphertext.resize(total_len);
-        
+        return aeadOpen(ctx.get(), sealed, aad, aadLength, sealed + GCM_NONCE_SIZE,
+                        length - GCM_NONCE_SIZE, out);
+    }
+
+    const char KEY_WRAP_LABEL[] = "SPMV-DATA-KEY";
+}
+
+bool openRecord(const SecureBuffer& key, CipherSuite suite,
+                const uint8_t* sealed, size_t length,
+                const uint8_t* aad, size_t aadLength,
+                SecureString& plaintext) {
+    if (length < static_cast<size_t>(GCM_NONCE_SIZE + GCM_TAG_SIZE)) {
+        return false;
+    }
+    
+    plaintext.resize(length - GCM_NONCE_SIZE - GCM_TAG_SIZE);
+    if (!openInto(key, suite, sealed, length, aad, aadLength,
+                  reinterpret_cast<uint8_t*>(plaintext.data()))) {
+        plaintext.clear();
+        return false;
+    }
+    return true;
+}
+
+bool openRecord(const SecureBuffer& key, CipherSuite suite,
+                const uint8_t* sealed, size_t length,
+                const uint8_t* aad, size_t aadLength,
+                SecureBuffer& plaintext) {
+    if (length < static_cast<size_t>(GCM_NONCE_SIZE + GCM_TAG_SIZE)) {
+        return false;
+    }
+    
+    plaintext = SecureBuffer(length - GCM_NONCE_SIZE - GCM_TAG_SIZE);
+    if (!openInto(key, suite, sealed, length, aad, aadLength, plaintext.data())) {
+        plaintext.clear();
+        return false;
+    }
+    return true;
+}
+
+std::vector<uint8_t> wrapKey(const SecureBuffer& kek, const SecureBuffer& key,
+                             CipherSuite suite) {
+    return sealRecord(kek, suite, key.data(), key.size(),
+                      reinterpret_cast<const uint8_t*>(KEY_WRAP_LABEL), sizeof(KEY_WRAP_LABEL) - 1);
+}
+
+SecureBuffer unwrapKey(const SecureBuffer& kek, ByteSpan wrapped, CipherSuite suite) {
+    if (wrapped.size != static_cast<size_t>(GCM_NONCE_SIZE + AES_KEY_SIZE + GCM_TAG_SIZE)) {
+        return SecureBuffer();
+    }
+    
+    SecureBuffer key(AES_KEY_SIZE);
+    if (!openInto(kek, suite, wrapped.data, wrapped.size,
+                  reinterpret_cast<const uint8_t*>(KEY_WRAP_LABEL), sizeof(KEY_WRAP_LABEL) - 1,
+                  key.data())) {
+        return SecureBuffer();
+    }
+    return key;
+}
+
+// Cipher Implementation
+class Cipher::Lease {
+public:
+    Lease(const Cipher& cipher, bool encrypt)
+        : owner(cipher), encrypting(encrypt), ctx(cipher.acquire(encrypt)) {}
+    ~Lease() { owner.release(ctx, encrypting); }
+
+    Lease(const Lease&) = delete;
+    Lease& operator=(const Lease&) = delete;
+
+    EVP_CIPHER_CTX* get() const { return ctx; }
+
+private:
+    const Cipher& owner;
+    bool encrypting;
+    EVP_CIPHER_CTX* ctx;
+};
+
+Cipher::Cipher(const SecureBuffer& cipherKey, CipherSuite suite)
+    : key(AES_KEY_SIZE), cipherSuite(suite) {
+    if (cipherKey.size() != AES_KEY_SIZE) {
+        throw std::runtime_error("Invalid cipher key");
+    }
+    aeadCipher(suite); // Reject an unknown suite now rather than on first use
+    std::memcpy(key.data(), cipherKey.data(), key.size());
+}
+
+Cipher::~Cipher() {
+    // Freeing a context wipes its key schedule
+    for (EVP_CIPHER_CTX* ctx : idleEncryptors) {
+        EVP_CIPHER_CTX_free(ctx);
+    }
+    for (EVP_CIPHER_CTX* ctx : idleDecryptors) {
+        EVP_CIPHER_CTX_free(ctx);
+    }
+}
+
+EVP_CIPHER_CTX* Cipher::acquire(bool encrypt) const {
+    {
+        std::lock_guard<std::mutex> lock(poolMutex);
+        std::vector<EVP_CIPHER_CTX*>& idle = encrypt ? idleEncryptors : idleDecryptors;
+        if (!idle.empty()) {
+            EVP_CIPHER_CTX* ctx = idle.back();
+            idle.pop_back();
+            return ctx;
+        }
+    }
+    
+    // Pool is empty: set up one more context with the key schedule
+    CipherCtxPtr ctx = newCipherCtx();
+    int ok = encrypt
+        ? EVP_EncryptInit_ex(ctx.get(), aeadCipher(cipherSuite), nullptr, key.data(), nullptr)
+        : EVP_DecryptInit_ex(ctx.get(), aeadCipher(cipherSuite), nullptr, key.data(), nullptr);
+    if (ok != 1) {
+        throw std::runtime_error("Cipher initialization failed");
+    }
+    return ctx.release();
+}
+
+void Cipher::release(EVP_CIPHER_CTX* ctx, bool encrypt) const {
+    std::lock_guard<std::mutex> lock(poolMutex);
+    try {
+        (encrypt ? idleEncryptors : idleDecryptors).push_back(ctx);
     } catch (...) {
         EVP_CIPHER_CTX_free(ctx);
-        throw;
+    }
+}
+
+std::vector<uint8_t> Cipher::seal(const uint8_t* plaintext, size_t length,
+                                  const uint8_t* aad, size_t aadLength) const {
+    std::vector<uint8_t> sealed(GCM_NONCE_SIZE + length + GCM_TAG_SIZE);
+    if (RAND_bytes(sealed.data(), GCM_NONCE_SIZE) != 1) {
+        throw std::runtime_error("Random byte generation failed");
+    }
+    sealWithNonce(sealed.data(), aad, aadLength, plaintext, length,
+                  sealed.data() + GCM_NONCE_SIZE);
+    return sealed;
+}
+
+bool Cipher::open(const uint8_t* sealed, size_t length,
+                  const uint8_t* aad, size_t aadLength,
+                  SecureString& plaintext) const {
+    if (length < static_cast<size_t>(GCM_NONCE_SIZE + GCM_TAG_SIZE)) {
+        return false;
     }
     
-    EVP_CIPHER_CTX_free(ctx);
-    return result;
+    plaintext.resize(length - GCM_NONCE_SIZE - GCM_TAG_SIZE);
+    if (!openWithNonce(sealed, aad, aadLength, sealed + GCM_NONCE_SIZE, length - GCM_NONCE_SIZE,
+                       reinterpret_cast<uint8_t*>(plaintext.data()))) {
+        plaintext.clear();
+        return false;
+    }
+    return true;
 }
 
-std::string decrypt(const EncryptedData& encData, const std::string& password) {
-    // Derive key from password using stored salt
-    std::vector<uint8_t> key = deriveKey(password, encData.salt);
+bool Cipher::open(const uint8_t* sealed, size_t length,
+                  const uint8_t* aad, size_t aadLength,
+                  SecureBuffer& plaintext) const {
+    if (length < static_cast<size_t>(GCM_NONCE_SIZE + GCM_TAG_SIZE)) {
+        return false;
+    }
     
-    // Initialize decryption context
-    EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();
-    if (!ctx) {
-        throw std::runtime_error("Failed to create cipher context");
+    plaintext = SecureBuffer(length - GCM_NONCE_SIZE - GCM_TAG_SIZE);
+    if (!openWithNonce(sealed, aad, aadLength, sealed + GCM_NONCE_SIZE, length - GCM_NONCE_SIZE,
+                       plaintext.data())) {
+        plaintext.clear();
+        return false;
+    }
+    return true;
+}
+
+void Cipher::sealWithNonce(const uint8_t* nonce, const uint8_t* aad, size_t aadLength,
+                           const uint8_t* plaintext, size_t length, uint8_t* out) const {
+    Lease ctx(*this, true);
+    aeadSeal(ctx.get(), nonce, aad, aadLength, plaintext, length, out);
+}
+
+bool Cipher::openWithNonce(const uint8_t* nonce, const uint8_t* aad, size_t aadLength,
+                           const uint8_t* sealed, size_t length, uint8_t* out) const {
+    if (length < static_cast<size_t>(GCM_TAG_SIZE)) {
+        return false;
+    }
+    Lease ctx(*this, false);
+    return aeadOpen(ctx.get(), nonce, aad, aadLength, sealed, length, out);
+}
+
+// ThreadPool Implementation
+ThreadPool::ThreadPool(size_t threads)
+    : job(nullptr), jobCount(0), nextJob(0), unfinished(0), stopping(false) {
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
     }
+    workers.reserve(threads - 1);
+    for (size_t i = 1; i < threads; ++i) {
+        workers.emplace_back(&ThreadPool::workerLoop, this);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+void ThreadPool::run(size_t count, const std::function<void(size_t)>& fn) {
+    if (count == 0) return;
     
-    try {
-        // Initialize decryption
-        if (EVP_DecryptInit_ex(ctx, EVP_aes_256_cbc(), nullptr, key.data(), encData.iv.data()) != 1) {
-            throw std::runtime_error("Decryption initialization failed");
-        }
-        
-        // Allocate buffer for plaintext
-        std::vector<uint8_t> plaintext(encData.ciphertext.size() + AES_BLOCK_SIZE);
-        
-        int len = 0;
-        int total_len = 0;
+    std::lock_guard<std::mutex> serial(runMutex);
+    std::unique_lock<std::mutex> lock(mutex);
+    job = &fn;
+    jobCount = count;
+    nextJob = 0;
+    unfinished = count;
+    if (count > 1) {
+        wake.notify_all();
+    }
+    
+    drain(lock);
+    done.wait(lock, [this] { return unfinished == 0; });
+    
+    job = nullptr;
+    jobCount = 0;
+    nextJob = 0;
+    std::exception_ptr failure = error;
+    error = nullptr;
+    lock.unlock();
+    
+    if (failure) {
+        std::rethrow_exception(failure);
+    }
+}
+
+void ThreadPool::drain(std::unique_lock<std::mutex>& lock) {
+    while (nextJob < jobCount) {
+        size_t index = nextJob++;
+        const std::function<void(size_t)>* current = job;
+        lock.unlock();
         
-        // Decrypt the ciphertext
-        if (EVP_DecryptUpdate(ctx, plaintext.data(), &len,
-                             encData.ciphertext.data(), encData.ciphertext.size()) != 1) {
-            throw std::runtime_error("Decryption update failed - incorrect password?");
+        std::exception_ptr failure;
+        try {
+            (*current)(index);
+        } catch (...) {
+            failure = std::current_exception();
         }
-        total_len += len;
         
-        // Finalize decryption (remove padding)
-        if (EVP_DecryptFinal_ex(ctx, plaintext.data() + total_len, &len) != 1) {
-            throw std::runtime_error("Decryption finalization failed - incorrect password?");
+        lock.lock();
+        if (failure && !error) {
+            // Skip the jobs nobody has started; the run has failed anyway
+            error = failure;
+            unfinished -= jobCount - nextJob;
+            nextJob = jobCount;
         }
-        total_len += len;
-        
-        EVP_CIPHER_CTX_free(ctx);
+        if (--unfinished == 0) {
+            done.notify_all();
+        }
+    }
+}
+
+void ThreadPool::workerLoop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        wake.wait(lock, [this] { return stopping || nextJob < jobCount; });
+        if (stopping) return;
+        drain(lock);
+    }
+}
+
+namespace {
+    std::mutex sharedPoolMutex;
+    std::unique_ptr<ThreadPool> sharedPool;
+}
+
+ThreadPool& cryptoPool() {
+    std::lock_guard<std::mutex> lock(sharedPoolMutex);
+    if (!sharedPool) {
+        sharedPool.reset(new ThreadPool(0));
+    }
+    return *sharedPool;
+}
+
+void setCryptoThreads(size_t threads) {
+    std::lock_guard<std::mutex> lock(sharedPoolMutex);
+    sharedPool.reset();
+    sharedPool.reset(new ThreadPool(threads));
+}
+
+namespace {
+    size_t checkedChunkSize(size_t chunkSize) {
+        if (chunkSize == 0 || chunkSize > MAX_STREAM_CHUNK_SIZE) {
+            throw std::runtime_error("Invalid stream chunk size");
+        }
+        return chunkSize;
+    }
+
+    // Enough chunks per batch to keep every pool thread busy, as far as
+    // batchBytes allows
+    size_t batchChunksFor(size_t chunkSize, size_t batchBytes) {
+        size_t chunks = cryptoPool().size() * STREAM_CHUNKS_PER_THREAD;
+        return std::max<size_t>(1, std::min(chunks, batchBytes / chunkSize));
+    }
+
+    // Chunk nonce: [stream prefix][chunk number u32 BE][final flag]
+    void streamNonce(const uint8_t* prefix, uint32_t counter, bool final, uint8_t* nonce) {
+        std::memcpy(nonce, prefix, STREAM_NONCE_PREFIX_SIZE);
+        nonce[STREAM_NONCE_PREFIX_SIZE] = (counter >> 24) & 0xFF;
+        nonce[STREAM_NONCE_PREFIX_SIZE + 1] = (counter >> 16) & 0xFF;
+        nonce[STREAM_NONCE_PREFIX_SIZE + 2] = (counter >> 8) & 0xFF;
+        nonce[STREAM_NONCE_PREFIX_SIZE + 3] = counter & 0xFF;
+        nonce[STREAM_NONCE_PREFIX_SIZE + 4] = final ? 1 : 0;
+    }
+
+    // Chunk numbers first .. first + count - 1 must fit in 32 bits, and
+    // only the final chunk may take the last number
+    void checkChunkNumbers(uint32_t first, size_t count, bool final) {
+        if (static_cast<uint64_t>(first) + count > static_cast<uint64_t>(UINT32_MAX) + (final ? 1 : 0)) {
+            throw std::runtime_error("Stream too long");
+        }
+    }
+
+    // Split `count` chunks into one contiguous range per pool thread, so a
+    // batch costs one pool job per thread rather than one per chunk
+    void forEachChunkRange(size_t count, const std::function<void(size_t, size_t)>& work) {
+        ThreadPool& pool = cryptoPool();
+        size_t ranges = std::min(count, pool.size());
+        pool.run(ranges, [&](size_t range) {
+            work(count * range / ranges, count * (range + 1) / ranges);
+        });
+    }
+}
+
+size_t streamBufferSize(size_t chunkSize, size_t batchBytes) {
+    return (2 * chunkSize + GCM_TAG_SIZE) * batchChunksFor(checkedChunkSize(chunkSize), batchBytes);
+}
+
+// StreamEncryptor Implementation
+StreamEncryptor::StreamEncryptor(const Cipher& streamCipher, std::vector<uint8_t> chunkAad,
+                                 ChunkSink chunkSink, size_t size, size_t batchBytes)
+    : cipher(streamCipher), aad(std::move(chunkAad)), sink(std::move(chunkSink)),
+      chunkSize(checkedChunkSize(size)), batchChunks(batchChunksFor(chunkSize, batchBytes)),
+      counter(0),
+      pending(chunkSize * batchChunks), pendingSize(0),
+      sealed((chunkSize + GCM_TAG_SIZE) * batchChunks), finished(false) {
+    if (RAND_bytes(noncePrefix, sizeof(noncePrefix)) != 1) {
+        throw std::runtime_error("Random byte generation failed");
+    }
+    
+    uint8_t header[STREAM_HEADER_SIZE];
+    for (int i = 0; i < 4; ++i) {
+        header[i] = (chunkSize >> (8 * i)) & 0xFF;
+    }
+    std::memcpy(header + 4, noncePrefix, sizeof(noncePrefix));
+    sink(header, sizeof(header));
+}
+
+void StreamEncryptor::update(const uint8_t* data, size_t length) {
+    while (length > 0) {
+        size_t take = std::min(length, pending.size() - pendingSize);
+        std::memcpy(pending.data() + pendingSize, data, take);
+        pendingSize += take;
+        data += take;
+        length -= take;
         
-        // Convert to string
-        return std::string(reinterpret_cast<char*>(plaintext.data()), total_len);
+        // Full chunks are never the final one, so a full batch can go out
+        if (pendingSize == pending.size()) {
+            sealBatch(false);
+        }
+    }
+}
+
+void StreamEncryptor::finish() {
+    if (finished) {
+        throw std::runtime_error("Stream already finished");
+    }
+    sealBatch(true);
+    finished = true;
+}
+
+size_t StreamEncryptor::sealedSize(size_t plaintextSize, size_t chunkSize) {
+    return STREAM_HEADER_SIZE + plaintextSize + (plaintextSize / chunkSize + 1) * GCM_TAG_SIZE;
+}
+
+void StreamEncryptor::sealBatch(bool final) {
+    if (finished) {
+        throw std::runtime_error("Stream already finished");
+    }
+    
+    size_t full = pendingSize / chunkSize;
+    size_t lastLength = pendingSize - full * chunkSize; // Always 0 unless final
+    size_t chunks = full + (final ? 1 : 0);
+    checkChunkNumbers(counter, chunks, final);
+    
+    {
+        Trace::Scope trace(Trace::Phase::SealStream);
+        forEachChunkRange(chunks, [&](size_t first, size_t end) {
+            for (size_t i = first; i < end; ++i) {
+                bool last = final && i == full;
+                size_t length = last ? lastLength : chunkSize;
+                uint8_t nonce[GCM_NONCE_SIZE];
+                streamNonce(noncePrefix, static_cast<uint32_t>(counter + i), last, nonce);
+                cipher.sealWithNonce(nonce, aad.data(), aad.size(), pending.data() + i * chunkSize,
+                                     length, sealed.data() + i * (chunkSize + GCM_TAG_SIZE));
+            }
+        });
+    }
+    
+    size_t sealedLength = full * (chunkSize + GCM_TAG_SIZE) +
+                          (final ? lastLength + GCM_TAG_SIZE : 0);
+    OPENSSL_cleanse(pending.data(), pendingSize);
+    pendingSize = 0;
+    counter += chunks;
+    sink(sealed.data(), sealedLength);
+}
+
+// StreamDecryptor Implementation
+StreamDecryptor::StreamDecryptor(const Cipher& streamCipher, std::vector<uint8_t> chunkAad,
+                                 ChunkSink chunkSink, size_t batchLimit)
+    : cipher(streamCipher), aad(std::move(chunkAad)), sink(std::move(chunkSink)),
+      chunkSize(0), batchBytes(batchLimit), batchChunks(0), counter(0) {}
+
+void StreamDecryptor::update(const uint8_t* data, size_t length) {
+    if (chunkSize == 0) {
+        size_t take = std::min(length, STREAM_HEADER_SIZE - buffered.size());
+        buffered.insert(buffered.end(), data, data + take);
+        data += take;
+        length -= take;
+        if (buffered.size() < static_cast<size_t>(STREAM_HEADER_SIZE)) return;
         
+        size_t size = 0;
+        for (int i = 0; i < 4; ++i) {
+            size |= static_cast<size_t>(buffered[i]) << (8 * i);
+        }
+        chunkSize = checkedChunkSize(size);
+        std::memcpy(noncePrefix, buffered.data() + 4, sizeof(noncePrefix));
+        batchChunks = batchChunksFor(chunkSize, batchBytes);
+        plaintext = SecureBuffer(chunkSize * batchChunks);
+        queued.reserve(batchChunks);
+        buffered.clear();
+    }
+    
+    // Only the last chunk is short, so every full chunk can be queued as
+    // soon as it is complete
+    size_t fullChunk = chunkSize + GCM_TAG_SIZE;
+    while (length > 0) {
+        if (buffered.empty() && length >= fullChunk) {
+            queueChunk(data);
+            data += fullChunk;
+            length -= fullChunk;
+            continue;
+        }
+        size_t take = std::min(length, fullChunk - buffered.size());
+        buffered.insert(buffered.end(), data, data + take);
+        data += take;
+        length -= take;
+        if (buffered.size() == fullChunk) {
+            if (assembled.empty()) {
+                assembled.resize(fullChunk * batchChunks);
+            }
+            uint8_t* slot = assembled.data() + queued.size() * fullChunk;
+            std::memcpy(slot, buffered.data(), fullChunk);
+            buffered.clear();
+            queueChunk(slot);
+        }
+    }
+    
+    // Queued chunks may point into the caller's buffer
+    if (!queued.empty()) {
+        openBatch();
+    }
+}
+
+void StreamDecryptor::finish() {
+    if (chunkSize == 0 || buffered.size() < static_cast<size_t>(GCM_TAG_SIZE)) {
+        throw std::runtime_error("Truncated stream");
+    }
+    openBatch(buffered.data(), buffered.size());
+    buffered.clear();
+}
+
+void StreamDecryptor::queueChunk(const uint8_t* chunk) {
+    queued.push_back(chunk);
+    if (queued.size() == batchChunks) {
+        openBatch();
+    }
+}
+
+void StreamDecryptor::openBatch(const uint8_t* last, size_t lastLength) {
+    size_t full = queued.size();
+    bool final = last != nullptr;
+    size_t chunks = full + (final ? 1 : 0);
+    checkChunkNumbers(counter, chunks, final);
+    
+    size_t plainLength = full * chunkSize + (final ? lastLength - GCM_TAG_SIZE : 0);
+    try {
+        Trace::Scope trace(Trace::Phase::OpenStream);
+        forEachChunkRange(chunks, [&](size_t first, size_t end) {
+            for (size_t i = first; i < end; ++i) {
+                bool isLast = final && i == full;
+                const uint8_t* chunk = isLast ? last : queued[i];
+                size_t length = isLast ? lastLength : chunkSize + GCM_TAG_SIZE;
+                uint8_t nonce[GCM_NONCE_SIZE];
+                streamNonce(noncePrefix, static_cast<uint32_t>(counter + i), isLast, nonce);
+                if (!cipher.openWithNonce(nonce, aad.data(), aad.size(), chunk, length,
+                                          plaintext.data() + i * chunkSize)) {
+                    throw std::runtime_error("Stream chunk is not authentic");
+                }
+            }
+        });
     } catch (...) {
-        EVP_CIPHER_CTX_free(ctx);
+        OPENSSL_cleanse(plaintext.data(), plainLength);
+        queued.clear();
         throw;
     }
+    
+    queued.clear();
+    counter += chunks;
+    sink(plaintext.data(), plainLength);
+    OPENSSL_cleanse(plaintext.data(), plainLength);
 }
 
-std::vector<uint8_t> serialize(const EncryptedData& encData) {
-    std::vector<uint8_t> result;
+namespace {
+    // Container sizes are 4-byte little-endian integers
+    void appendSize(std::vector<uint8_t>& out, uint32_t size) {
+        out.push_back(size & 0xFF);
+        out.push_back((size >> 8) & 0xFF);
+        out.push_back((size >> 16) & 0xFF);
+        out.push_back((size >> 24) & 0xFF);
+    }
+}
+
+std::vector<uint8_t> serializeHeader(const EncryptedData& encData, uint32_t ciphertextSize) {
+    std::vector<uint8_t> result(VAULT_MAGIC, VAULT_MAGIC + sizeof(VAULT_MAGIC));
     
-    // Format: [salt_size][salt][iv_size][iv][ciphertext_size][ciphertext]
-    // Using 4-byte little-endian integers for sizes
+    // Format: [magic][version][iterations][suite][kdf][kdf_memory]
+    //         [kdf_parallelism][kdf_threads][salt_size][salt][check_size][check][wrapped_key_size][wrapped_key][iv_size][iv]
+    //         [ciphertext_size][ciphertext][secrets_size][secrets]
     
-    auto writeSize = [&](uint32_t size) {
-        result.push_back(size & 0xFF);
-        result.push_back((size >> 8) & 0xFF);
-        result.push_back((size >> 16) & 0xFF);
-        result.push_back((size >> 24) & 0xFF);
-    };
+    // Write header (magic already in place)
+    appendSize(result, VAULT_FORMAT_VERSION);
+    appendSize(result, encData.kdf.iterations);
+    appendSize(result, static_cast<uint32_t>(encData.cipherSuite));
+    appendSize(result, static_cast<uint32_t>(encData.kdf.algorithm));
+    appendSize(result, encData.kdf.memoryKiB);
+    appendSize(result, encData.kdf.parallelism);
+    appendSize(result, encData.kdf.threads);
     
     // Write salt
-    writeSize(encData.salt.size());
+    appendSize(result, encData.salt.size());
     result.insert(result.end(), encData.salt.begin(), encData.salt.end());
     
+    // Write key check
+    appendSize(result, encData.keyCheck.size());
+    result.insert(result.end(), encData.keyCheck.begin(), encData.keyCheck.end());
+    
+    // Write wrapped data key
+    appendSize(result, encData.wrappedKey.size());
+    result.insert(result.end(), encData.wrappedKey.begin(), encData.wrappedKey.end());
+    
     // Write IV
-    writeSize(encData.iv.size());
+    appendSize(result, encData.iv.size());
     result.insert(result.end(), encData.iv.begin(), encData.iv.end());
     
+    // The ciphertext itself follows
+    appendSize(result, ciphertextSize);
+    return result;
+}
+
+std::vector<uint8_t> serialize(const EncryptedData& encData) {
+    std::vector<uint8_t> result = serializeHeader(encData, encData.ciphertext.size());
+    result.reserve(result.size() + encData.ciphertext.size() + 4 + encData.secrets.size());
+    
     // Write ciphertext
-    writeSize(encData.ciphertext.size());
     result.insert(result.end(), encData.ciphertext.begin(), encData.ciphertext.end());
     
+    // Write sealed secrets
+    appendSize(result, encData.secrets.size());
+    result.insert(result.end(), encData.secrets.begin(), encData.secrets.end());
+    
     return result;
 }
 
 EncryptedData deserialize(const std::vector<uint8_t>& data) {
-    if (data.size() < 12) { // At least 3 size headers
+    EncryptedView view = deserializeView(data.data(), data.size());
+    
+    EncryptedData result;
+    result.version = view.version;
+    result.salt = view.salt.toVector();
+    result.iv = view.iv.toVector();
+    result.ciphertext = view.ciphertext.toVector();
+    result.kdf = view.kdf;
+    result.cipherSuite = view.cipherSuite;
+    result.keyCheck = view.keyCheck.toVector();
+    result.wrappedKey = view.wrappedKey.toVector();
+    result.secrets = view.secrets.toVector();
+    return result;
+}
+
+EncryptedView deserializeView(const uint8_t* data, size_t size) {
+    if (size < 12) { // At least 3 size headers
         throw std::runtime_error("Invalid encrypted data format");
     }
     
-    EncryptedData result;
+    EncryptedView result;
     size_t offset = 0;
     
     auto readSize = [&]() -> uint32_t {
-        if (offset + 4 > data.size()) {
+        if (offset + 4 > size) {
             throw std::runtime_error("Invalid encrypted data format");
         }
-        uint32_t size = data[offset] | (data[offset + 1] << 8) | 
-                       (data[offset + 2] << 16) | (data[offset + 3] << 24);
+        uint32_t value = data[offset] | (data[offset + 1] << 8) |
+                        (data[offset + 2] << 16) | (static_cast<uint32_t>(data[offset + 3]) << 24);
         offset += 4;
-        return size;
+        return value;
     };
     
-    auto readBytes = [&](uint32_t size) -> std::vector<uint8_t> {
-        if (offset + size > data.size()) {
+    auto readBytes = [&](uint32_t length) -> ByteSpan {
+        if (length > size - offset) {
             throw std::runtime_error("Invalid encrypted data format");
         }
-        std::vector<uint8_t> bytes(data.begin() + offset, data.begin() + offset + size);
-        offset += size;
+        ByteSpan bytes(data + offset, length);
+        offset += length;
         return bytes;
     };
     
+    // Legacy (v1) files start directly with the salt size
+    bool hasHeader = std::equal(VAULT_MAGIC, VAULT_MAGIC + sizeof(VAULT_MAGIC), data);
+    result.version = 1;
+    if (hasHeader) {
+        offset += sizeof(VAULT_MAGIC);
+        result.version = readSize();
+        if (result.version < 2 || result.version > VAULT_FORMAT_VERSION) {
+            throw std::runtime_error("Unsupported vault format version");
+        }
+        result.kdf.iterations = readSize();
+    }
+    
+    // Read cipher suite; earlier envelope versions are all AES-256-GCM
+    if (result.version >= 5) {
+        uint32_t suite = readSize();
+        if (suite != static_cast<uint32_t>(CipherSuite::Aes256Gcm) &&
+            suite != static_cast<uint32_t>(CipherSuite::ChaCha20Poly1305)) {
+            throw std::runtime_error("Unsupported cipher suite");
+        }
+        result.cipherSuite = static_cast<CipherSuite>(suite);
+    }
+    
+    // Read KDF; earlier versions are all PBKDF2
+    if (result.version >= 6) {
+        uint32_t algorithm = readSize();
+        if (algorithm < static_cast<uint32_t>(KdfAlgorithm::Pbkdf2Sha256) ||
+            algorithm > static_cast<uint32_t>(KdfAlgorithm::Argon2id)) {
+            throw std::runtime_error("Unsupported key derivation function");
+        }
+        result.kdf.algorithm = static_cast<KdfAlgorithm>(algorithm);
+        result.kdf.memoryKiB = readSize();
+        result.kdf.parallelism = readSize();
+    }
+    if (result.version >= 7) {
+        result.kdf.threads = readSize();
+    }
+    try {
+        validateKdfParams(result.kdf);
+    } catch (const std::runtime_error&) {
+        throw std::runtime_error("Invalid encrypted data format");
+    }
+    
     // Read salt
-    uint32_t saltSize = readSize();
-    result.salt = readBytes(saltSize);
+    result.salt = readBytes(readSize());
+    
+    // Read key check
+    if (hasHeader) {
+        result.keyCheck = readBytes(readSize());
+    }
+    
+    // Read wrapped data key
+    if (result.version >= 3) {
+        result.wrappedKey = readBytes(readSize());
+    }
     
     // Read IV
-    uint32_t ivSize = readSize();
-    result.iv = readBytes(ivSize);
+    result.iv = readBytes(readSize());
     
     // Read ciphertext
-    uint32_t cipherSize = readSize();
-    result.ciphertext = readBytes(cipherSize);
+    result.ciphertext = readBytes(readSize());
+    
+    // Read sealed secrets
+    if (result.version >= 3) {
+        result.secrets = readBytes(readSize());
+    }
     
     return result;
 }
 
 bool verifyPassword(const EncryptedData& encData, const std::string& password) {
     try {
+        if (!encData.keyCheck.empty()) {
+            SecureBuffer key = deriveSecureKey(password, encData.salt, encData.kdf);
+            return verifyKey(encData, key);
+        }
         decrypt(encData, password);
         return true;
     } catch (const std::exception&) {
@@ -1,9 +1,20 @@
 #ifndef CRYPTO_HPP
 #define CRYPTO_HPP
 
+#include "secure_memory.hpp"
 #include <string>
 #include <vector>
 #include <cstdint>
+#include <cstddef>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <chrono>
+
+// OpenSSL cipher context, kept opaque here
+struct evp_cipher_ctx_st;
 
 namespace Crypto {
     // Constants for encryption
@@ -11,14 +22,162 @@ namespace Crypto {
     const int AES_IV_SIZE = 16;   // 128 bits
     const int SALT_SIZE = 16;     // 128 bits for PBKDF2
     const int PBKDF2_ITERATIONS = 100000;
+    const int KEY_CHECK_SIZE = 32;  // HMAC-SHA256 output
+    const int GCM_NONCE_SIZE = 12;  // 96-bit nonce for AEAD records (either suite)
+    const int GCM_TAG_SIZE = 16;    // 128-bit authentication tag
+
+    // Password-based key derivation a vault's session key comes from
+    enum class KdfAlgorithm : uint32_t {
+        Pbkdf2Sha256 = 1,   // Version 5 and older vaults
+        Scrypt = 2,         // Memory-hard; r = SCRYPT_BLOCK_SIZE
+        Argon2id = 3        // Memory-hard; needs OpenSSL 3.2 or later
+    };
+
+    const uint32_t SCRYPT_BLOCK_SIZE = 8;                   // scrypt r: 1 KiB per unit of N
+    const uint32_t MAX_KDF_MEMORY_KIB = 4 * 1024 * 1024;    // 4 GiB; most one derivation allocates
+    const uint32_t MAX_KDF_PARALLELISM = 255;
+    // calibrateKdf() never goes below these, whatever the latency target
+    const uint32_t MIN_SCRYPT_MEMORY_KIB = 32 * 1024;       // N = 2^15
+    const uint32_t MIN_ARGON2_MEMORY_KIB = 64 * 1024;       // RFC 9106, second recommendation
+    const uint32_t ARGON2_PASSES = 3;
+    const uint32_t MAX_CALIBRATED_MEMORY_KIB = 1024 * 1024; // 1 GiB
+
+    /**
+     * KDF algorithm and cost, as recorded in the vault header
+     */
+    struct KdfParams {
+        KdfAlgorithm algorithm = KdfAlgorithm::Pbkdf2Sha256;
+        uint32_t iterations = PBKDF2_ITERATIONS; // PBKDF2 iterations or Argon2 passes; 1 for scrypt
+        uint32_t memoryKiB = 0;                  // scrypt N (a power of two) or Argon2 memory
+        uint32_t parallelism = 1;                // scrypt p or Argon2 lanes
+        uint32_t threads = 1;                    // Threads the lanes run on; does not change the key
+    };
+
+    // AEAD that seals a vault's records, wrapped key and index stream. Both
+    // take a 256-bit key and a 96-bit nonce and give a 128-bit tag, so every
+    // format built on them is the same for either suite.
+    enum class CipherSuite : uint32_t {
+        Aes256Gcm = 1,          // Fastest where the CPU has AES and CLMUL
+        ChaCha20Poly1305 = 2    // Constant-time and fast in plain software
+    };
+
+    // Chunked streams: plaintext is sealed in chunks of this size, each
+    // with its own tag, so neither side holds more than one chunk
+    const size_t STREAM_CHUNK_SIZE = 64 * 1024;
+    const size_t MAX_STREAM_CHUNK_SIZE = 16 * 1024 * 1024;
+    const int STREAM_NONCE_PREFIX_SIZE = 7;
+    const int STREAM_HEADER_SIZE = 4 + STREAM_NONCE_PREFIX_SIZE;
+    // Chunks are sealed and opened in batches, this many per crypto
+    // thread, bounded by STREAM_BATCH_BYTES of plaintext
+    const size_t STREAM_CHUNKS_PER_THREAD = 4;
+    const size_t STREAM_BATCH_BYTES = 8 * 1024 * 1024;
+
+    // Vault container format written by serialize(). Version 2 holds one
+    // AES-256-CBC payload; version 3 adds envelope encryption (a wrapped
+    // data key, a sealed index and individually sealed secrets); version 4
+    // seals the index as a chunked stream; version 5 records the cipher
+    // suite (older envelope versions are AES-256-GCM); version 6 records
+    // the KDF algorithm and its memory and parallelism costs (older
+    // versions use PBKDF2); version 7 records how many threads the KDF
+    // lanes run on (older versions use one).
+    const uint32_t VAULT_FORMAT_VERSION = 7;
 
     // Structure to hold encrypted data with metadata
     struct EncryptedData {
+        uint32_t version = VAULT_FORMAT_VERSION; // Container version read from disk
         std::vector<uint8_t> salt;
-        std::vector<uint8_t> iv;
-        std::vector<uint8_t> ciphertext;
+        std::vector<uint8_t> iv;                 // v3: snapshot id, the index's AAD
+        std::vector<uint8_t> ciphertext;         // v3: sealed index
+        KdfParams kdf;                           // KDF the key was derived with
+        CipherSuite cipherSuite = CipherSuite::Aes256Gcm; // v5: AEAD of the envelope
+        std::vector<uint8_t> keyCheck;           // Empty for legacy (v1) containers
+        std::vector<uint8_t> wrappedKey;         // v3: data key sealed under the derived key
+        std::vector<uint8_t> secrets;            // v3: sealed secrets, in index order
+    };
+
+    /**
+     * Non-owning view of a byte range, e.g. part of a memory-mapped file
+     */
+    struct ByteSpan {
+        const uint8_t* data = nullptr;
+        size_t size = 0;
+
+        ByteSpan() = default;
+        ByteSpan(const uint8_t* bytes, size_t length) : data(bytes), size(length) {}
+        ByteSpan(const std::vector<uint8_t>& bytes) : data(bytes.data()), size(bytes.size()) {}
+
+        bool empty() const { return size == 0; }
+        std::vector<uint8_t> toVector() const { return std::vector<uint8_t>(data, data + size); }
+    };
+
+    /**
+     * Parsed container whose fields point into a buffer owned by the
+     * caller (see deserializeView); nothing is copied
+     */
+    struct EncryptedView {
+        uint32_t version = VAULT_FORMAT_VERSION;
+        ByteSpan salt;
+        ByteSpan iv;
+        ByteSpan ciphertext;
+        KdfParams kdf;
+        CipherSuite cipherSuite = CipherSuite::Aes256Gcm;
+        ByteSpan keyCheck;
+        ByteSpan wrappedKey;
+        ByteSpan secrets;
     };
 
+    /**
+     * Owning fixed-size buffer for keys and decrypted data, held in
+     * secureArena(): locked into RAM where the platform allows it, kept
+     * out of core dumps and wiped before it is released.
+     */
+    class SecureBuffer {
+    public:
+        SecureBuffer() = default;
+        explicit SecureBuffer(size_t size);
+        ~SecureBuffer();
+
+        SecureBuffer(const SecureBuffer&) = delete;
+        SecureBuffer& operator=(const SecureBuffer&) = delete;
+        SecureBuffer(SecureBuffer&& other) noexcept;
+        SecureBuffer& operator=(SecureBuffer&& other) noexcept;
+
+        uint8_t* data() { return bytes; }
+        const uint8_t* data() const { return bytes; }
+        size_t size() const { return length; }
+        bool empty() const { return length == 0; }
+
+        /**
+         * Wipe the contents and release the memory
+         */
+        void clear();
+
+    private:
+        uint8_t* bytes = nullptr;
+        size_t length = 0;
+    };
+
+    /**
+     * Check whether the CPU has the instructions OpenSSL uses for fast,
+     * constant-time AES-GCM: AES-NI and PCLMULQDQ on x86, the AES and
+     * PMULL crypto extensions on 64-bit ARM
+     * @return true if AES-GCM is hardware accelerated
+     */
+    bool hasAesAcceleration();
+
+    /**
+     * Pick the cipher suite for a new vault: AES-256-GCM where the CPU
+     * accelerates it, ChaCha20-Poly1305 everywhere else
+     * @return Preferred suite for this host
+     */
+    CipherSuite preferredCipherSuite();
+
+    /**
+     * @param suite Cipher suite
+     * @return Display name, e.g. "AES-256-GCM"
+     */
+    const char* cipherSuiteName(CipherSuite suite);
+
     /**
      * Derive encryption key from master password using PBKDF2
      * @param password Master password
@@ -30,6 +189,101 @@ namespace Crypto {
                                   const std::vector<uint8_t>& salt, 
                                   int iterations = PBKDF2_ITERATIONS);
 
+    /**
+     * Derive an encryption key into locked memory, for keys that outlive a
+     * single call (e.g. the session key of an unlocked vault)
+     * @param password Master password
+     * @param salt Random salt for key derivation
+     * @param iterations Number of PBKDF2 iterations
+     * @return 256-bit derived key
+     */
+    SecureBuffer deriveSecureKey(const std::string& password,
+                                 ByteSpan salt,
+                                 int iterations = PBKDF2_ITERATIONS);
+
+    /**
+     * Derive an encryption key into locked memory with any supported KDF
+     * @param password Master password
+     * @param salt Random salt for key derivation
+     * @param kdf Algorithm and cost; checked with validateKdfParams()
+     * @return 256-bit derived key
+     */
+    SecureBuffer deriveSecureKey(const std::string& password,
+                                 ByteSpan salt,
+                                 const KdfParams& kdf);
+
+    /**
+     * Reject KDF parameters the algorithm cannot use, or whose memory cost
+     * passes MAX_KDF_MEMORY_KIB, e.g. from a tampered header. The thread
+     * count is not part of the key; scrypt runs on fewer threads when
+     * their tables would pass the cap together.
+     * @param kdf Parameters to check
+     * @throws std::runtime_error if they are invalid
+     */
+    void validateKdfParams(const KdfParams& kdf);
+
+    /**
+     * scrypt (RFC 7914), with the p lanes spread over the crypto pool.
+     * Each thread holds a 128 * r * n byte table; fewer than `threads` run
+     * if the tables would pass MAX_KDF_MEMORY_KIB together.
+     * @param password Password
+     * @param salt Salt
+     * @param n CPU/memory cost, a power of two
+     * @param r Block size
+     * @param p Parallelization
+     * @param threads Most threads to run lanes on; does not change the output
+     * @param out Receives the derived bytes
+     * @param outLength Bytes to derive
+     * @throws std::runtime_error if the parameters are invalid or one
+     *         table alone would pass MAX_KDF_MEMORY_KIB
+     */
+    void scrypt(const std::string& password, ByteSpan salt, uint64_t n, uint32_t r, uint32_t p,
+                uint32_t threads, uint8_t* out, size_t outLength);
+
+    /**
+     * @param algorithm KDF algorithm
+     * @return true if this build of OpenSSL provides it
+     */
+    bool isKdfSupported(KdfAlgorithm algorithm);
+
+    /**
+     * Pick the KDF for a new vault: Argon2id where OpenSSL provides it,
+     * scrypt otherwise
+     * @return Preferred memory-hard algorithm for this host
+     */
+    KdfAlgorithm preferredKdf();
+
+    /**
+     * Time the KDF on this host and pick a cost that takes about `target`
+     * per derivation. Memory is raised before passes; the result never
+     * drops below the MIN_*_MEMORY_KIB floors or PBKDF2_ITERATIONS. Lanes
+     * run on up to one thread each, as many as the host has.
+     * @param algorithm KDF algorithm
+     * @param target Derivation time to aim for, e.g. 250 ms
+     * @param parallelism scrypt p or Argon2 lanes (ignored for PBKDF2)
+     * @return Calibrated parameters
+     */
+    KdfParams calibrateKdf(KdfAlgorithm algorithm, std::chrono::milliseconds target,
+                           uint32_t parallelism = 1);
+
+    /**
+     * @param algorithm KDF algorithm
+     * @return Display name, e.g. "scrypt"
+     */
+    const char* kdfName(KdfAlgorithm algorithm);
+
+    /**
+     * @param kdf KDF parameters
+     * @return Name and cost, e.g. "scrypt (N=2^16, r=8, p=4, 64 MiB, 4 threads)"
+     */
+    std::string describeKdf(const KdfParams& kdf);
+
+    /**
+     * Generate a random 256-bit key in locked memory
+     * @return Random key
+     */
+    SecureBuffer generateSecureKey();
+
     /**
      * Generate cryptographically secure random bytes
      * @param size Number of bytes to generate
@@ -38,7 +292,9 @@ namespace Crypto {
     std::vector<uint8_t> generateRandomBytes(int size);
 
     /**
-     * Encrypt plaintext using AES-256-CBC
+     * Encrypt plaintext using AES-256-CBC. This is the payload format of
+     * version 1 and 2 containers, kept for reading and migrating them;
+     * vaults are now sealed with sealRecord() and StreamEncryptor.
      * @param plaintext Data to encrypt
      * @param password Master password for key derivation
      * @return EncryptedData structure containing salt, IV, and ciphertext
@@ -53,6 +309,420 @@ namespace Crypto {
      */
     std::string decrypt(const EncryptedData& encData, const std::string& password);
 
+    /**
+     * Decrypt ciphertext using AES-256-CBC with an already derived key
+     * @param encData EncryptedData structure containing encrypted data
+     * @param key 256-bit key matching encData.salt
+     * @return Decrypted plaintext string
+     */
+    std::string decrypt(const EncryptedData& encData, const SecureBuffer& key);
+
+    /**
+     * Decrypt ciphertext using AES-256-CBC straight into locked memory
+     * @param encData Container view holding the encrypted data
+     * @param key 256-bit key matching encData.salt
+     * @param plaintext Receives the plaintext; may be larger than needed
+     * @return Plaintext length in bytes
+     */
+    size_t decrypt(const EncryptedView& encData, const SecureBuffer& key, SecureBuffer& plaintext);
+
+    /**
+     * Compute the key-check value stored in the container header. It is an
+     * HMAC over the KDF parameters, so it authenticates the header and lets
+     * a wrong key be rejected without decrypting the payload.
+     * @param key Derived key
+     * @param salt Salt the key was derived with
+     * @param kdf KDF the key was derived with
+     * @return KEY_CHECK_SIZE bytes
+     */
+    std::vector<uint8_t> computeKeyCheck(const SecureBuffer& key,
+                                         ByteSpan salt,
+                                         const KdfParams& kdf);
+
+    /**
+     * Check a derived key against the key-check value of a container
+     * @param encData Container whose header holds the key check
+     * @param key Key derived from encData.salt and encData.kdf
+     * @return true if the key matches, false otherwise or if the container
+     *         carries no key check (legacy format)
+     */
+    bool verifyKey(const EncryptedData& encData, const SecureBuffer& key);
+    bool verifyKey(const EncryptedView& encData, const SecureBuffer& key);
+
+    /**
+     * Derive an independent subkey from a session key, so one derived key
+     * can serve several purposes without reusing it directly
+     * @param key Parent key
+     * @param label Purpose label, e.g. "SPMV-JOURNAL"
+     * @return 256-bit subkey (HMAC-SHA256 of the label under key)
+     */
+    SecureBuffer deriveSubkey(const SecureBuffer& key, const std::string& label);
+
+    /**
+     * Encrypt and authenticate a small record
+     * @param key 256-bit key
+     * @param suite AEAD to seal with
+     * @param plaintext Record contents
+     * @param length Record length in bytes
+     * @param aad Additional data bound to the record but not encrypted
+     * @param aadLength Length of aad in bytes
+     * @return Sealed record: [nonce][ciphertext][tag]
+     */
+    std::vector<uint8_t> sealRecord(const SecureBuffer& key, CipherSuite suite,
+                                    const uint8_t* plaintext, size_t length,
+                                    const uint8_t* aad, size_t aadLength);
+
+    /**
+     * Verify and decrypt a record produced by sealRecord()
+     * @param key 256-bit key
+     * @param suite AEAD the record was sealed with
+     * @param sealed Sealed record
+     * @param length Sealed record length in bytes
+     * @param aad Additional data the record was sealed with
+     * @param aadLength Length of aad in bytes
+     * @param plaintext Receives the record contents
+     * @return true if the record is authentic, false if it was corrupted,
+     *         truncated or sealed under a different key or aad
+     */
+    bool openRecord(const SecureBuffer& key, CipherSuite suite,
+                    const uint8_t* sealed, size_t length,
+                    const uint8_t* aad, size_t aadLength,
+                    SecureString& plaintext);
+
+    /**
+     * Verify and decrypt a record produced by sealRecord() into locked memory
+     * @param key 256-bit key
+     * @param suite AEAD the record was sealed with
+     * @param sealed Sealed record
+     * @param length Sealed record length in bytes
+     * @param aad Additional data the record was sealed with
+     * @param aadLength Length of aad in bytes
+     * @param plaintext Receives the record contents
+     * @return true if the record is authentic
+     */
+    bool openRecord(const SecureBuffer& key, CipherSuite suite,
+                    const uint8_t* sealed, size_t length,
+                    const uint8_t* aad, size_t aadLength,
+                    SecureBuffer& plaintext);
+
+    /**
+     * Seal a data key under a key-encryption key
+     * @param kek Key-encryption key (e.g. the password-derived key)
+     * @param key Key to wrap
+     * @param suite AEAD to seal with
+     * @return Wrapped key, safe to store on disk
+     */
+    std::vector<uint8_t> wrapKey(const SecureBuffer& kek, const SecureBuffer& key,
+                                 CipherSuite suite);
+
+    /**
+     * Recover a data key sealed by wrapKey()
+     * @param kek Key-encryption key
+     * @param wrapped Wrapped key
+     * @param suite AEAD the key was wrapped with
+     * @return Unwrapped key, or an empty buffer if the wrapped key is not
+     *         authentic under kek
+     */
+    SecureBuffer unwrapKey(const SecureBuffer& kek, ByteSpan wrapped, CipherSuite suite);
+
+    /**
+     * One key and cipher suite, ready to seal and open any number of
+     * buffers. Contexts are set up with the key once and kept in a pool,
+     * so each call only sets a nonce and runs the AEAD; safe to use from
+     * several threads at once. The key schedules are wiped when the
+     * Cipher is destroyed.
+     */
+    class Cipher {
+    public:
+        /**
+         * @param key 256-bit key, copied into locked memory
+         * @param suite AEAD to use
+         */
+        Cipher(const SecureBuffer& key, CipherSuite suite);
+        ~Cipher();
+
+        Cipher(const Cipher&) = delete;
+        Cipher& operator=(const Cipher&) = delete;
+
+        CipherSuite suite() const { return cipherSuite; }
+
+        /**
+         * Seal a record under a fresh random nonce (same format as
+         * sealRecord())
+         * @param plaintext Record contents
+         * @param length Record length in bytes
+         * @param aad Additional data bound to the record but not encrypted
+         * @param aadLength Length of aad in bytes
+         * @return Sealed record: [nonce][ciphertext][tag]
+         */
+        std::vector<uint8_t> seal(const uint8_t* plaintext, size_t length,
+                                  const uint8_t* aad, size_t aadLength) const;
+
+        /**
+         * Verify and decrypt a record produced by seal() or sealRecord()
+         * @param sealed Sealed record
+         * @param length Sealed record length in bytes
+         * @param aad Additional data the record was sealed with
+         * @param aadLength Length of aad in bytes
+         * @param plaintext Receives the record contents
+         * @return true if the record is authentic
+         */
+        bool open(const uint8_t* sealed, size_t length,
+                  const uint8_t* aad, size_t aadLength,
+                  SecureString& plaintext) const;
+        bool open(const uint8_t* sealed, size_t length,
+                  const uint8_t* aad, size_t aadLength,
+                  SecureBuffer& plaintext) const;
+
+        /**
+         * Encrypt under a caller-chosen nonce, which must never repeat
+         * for this key
+         * @param nonce GCM_NONCE_SIZE bytes
+         * @param aad Additional data
+         * @param aadLength Length of aad in bytes
+         * @param plaintext Data to encrypt
+         * @param length Plaintext length in bytes
+         * @param out Receives [ciphertext][tag], length + GCM_TAG_SIZE bytes
+         */
+        void sealWithNonce(const uint8_t* nonce, const uint8_t* aad, size_t aadLength,
+                           const uint8_t* plaintext, size_t length, uint8_t* out) const;
+
+        /**
+         * Verify and decrypt [ciphertext][tag] sealed under a known nonce
+         * @param nonce GCM_NONCE_SIZE bytes
+         * @param aad Additional data
+         * @param aadLength Length of aad in bytes
+         * @param sealed Ciphertext followed by the tag
+         * @param length Sealed length in bytes, at least GCM_TAG_SIZE
+         * @param out Receives length - GCM_TAG_SIZE bytes; wiped on failure
+         * @return true if authentic
+         */
+        bool openWithNonce(const uint8_t* nonce, const uint8_t* aad, size_t aadLength,
+                           const uint8_t* sealed, size_t length, uint8_t* out) const;
+
+    private:
+        class Lease;    // Borrows a pooled context for one operation
+
+        evp_cipher_ctx_st* acquire(bool encrypt) const;
+        void release(evp_cipher_ctx_st* ctx, bool encrypt) const;
+
+        SecureBuffer key;
+        CipherSuite cipherSuite;
+        mutable std::mutex poolMutex;
+        mutable std::vector<evp_cipher_ctx_st*> idleEncryptors;  // Keyed, ready for a nonce
+        mutable std::vector<evp_cipher_ctx_st*> idleDecryptors;
+    };
+
+    /**
+     * Fixed set of worker threads for splitting crypto work into
+     * independent jobs. The calling thread takes jobs too, so a pool of
+     * one thread runs everything inline.
+     */
+    class ThreadPool {
+    public:
+        /**
+         * @param threads Threads to run jobs on, the caller included
+         *        (0 means one per hardware thread)
+         */
+        explicit ThreadPool(size_t threads);
+        ~ThreadPool();
+
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        /**
+         * Run job(0) .. job(count - 1) across the pool and wait for all of
+         * them. Calls from several threads are served one at a time.
+         * @param count Number of jobs
+         * @param job Callable taking the job index
+         * @throws The first exception thrown by a job, once all have ended
+         */
+        void run(size_t count, const std::function<void(size_t)>& job);
+
+        size_t size() const { return workers.size() + 1; }
+
+    private:
+        void workerLoop();
+        // Take and run jobs until none are left; expects `mutex` held
+        void drain(std::unique_lock<std::mutex>& lock);
+
+        std::vector<std::thread> workers;
+        std::mutex runMutex;                       // One run() at a time
+        std::mutex mutex;                          // Guards everything below
+        std::condition_variable wake;
+        std::condition_variable done;
+        const std::function<void(size_t)>* job;
+        size_t jobCount;
+        size_t nextJob;
+        size_t unfinished;
+        std::exception_ptr error;
+        bool stopping;
+    };
+
+    /**
+     * Shared pool used by the chunked streams, created on first use with
+     * one thread per hardware thread
+     * @return The pool
+     */
+    ThreadPool& cryptoPool();
+
+    /**
+     * Resize the shared pool. Must not be called while crypto work is
+     * running on it.
+     * @param threads Thread count, caller included (0 means one per
+     *        hardware thread)
+     */
+    void setCryptoThreads(size_t threads);
+
+    // Receives output of a stream, one or more whole chunks at a time
+    using ChunkSink = std::function<void(const uint8_t* data, size_t length)>;
+
+    /**
+     * Seals a stream of any length with an AEAD in fixed-size chunks.
+     * Each chunk's nonce is a random per-stream prefix, the chunk number
+     * and a final-chunk flag, so chunks cannot be reordered, dropped or
+     * cut off without detection. Since chunks do not depend on each
+     * other, they are sealed a batch at a time across cryptoPool() and
+     * passed to the sink in order. Memory use is one batch.
+     *
+     * Stream layout: [chunk size u32][nonce prefix], then for each chunk
+     * [ciphertext][tag]. Every chunk but the last is full; the last holds
+     * the remaining 0..chunk size bytes.
+     */
+    class StreamEncryptor {
+    public:
+        /**
+         * Start a stream; the header goes to the sink right away
+         * @param cipher Key and AEAD to seal with; must outlive the stream
+         * @param aad Additional data bound to every chunk
+         * @param sink Receives the sealed stream
+         * @param chunkSize Plaintext bytes per chunk
+         * @param batchBytes Most plaintext to seal per batch; at least one
+         *        chunk is always sealed at a time
+         */
+        StreamEncryptor(const Cipher& cipher, std::vector<uint8_t> aad, ChunkSink sink,
+                        size_t chunkSize = STREAM_CHUNK_SIZE,
+                        size_t batchBytes = STREAM_BATCH_BYTES);
+
+        StreamEncryptor(const StreamEncryptor&) = delete;
+        StreamEncryptor& operator=(const StreamEncryptor&) = delete;
+
+        /**
+         * Add plaintext, sealing every batch of chunks that fills up
+         * @param data Plaintext
+         * @param length Plaintext length in bytes
+         */
+        void update(const uint8_t* data, size_t length);
+
+        /**
+         * Seal the buffered chunks and the final one. Must be called
+         * exactly once.
+         */
+        void finish();
+
+        /**
+         * Size of the sealed stream for a given plaintext size
+         * @param plaintextSize Total plaintext bytes
+         * @param chunkSize Plaintext bytes per chunk
+         * @return Stream size in bytes, header included
+         */
+        static size_t sealedSize(size_t plaintextSize, size_t chunkSize = STREAM_CHUNK_SIZE);
+
+    private:
+        // Seal the pending plaintext: its full chunks and, if final, the
+        // short last chunk after them
+        void sealBatch(bool final);
+
+        const Cipher& cipher;
+        std::vector<uint8_t> aad;
+        ChunkSink sink;
+        size_t chunkSize;
+        size_t batchChunks;
+        uint8_t noncePrefix[STREAM_NONCE_PREFIX_SIZE];
+        uint32_t counter;              // Number of the first pending chunk
+        SecureBuffer pending;          // Plaintext of the batch being filled
+        size_t pendingSize;
+        std::vector<uint8_t> sealed;   // Output of the last sealed batch
+        bool finished;
+    };
+
+    /**
+     * Buffer memory a StreamEncryptor or StreamDecryptor holds while it
+     * runs: one batch of plaintext and one of sealed chunks
+     * @param chunkSize Plaintext bytes per chunk
+     * @param batchBytes Batch limit the stream is created with
+     * @return Size in bytes
+     */
+    size_t streamBufferSize(size_t chunkSize = STREAM_CHUNK_SIZE,
+                            size_t batchBytes = STREAM_BATCH_BYTES);
+
+    /**
+     * Opens a stream written by StreamEncryptor. Complete chunks are
+     * opened a batch at a time across cryptoPool(); the sink sees the
+     * plaintext in order, in locked memory that is wiped once it returns.
+     */
+    class StreamDecryptor {
+    public:
+        /**
+         * @param cipher Key and AEAD the stream was sealed with; must
+         *        outlive the stream
+         * @param aad Additional data the stream was sealed with
+         * @param sink Receives the plaintext
+         * @param batchBytes Most plaintext to open per batch; at least one
+         *        chunk is always opened at a time
+         */
+        StreamDecryptor(const Cipher& cipher, std::vector<uint8_t> aad, ChunkSink sink,
+                        size_t batchBytes = STREAM_BATCH_BYTES);
+
+        StreamDecryptor(const StreamDecryptor&) = delete;
+        StreamDecryptor& operator=(const StreamDecryptor&) = delete;
+
+        /**
+         * Add sealed bytes, opening every chunk that is complete
+         * @param data Sealed stream bytes
+         * @param length Length in bytes
+         * @throws std::runtime_error if a chunk is not authentic
+         */
+        void update(const uint8_t* data, size_t length);
+
+        /**
+         * Open the final chunk
+         * @throws std::runtime_error if the stream is truncated or not authentic
+         */
+        void finish();
+
+    private:
+        // Queue a complete chunk; `chunk` must stay valid until the next
+        // openBatch()
+        void queueChunk(const uint8_t* chunk);
+        // Open the queued full chunks and, if given, the final chunk
+        void openBatch(const uint8_t* last = nullptr, size_t lastLength = 0);
+
+        const Cipher& cipher;
+        std::vector<uint8_t> aad;
+        ChunkSink sink;
+        size_t chunkSize;              // 0 until the header is read
+        size_t batchBytes;
+        size_t batchChunks;
+        uint8_t noncePrefix[STREAM_NONCE_PREFIX_SIZE];
+        uint32_t counter;              // Number of the first queued chunk
+        std::vector<uint8_t> buffered; // Sealed bytes of an incomplete chunk or header
+        std::vector<const uint8_t*> queued;  // Full chunks waiting to be opened
+        std::vector<uint8_t> assembled;      // Copies of queued chunks that
+                                             // arrived in pieces
+        SecureBuffer plaintext;
+    };
+
+    /**
+     * Serialize the container fields up to and including the ciphertext
+     * size, so a large ciphertext can be streamed to the file after it.
+     * The secrets section ([size u32][secrets]) follows the ciphertext.
+     * @param encData Container; its ciphertext and secrets are ignored
+     * @param ciphertextSize Size of the ciphertext that will follow
+     * @return Serialized header
+     */
+    std::vector<uint8_t> serializeHeader(const EncryptedData& encData, uint32_t ciphertextSize);
+
     /**
      * Serialize encrypted data to binary format for file storage
      * @param encData EncryptedData to serialize
@@ -68,7 +738,16 @@ namespace Crypto {
     EncryptedData deserialize(const std::vector<uint8_t>& data);
 
     /**
-     * Verify if a password is correct by attempting to decrypt a test block
+     * Parse a container in place, without copying any field
+     * @param data First byte of the serialized container
+     * @param size Container size in bytes
+     * @return View whose fields point into data
+     */
+    EncryptedView deserializeView(const uint8_t* data, size_t size);
+
+    /**
+     * Verify if a password is correct. Uses the key check when present and
+     * falls back to a trial decryption for legacy containers.
      * @param encData Encrypted data to test against
      * @param password Password to verify
      * @return true if password is correct, false otherwise
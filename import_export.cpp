@@ -0,0 +1,419 @@
+#include "import_export.hpp"
+#include "json.hpp"
+#include "mapped_file.hpp"
+#include <openssl/crypto.h>
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
+#include <cerrno>
+#include <cstring>
+#include <cctype>
+#include <cstdio>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace Vault {
+
+namespace {
+    const size_t NO_COLUMN = static_cast<size_t>(-1);
+    const size_t MIN_PARSE_CHUNK = 256 * 1024;     // Smaller inputs parse on one thread
+    const size_t EXPORT_BUFFER_SIZE = 64 * 1024;
+    const std::string EMPTY;
+
+    // One contiguous slice of the input and what was parsed from it
+    struct ParseChunk {
+        size_t begin = 0;
+        size_t end = 0;
+        std::vector<Credential> records;
+        size_t skipped = 0;
+    };
+
+    struct CsvColumns {
+        size_t name = NO_COLUMN;
+        size_t url = NO_COLUMN;
+        size_t username = NO_COLUMN;
+        size_t password = NO_COLUMN;
+    };
+
+    void wipeFields(std::vector<std::string>& fields) {
+        for (std::string& field : fields) {
+            if (!field.empty()) OPENSSL_cleanse(&field[0], field.size());
+            field.clear();
+        }
+    }
+
+    // Read one CSV record at `pos` into fields[0 .. count), reusing their
+    // buffers, and leave `pos` after its line break. A quote opens or closes
+    // a quoted section wherever it appears and "" inside one is a literal
+    // quote, so a record can only end after an even number of quotes: the
+    // rule the chunk splitter relies on.
+    size_t readCsvRecord(std::string_view text, size_t& pos, std::vector<std::string>& fields) {
+        size_t count = 0;
+        auto nextField = [&]() -> std::string& {
+            if (count == fields.size()) fields.emplace_back();
+            std::string& field = fields[count++];
+            field.clear();
+            return field;
+        };
+
+        std::string* field = &nextField();
+        bool quoted = false;
+        while (pos < text.size()) {
+            char c = text[pos++];
+            if (quoted) {
+                if (c != '"') {
+                    field->push_back(c);
+                } else if (pos < text.size() && text[pos] == '"') {
+                    field->push_back('"');
+                    ++pos;
+                } else {
+                    quoted = false;
+                }
+            } else if (c == '"') {
+                quoted = true;
+            } else if (c == ',') {
+                field = &nextField();
+            } else if (c == '\n') {
+                break;
+            } else if (c != '\r' || (pos < text.size() && text[pos] != '\n')) {
+                field->push_back(c);
+            }
+        }
+        return count;
+    }
+
+    const std::string& column(const std::vector<std::string>& fields, size_t count, size_t index) {
+        return index < count ? fields[index] : EMPTY;
+    }
+
+    CsvColumns parseCsvHeader(std::string_view text, size_t& pos) {
+        std::vector<std::string> fields;
+        size_t count = readCsvRecord(text, pos, fields);
+
+        CsvColumns columns;
+        for (size_t i = 0; i < count; ++i) {
+            std::string name = fields[i];
+            name.erase(0, name.find_first_not_of(' '));
+            name.erase(name.find_last_not_of(' ') + 1);
+            std::transform(name.begin(), name.end(), name.begin(),
+                           [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+
+            size_t* slot = nullptr;
+            if (name == "name" || name == "title") slot = &columns.name;
+            else if (name == "url" || name == "login_uri") slot = &columns.url;
+            else if (name == "username" || name == "login_username") slot = &columns.username;
+            else if (name == "password" || name == "login_password") slot = &columns.password;
+            if (slot && *slot == NO_COLUMN) *slot = i;
+        }
+
+        if (columns.password == NO_COLUMN ||
+            (columns.name == NO_COLUMN && columns.url == NO_COLUMN)) {
+            throw std::runtime_error("CSV header needs a password column and a name or url column");
+        }
+        return columns;
+    }
+
+    void parseCsvChunk(std::string_view text, const CsvColumns& columns, ParseChunk& chunk) {
+        std::vector<std::string> fields;
+        size_t pos = chunk.begin;
+        while (pos < chunk.end) {
+            size_t count = readCsvRecord(text, pos, fields);
+            if (count == 1 && fields[0].empty()) continue;   // Blank line
+
+            const std::string& name = column(fields, count, columns.name);
+            const std::string& service = name.empty() ? column(fields, count, columns.url) : name;
+            if (service.empty()) {
+                ++chunk.skipped;
+                continue;
+            }
+            chunk.records.emplace_back(service, column(fields, count, columns.username),
+                                       column(fields, count, columns.password));
+        }
+        wipeFields(fields);
+    }
+
+    // Cut the CSV body [begin, end) into chunks that each hold whole
+    // records. A line break ends a record only after an even number of
+    // quotes, so quotes are counted per slice in parallel and each cut moves
+    // forward to the first line break where the running count is even.
+    std::vector<ParseChunk> splitCsv(std::string_view text, size_t begin, size_t end,
+                                     size_t slices) {
+        Crypto::ThreadPool& pool = Crypto::cryptoPool();
+        std::vector<size_t> quotes(slices);
+        pool.run(slices, [&](size_t slice) {
+            size_t from = begin + (end - begin) * slice / slices;
+            size_t to = begin + (end - begin) * (slice + 1) / slices;
+            quotes[slice] = std::count(text.begin() + from, text.begin() + to, '"');
+        });
+
+        size_t totalQuotes = 0;
+        std::vector<ParseChunk> chunks(slices);
+        size_t cut = begin;
+        for (size_t slice = 0; slice < slices; ++slice) {
+            chunks[slice].begin = cut;
+            if (slice + 1 < slices) {
+                size_t pos = begin + (end - begin) * (slice + 1) / slices;
+                bool odd = (totalQuotes + quotes[slice]) % 2 != 0;
+                if (pos < cut) {
+                    // The previous cut ran past this slice; recount from it
+                    pos = cut;
+                    odd = false;
+                }
+                while (pos < end && (odd || text[pos] != '\n')) {
+                    if (text[pos] == '"') odd = !odd;
+                    ++pos;
+                }
+                cut = std::min(pos + 1, end);
+            } else {
+                cut = end;
+            }
+            chunks[slice].end = cut;
+            totalQuotes += quotes[slice];
+        }
+
+        if (totalQuotes % 2 != 0) {
+            throw std::runtime_error("CSV has an unterminated quoted field");
+        }
+        return chunks;
+    }
+
+    // Cut [begin, end) into chunks of whole lines; JSON strings cannot
+    // hold a raw line break
+    std::vector<ParseChunk> splitLines(std::string_view text, size_t begin, size_t end,
+                                       size_t slices) {
+        std::vector<ParseChunk> chunks(slices);
+        size_t cut = begin;
+        for (size_t slice = 0; slice < slices; ++slice) {
+            chunks[slice].begin = cut;
+            if (slice + 1 < slices) {
+                size_t pos = std::max(cut, begin + (end - begin) * (slice + 1) / slices);
+                size_t lineEnd = text.find('\n', pos);
+                cut = lineEnd == std::string_view::npos || lineEnd >= end ? end : lineEnd + 1;
+            } else {
+                cut = end;
+            }
+            chunks[slice].end = cut;
+        }
+        return chunks;
+    }
+
+    void parseJsonChunk(std::string_view text, ParseChunk& chunk) {
+        size_t pos = chunk.begin;
+        while (pos < chunk.end) {
+            size_t lineEnd = std::min(text.find('\n', pos), chunk.end);
+            std::string_view line = text.substr(pos, lineEnd - pos);
+            size_t lineStart = pos;
+            pos = lineEnd + 1;
+            if (line.find_first_not_of(" \t\r") == std::string_view::npos) continue;
+
+            Json::Object record;
+            try {
+                record = Json::Object::parse(line);
+            } catch (const std::exception& e) {
+                size_t lineNumber = std::count(text.begin(), text.begin() + lineStart, '\n') + 1;
+                throw std::runtime_error("line " + std::to_string(lineNumber) + ": " + e.what());
+            }
+
+            const std::string* service = &record.getString("service", EMPTY);
+            if (service->empty()) service = &record.getString("name", EMPTY);
+            if (service->empty()) service = &record.getString("url", EMPTY);
+            if (service->empty()) {
+                ++chunk.skipped;
+            } else {
+                chunk.records.emplace_back(*service, record.getString("username", EMPTY),
+                                           record.getString("password", EMPTY));
+            }
+            record.wipe();
+        }
+    }
+
+    void appendCsvField(Crypto::SecureString& out, std::string_view value) {
+        if (value.find_first_of(",\"\r\n") == std::string_view::npos) {
+            out.append(value);
+            return;
+        }
+        out.push_back('"');
+        for (char c : value) {
+            if (c == '"') out.push_back('"');
+            out.push_back(c);
+        }
+        out.push_back('"');
+    }
+
+    // Write out and wipe the buffered text
+    bool flush(int fd, Crypto::SecureString& buffer) {
+        bool ok = writeAll(fd, buffer.data(), buffer.size());
+        buffer.clear();
+        return ok;
+    }
+}
+
+bool formatFromPath(const std::string& path, TransferFormat& format) {
+    size_t dot = path.find_last_of('.');
+    if (dot == std::string::npos || path.find('/', dot) != std::string::npos) return false;
+
+    std::string extension = path.substr(dot + 1);
+    std::transform(extension.begin(), extension.end(), extension.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    if (extension == "csv") {
+        format = TransferFormat::Csv;
+    } else if (extension == "jsonl" || extension == "json") {
+        format = TransferFormat::JsonLines;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+std::vector<Credential> parseCredentials(std::string_view text, TransferFormat format,
+                                         size_t& skipped) {
+    skipped = 0;
+    size_t begin = 0;
+    if (text.substr(0, 3) == "\xEF\xBB\xBF") begin = 3;   // UTF-8 byte order mark
+
+    CsvColumns columns;
+    if (format == TransferFormat::Csv) {
+        if (text.find_first_not_of(" \t\r\n", begin) == std::string_view::npos) return {};
+        columns = parseCsvHeader(text, begin);
+    }
+
+    Crypto::ThreadPool& pool = Crypto::cryptoPool();
+    size_t slices = std::min(pool.size() * Crypto::STREAM_CHUNKS_PER_THREAD,
+                             (text.size() - begin) / MIN_PARSE_CHUNK + 1);
+    std::vector<ParseChunk> chunks = format == TransferFormat::Csv
+        ? splitCsv(text, begin, text.size(), slices)
+        : splitLines(text, begin, text.size(), slices);
+
+    pool.run(chunks.size(), [&](size_t index) {
+        if (format == TransferFormat::Csv) {
+            parseCsvChunk(text, columns, chunks[index]);
+        } else {
+            parseJsonChunk(text, chunks[index]);
+        }
+    });
+
+    // Merge in input order so that later duplicates win
+    size_t total = 0;
+    for (const ParseChunk& chunk : chunks) {
+        total += chunk.records.size();
+        skipped += chunk.skipped;
+    }
+    std::vector<Credential> records;
+    records.reserve(total);
+    for (ParseChunk& chunk : chunks) {
+        std::move(chunk.records.begin(), chunk.records.end(), std::back_inserter(records));
+    }
+    return records;
+}
+
+ImportSummary importCredentials(PasswordManager& vault, const std::string& path,
+                                TransferFormat format) {
+    ImportSummary summary;
+    struct stat st;
+    if (::stat(path.c_str(), &st) != 0) {
+        throw std::runtime_error("cannot read " + path + ": " + std::strerror(errno));
+    }
+    if (st.st_size == 0) {
+        summary.saved = true;
+        return summary;
+    }
+
+    MappedFile file;
+    if (!file.open(path)) {
+        throw std::runtime_error("cannot read " + path + ": " + std::strerror(errno));
+    }
+    std::vector<Credential> records = parseCredentials(
+        std::string_view(reinterpret_cast<const char*>(file.data()), file.size()),
+        format, summary.skipped);
+    file.close();
+    summary.rows = records.size() + summary.skipped;
+
+    // One save for the whole file; anything short of it leaves the vault as it was
+    Transaction transaction(vault);
+    if (!transaction.isActive()) {
+        for (Credential& record : records) record.password.clear();
+        throw std::runtime_error("vault is locked or has an open transaction");
+    }
+    bool added = vault.addCredentials(records);
+    for (Credential& record : records) record.password.clear();
+    if (!added) {
+        throw std::runtime_error("could not store credentials");
+    }
+
+    summary.saved = records.empty() || transaction.commit();
+    summary.imported = summary.saved ? records.size() : 0;
+    return summary;
+}
+
+size_t exportCredentials(const PasswordManager& vault, const std::string& path,
+                         TransferFormat format) {
+    if (vault.isVaultLocked()) {
+        throw std::runtime_error("vault is locked");
+    }
+
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    // An existing file keeps its mode through O_CREAT; plain-text passwords must not
+    if (fd < 0 || fchmod(fd, 0600) != 0) {
+        int error = errno;
+        if (fd >= 0) ::close(fd);
+        throw std::runtime_error("cannot write " + path + ": " + std::strerror(error));
+    }
+
+    // Plaintext passwords; a std::string would leave unwiped copies behind
+    // each time it grew
+    Crypto::SecureString buffer;
+    buffer.reserve(EXPORT_BUFFER_SIZE + 1024);
+    if (format == TransferFormat::Csv) {
+        buffer.append("name,url,username,password\n");
+    }
+
+    size_t written = 0;
+    bool ok = true;
+    std::string unreadable; // Service whose secret did not open
+    vault.forEachCredential([&](const CredentialSummary& entry) {
+        if (!ok || !unreadable.empty()) return;
+        CredentialView credential = vault.getCredential(entry.service);
+        if (credential.service.empty()) {
+            unreadable.assign(entry.service);
+            return;
+        }
+        if (format == TransferFormat::Csv) {
+            appendCsvField(buffer, credential.service);
+            buffer.append(",,");
+            appendCsvField(buffer, credential.username);
+            buffer.push_back(',');
+            appendCsvField(buffer, credential.password);
+            buffer.push_back('\n');
+        } else {
+            buffer.append("{\"service\":");
+            Json::appendQuoted(buffer, credential.service);
+            buffer.append(",\"username\":");
+            Json::appendQuoted(buffer, credential.username);
+            buffer.append(",\"password\":");
+            Json::appendQuoted(buffer, credential.password);
+            buffer.append("}\n");
+        }
+        ++written;
+        if (buffer.size() >= EXPORT_BUFFER_SIZE) {
+            ok = flush(fd, buffer);
+        }
+    });
+    if (!unreadable.empty()) {
+        // A file missing some credentials would pass for a full export
+        ::close(fd);
+        std::remove(path.c_str());
+        throw std::runtime_error("cannot read the password for " + unreadable);
+    }
+    ok = flush(fd, buffer) && ok;
+    int error = errno;
+    ok = ::close(fd) == 0 && ok;
+
+    if (!ok) {
+        std::remove(path.c_str());
+        throw std::runtime_error("cannot write " + path + ": " + std::strerror(error));
+    }
+    return written;
+}
+
+} // namespace Vault
@@ -0,0 +1,78 @@
+#ifndef IMPORT_EXPORT_HPP
+#define IMPORT_EXPORT_HPP
+
+#include "vault.hpp"
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace Vault {
+    // File formats for moving credentials in and out of a vault
+    enum class TransferFormat {
+        Csv,        // Browser export: name,url,username,password
+        JsonLines   // One {"service":..,"username":..,"password":..} per line
+    };
+
+    /**
+     * Pick a format from a file extension: .csv, or .jsonl / .json
+     * @param path File path
+     * @param format Receives the format
+     * @return true if the extension is recognised
+     */
+    bool formatFromPath(const std::string& path, TransferFormat& format);
+
+    // Outcome of an import
+    struct ImportSummary {
+        size_t rows = 0;        // Records read, header excluded
+        size_t imported = 0;    // Records stored; a repeated service counts each time
+        size_t skipped = 0;     // Records without a service name or URL
+        bool saved = false;
+    };
+
+    /**
+     * Parse credentials, splitting large inputs into chunks that are parsed
+     * on the crypto threads. Records keep their input order.
+     *
+     * CSV follows RFC 4180 and needs a header row; columns are matched by
+     * name, case-insensitively: name/title, url/login_uri,
+     * username/login_username and password/login_password. Other columns
+     * are ignored, and the URL stands in for a missing name. JSON Lines
+     * records use "service" (or "name"/"url"), "username" and "password".
+     * @param text Whole input
+     * @param format Input format
+     * @param skipped Receives the number of records without a service
+     * @return Parsed credentials
+     * @throws std::runtime_error on malformed input, naming the line
+     */
+    std::vector<Credential> parseCredentials(std::string_view text, TransferFormat format,
+                                             size_t& skipped);
+
+    /**
+     * Import a file into an unlocked vault as one transaction: every record
+     * is added in memory and the vault is saved once. A later record for a
+     * service replaces an earlier one and any stored credential.
+     * @param vault Unlocked vault with no open transaction
+     * @param path File to import
+     * @param format File format
+     * @return Counts of records; saved is false if nothing was kept
+     * @throws std::runtime_error if the file cannot be read or is malformed,
+     *         in which case the vault is unchanged
+     */
+    ImportSummary importCredentials(PasswordManager& vault, const std::string& path,
+                                    TransferFormat format);
+
+    /**
+     * Write every credential, passwords in plain text, to a new file that
+     * only the owner can read. An existing file is replaced.
+     * @param vault Unlocked vault
+     * @param path File to write
+     * @param format File format
+     * @return Number of credentials written
+     * @throws std::runtime_error if the file cannot be written or a password
+     *         cannot be read; no file is left behind
+     */
+    size_t exportCredentials(const PasswordManager& vault, const std::string& path,
+                             TransferFormat format);
+}
+
+#endif // IMPORT_EXPORT_HPP
@@ -0,0 +1,312 @@
+#include "json.hpp"
+#include <openssl/crypto.h>
+#include <stdexcept>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+
+namespace Json {
+
+namespace {
+    class Parser {
+    public:
+        explicit Parser(std::string_view input) : text(input), pos(0) {}
+
+        void parseObject(std::vector<Field>& members) {
+            skipSpace();
+            expect('{');
+            skipSpace();
+            if (peek() == '}') {
+                ++pos;
+            } else {
+                while (true) {
+                    skipSpace();
+                    Field field;
+                    field.name = parseString();
+                    skipSpace();
+                    expect(':');
+                    skipSpace();
+                    parseValue(field);
+                    members.push_back(std::move(field));
+                    skipSpace();
+                    if (peek() == ',') {
+                        ++pos;
+                        continue;
+                    }
+                    expect('}');
+                    break;
+                }
+            }
+            skipSpace();
+            if (pos != text.size()) {
+                fail("unexpected text after the object");
+            }
+        }
+
+    private:
+        [[noreturn]] void fail(const std::string& what) const {
+            throw std::runtime_error("Invalid JSON at offset " + std::to_string(pos) + ": " + what);
+        }
+
+        char peek() const {
+            return pos < text.size() ? text[pos] : '\0';
+        }
+
+        void expect(char c) {
+            if (peek() != c) {
+                fail(std::string("expected '") + c + "'");
+            }
+            ++pos;
+        }
+
+        void skipSpace() {
+            while (pos < text.size() &&
+                   (text[pos] == ' ' || text[pos] == '\t' || text[pos] == '\r' || text[pos] == '\n')) {
+                ++pos;
+            }
+        }
+
+        void parseValue(Field& field) {
+            char c = peek();
+            if (c == '"') {
+                field.value = parseString();
+                field.isString = true;
+            } else if (c == '{' || c == '[') {
+                fail("nested values are not supported");
+            } else {
+                // Number or literal: keep its text
+                size_t start = pos;
+                while (pos < text.size() && text[pos] != ',' && text[pos] != '}' &&
+                       text[pos] != ' ' && text[pos] != '\t' && text[pos] != '\r' &&
+                       text[pos] != '\n') {
+                    ++pos;
+                }
+                field.value.assign(text.substr(start, pos - start));
+                if (field.value.empty()) {
+                    fail("expected a value");
+                }
+            }
+        }
+
+        uint32_t parseHex4() {
+            if (text.size() - pos < 4) {
+                fail("truncated \\u escape");
+            }
+            uint32_t value = 0;
+            for (int i = 0; i < 4; ++i) {
+                char c = text[pos++];
+                value <<= 4;
+                if (c >= '0' && c <= '9') value |= c - '0';
+                else if (c >= 'a' && c <= 'f') value |= c - 'a' + 10;
+                else if (c >= 'A' && c <= 'F') value |= c - 'A' + 10;
+                else fail("invalid \\u escape");
+            }
+            return value;
+        }
+
+        static void appendUtf8(std::string& out, uint32_t code) {
+            if (code < 0x80) {
+                out.push_back(static_cast<char>(code));
+            } else if (code < 0x800) {
+                out.push_back(static_cast<char>(0xC0 | (code >> 6)));
+                out.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+            } else if (code < 0x10000) {
+                out.push_back(static_cast<char>(0xE0 | (code >> 12)));
+                out.push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3F)));
+                out.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+            } else {
+                out.push_back(static_cast<char>(0xF0 | (code >> 18)));
+                out.push_back(static_cast<char>(0x80 | ((code >> 12) & 0x3F)));
+                out.push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3F)));
+                out.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+            }
+        }
+
+        std::string parseString() {
+            expect('"');
+            std::string out;
+            while (true) {
+                if (pos >= text.size()) {
+                    fail("unterminated string");
+                }
+                char c = text[pos++];
+                if (c == '"') {
+                    return out;
+                }
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    fail("control character in string");
+                }
+                if (c != '\\') {
+                    out.push_back(c);
+                    continue;
+                }
+                if (pos >= text.size()) {
+                    fail("unterminated string");
+                }
+                char escape = text[pos++];
+                switch (escape) {
+                    case '"': out.push_back('"'); break;
+                    case '\\': out.push_back('\\'); break;
+                    case '/': out.push_back('/'); break;
+                    case 'b': out.push_back('\b'); break;
+                    case 'f': out.push_back('\f'); break;
+                    case 'n': out.push_back('\n'); break;
+                    case 'r': out.push_back('\r'); break;
+                    case 't': out.push_back('\t'); break;
+                    case 'u': {
+                        uint32_t code = parseHex4();
+                        if (code >= 0xD800 && code < 0xDC00) {
+                            // High surrogate; the low half must follow
+                            if (text.substr(pos, 2) != "\\u") {
+                                fail("unpaired surrogate");
+                            }
+                            pos += 2;
+                            uint32_t low = parseHex4();
+                            if (low < 0xDC00 || low >= 0xE000) {
+                                fail("unpaired surrogate");
+                            }
+                            code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                        } else if (code >= 0xDC00 && code < 0xE000) {
+                            fail("unpaired surrogate");
+                        }
+                        appendUtf8(out, code);
+                        break;
+                    }
+                    default:
+                        fail("invalid escape");
+                }
+            }
+        }
+
+        std::string_view text;
+        size_t pos;
+    };
+
+    void wipeString(std::string& value) {
+        if (!value.empty()) {
+            OPENSSL_cleanse(&value[0], value.size());
+        }
+        value.clear();
+    }
+}
+
+// Object Implementation
+Object Object::parse(std::string_view text) {
+    Object object;
+    Parser(text).parseObject(object.members);
+    return object;
+}
+
+const Field* Object::find(std::string_view name) const {
+    for (const Field& field : members) {
+        if (field.name == name) return &field;
+    }
+    return nullptr;
+}
+
+const std::string& Object::getString(std::string_view name, const std::string& fallback) const {
+    const Field* field = find(name);
+    return field && field->isString ? field->value : fallback;
+}
+
+void Object::wipe() {
+    for (Field& field : members) {
+        wipeString(field.value);
+    }
+}
+
+namespace {
+    template <typename Out>
+    void quote(Out& out, std::string_view text) {
+        static const char hex[] = "0123456789abcdef";
+        out.push_back('"');
+        for (char c : text) {
+            switch (c) {
+                case '"': out.append(std::string_view("\\\"")); break;
+                case '\\': out.append(std::string_view("\\\\")); break;
+                case '\n': out.append(std::string_view("\\n")); break;
+                case '\r': out.append(std::string_view("\\r")); break;
+                case '\t': out.append(std::string_view("\\t")); break;
+                default:
+                    if (static_cast<unsigned char>(c) < 0x20) {
+                        out.append(std::string_view("\\u00"));
+                        out.push_back(hex[(c >> 4) & 0xF]);
+                        out.push_back(hex[c & 0xF]);
+                    } else {
+                        out.push_back(c);
+                    }
+            }
+        }
+        out.push_back('"');
+    }
+}
+
+void appendQuoted(std::string& out, std::string_view text) {
+    quote(out, text);
+}
+
+void appendQuoted(Crypto::SecureString& out, std::string_view text) {
+    quote(out, text);
+}
+
+// Writer Implementation
+void Writer::key(std::string_view name) {
+    if (text.size() > 1) text.push_back(',');
+    appendQuoted(text, name);
+    text.push_back(':');
+}
+
+Writer& Writer::add(std::string_view name, std::string_view value) {
+    key(name);
+    appendQuoted(text, value);
+    return *this;
+}
+
+Writer& Writer::add(std::string_view name, bool value) {
+    key(name);
+    text += value ? "true" : "false";
+    return *this;
+}
+
+Writer& Writer::add(std::string_view name, size_t value) {
+    key(name);
+    text += std::to_string(value);
+    return *this;
+}
+
+Writer& Writer::add(std::string_view name, double value) {
+    key(name);
+    if (!std::isfinite(value)) {
+        text += "null";
+        return *this;
+    }
+    char digits[32];
+    auto result = std::to_chars(digits, digits + sizeof(digits), value);
+    text.append(digits, result.ptr);
+    return *this;
+}
+
+Writer& Writer::add(std::string_view name, const std::vector<std::string>& values) {
+    key(name);
+    text.push_back('[');
+    for (size_t i = 0; i < values.size(); ++i) {
+        if (i > 0) text.push_back(',');
+        appendQuoted(text, values[i]);
+    }
+    text.push_back(']');
+    return *this;
+}
+
+const std::string& Writer::finish() {
+    if (!closed) {
+        text.push_back('}');
+        closed = true;
+    }
+    return text;
+}
+
+void Writer::wipe() {
+    wipeString(text);
+}
+
+} // namespace Json
@@ -0,0 +1,98 @@
+#ifndef JSON_HPP
+#define JSON_HPP
+
+#include "secure_memory.hpp"
+#include <string>
+#include <string_view>
+#include <vector>
+#include <utility>
+
+namespace Json {
+    /**
+     * One member of a flat JSON object. Strings are unescaped; numbers,
+     * true, false and null keep their literal text.
+     */
+    struct Field {
+        std::string name;
+        std::string value;
+        bool isString = false;
+    };
+
+    /**
+     * Flat JSON object: members in document order, no nesting. Lookups are
+     * linear, which is what the few members of a batch or import record need.
+     */
+    class Object {
+    public:
+        /**
+         * Parse one JSON object, e.g. a line of a JSON Lines file. Nested
+         * objects and arrays are rejected.
+         * @param text Object text; surrounding whitespace is allowed
+         * @throws std::runtime_error describing the first syntax error
+         */
+        static Object parse(std::string_view text);
+
+        /**
+         * @param name Member name
+         * @return Member, or nullptr if absent
+         */
+        const Field* find(std::string_view name) const;
+
+        /**
+         * @param name Member name
+         * @param fallback Returned when the member is absent or not a string
+         * @return String value of the member
+         */
+        const std::string& getString(std::string_view name, const std::string& fallback) const;
+
+        const std::vector<Field>& fields() const { return members; }
+
+        /**
+         * Wipe every value, for objects that carried passwords
+         */
+        void wipe();
+
+    private:
+        std::vector<Field> members;
+    };
+
+    /**
+     * Append a string as a quoted JSON string, escaping as needed
+     * @param out Output buffer
+     * @param text UTF-8 text
+     */
+    void appendQuoted(std::string& out, std::string_view text);
+    void appendQuoted(Crypto::SecureString& out, std::string_view text);
+
+    /**
+     * Builds one flat JSON object, member by member, e.g. a result line
+     */
+    class Writer {
+    public:
+        Writer& add(std::string_view name, std::string_view value);
+        Writer& add(std::string_view name, const char* value) { return add(name, std::string_view(value)); }
+        Writer& add(std::string_view name, bool value);
+        Writer& add(std::string_view name, size_t value);
+        Writer& add(std::string_view name, double value);   // null if not finite
+        Writer& add(std::string_view name, const std::vector<std::string>& values);
+
+        /**
+         * Close the object; nothing may be added afterwards
+         * @return The object text
+         */
+        const std::string& finish();
+
+        /**
+         * Wipe the buffer, for objects that carried passwords
+         */
+        void wipe();
+
+    private:
+        void key(std::string_view name);
+
+        std::string text = "{";
+        bool closed = false;
+    };
+}
+
+#endif // JSON_HPP
@@ -1,27 +1,47 @@
 #include "vault.hpp"
+#include "batch.hpp"
+#include "import_export.hpp"
+#include "agent.hpp"
+#include "trace.hpp"
+#include "memory.hpp"
+#include "json.hpp"
 #include <iostream>
+#include <fstream>
 #include <string>
 #include <vector>
 #include <chrono>
 #include <thread>
 #include <atomic>
 #include <signal.h>
+#include <termios.h>
+#include <unistd.h>
 #include <sstream>
+#include <cstring>
+#include <cerrno>
 #include <iomanip>
 
+// Idle time before the vault locks itself, interactively or in the agent
+static constexpr int AUTO_LOCK_MINUTES = 2;
+
 class PasswordManagerCLI {
 private:
     Vault::PasswordManager vault;
     std::atomic<bool> running{true};
     std::atomic<std::chrono::steady_clock::time_point> lastActivity;
-    static constexpr int AUTO_LOCK_MINUTES = 2;
+    static constexpr std::chrono::milliseconds UNLOCK_TARGET{250};
+    static constexpr uint32_t KDF_LANES = 4;  // Up to one per core
+    
+    static Crypto::KdfParams calibrateForHost() {
+        uint32_t lanes = std::min(KDF_LANES, std::max(1u, std::thread::hardware_concurrency()));
+        return Crypto::calibrateKdf(Crypto::preferredKdf(), UNLOCK_TARGET, lanes);
+    }
     
     void printWelcome() {
         std::cout << "\n╔══════════════════════════════════════════════════════╗\n";
         std::cout << "║            🔐 Secure Password Manager 🔐             ║\n";
         std::cout << "║                                                      ║\n";
         std::cout << "║  Your passwords are encrypted with AES-256 and      ║\n";
-        std::cout << "║  protected by PBKDF2 key derivation.                ║\n";
+        std::cout << "║  protected by memory-hard key derivation.           ║\n";
         std::cout << "╚══════════════════════════════════════════════════════╝\n\n";
     }
     
@@ -33,6 +53,10 @@ private:
         std::cout << "  remove  - Remove a service credential\n";
         std::cout << "  generate- Generate a secure password\n";
         std::cout << "  status  - Show vault status\n";
+        std::cout << "  stats   - Show where unlock, load and save spend time ('stats json')\n";
+        std::cout << "  kdf     - Re-tune key derivation for this machine\n";
+        std::cout << "  import  - Import credentials from a CSV or JSONL file\n";
+        std::cout << "  export  - Export credentials to a CSV or JSONL file\n";
         std::cout << "  help    - Show this help message\n";
         std::cout << "  exit    - Exit and lock the vault\n";
         std::cout << "\n⏰ Auto-lock: " << AUTO_LOCK_MINUTES << " minutes of inactivity\n\n";
@@ -88,7 +112,9 @@ private:
                 }
             } while (true);
             
-            if (vault.initializeVault(password)) {
+            std::cout << "⏱️  Tuning key derivation for this machine...\n";
+            Crypto::KdfParams kdf = calibrateForHost();
+            if (vault.initializeVault(password, Crypto::preferredCipherSuite(), kdf)) {
                 std::cout << "✅ Vault created successfully!\n";
                 Vault::Utils::secureErase(password);
                 Vault::Utils::secureErase(confirmPassword);
@@ -116,8 +142,7 @@ private:
         }
         
         // Check if service already exists
-        auto existing = vault.getCredential(service);
-        if (!existing.service.empty()) {
+        if (vault.hasCredential(service)) {
             std::cout << "⚠️  Service '" << service << "' already exists. Update? (y/N): ";
             std::string choice;
             std::getline(std::cin, choice);
@@ -186,7 +211,7 @@ private:
         std::string choice;
         std::getline(std::cin, choice);
         if (choice == "y" || choice == "Y") {
-            std::string command = "echo '" + credential.password + "' | pbcopy";
+            std::string command = "echo '" + std::string(credential.password) + "' | pbcopy";
             system(command.c_str());
             std::cout << "✅ Password copied to clipboard!\n";
             
@@ -203,20 +228,20 @@ private:
     void handleListCommand() {
         updateActivity();
         
-        auto services = vault.getServices();
-        if (services.empty()) {
+        size_t total = vault.getCredentialCount();
+        if (total == 0) {
             std::cout << "📭 No services stored in vault.\n";
             return;
         }
         
-        std::cout << "\n📋 Stored Services (" << services.size() << " total):\n";
+        std::cout << "\n📋 Stored Services (" << total << " total):\n";
         std::cout << "╔═══════════════════════════════════════════════════════╗\n";
         
-        for (const auto& service : services) {
-            auto cred = vault.getCredential(service);
-            std::cout << "║ " << std::left << std::setw(20) << service 
+        // One pass over the store; passwords are never touched
+        vault.forEachCredential([](const Vault::CredentialSummary& cred) {
+            std::cout << "║ " << std::left << std::setw(20) << cred.service 
                      << " │ " << std::setw(25) << cred.username << " ║\n";
-        }
+        });
         
         std::cout << "╚═══════════════════════════════════════════════════════╝\n";
     }
@@ -228,8 +253,7 @@ private:
         std::cout << "Service name to remove: ";
         std::getline(std::cin, service);
         
-        auto credential = vault.getCredential(service);
-        if (credential.service.empty()) {
+        if (!vault.hasCredential(service)) {
             std::cout << "❌ Service '" << service << "' not found!\n";
             return;
         }
@@ -274,6 +298,11 @@ private:
         std::cout << "Vault File: " << (vault.vaultExists() ? "✅ Exists" : "❌ Not Found") << "\n";
         std::cout << "Status: " << (vault.isVaultLocked() ? "🔒 Locked" : "🔓 Unlocked") << "\n";
         std::cout << "Total Credentials: " << vault.getCredentialCount() << "\n";
+        if (!vault.isVaultLocked()) {
+            std::cout << "Cipher: " << Crypto::cipherSuiteName(vault.getCipherSuite()) << "\n";
+            std::cout << "Key Derivation: " << Crypto::describeKdf(vault.getKdfParams()) << "\n";
+            printMemoryUsage(vault.getMemoryUsage());
+        }
         
         auto now = std::chrono::steady_clock::now();
         auto timeSinceActivity = std::chrono::duration_cast<std::chrono::seconds>(
@@ -285,6 +314,179 @@ private:
         }
     }
     
+    static std::string formatBytes(size_t bytes) {
+        std::ostringstream out;
+        out << std::fixed << std::setprecision(1);
+        if (bytes >= (size_t(1) << 30)) {
+            out << bytes / double(size_t(1) << 30) << " GiB";
+        } else if (bytes >= (size_t(1) << 20)) {
+            out << bytes / double(size_t(1) << 20) << " MiB";
+        } else if (bytes >= 1024) {
+            out << bytes / 1024.0 << " KiB";
+        } else {
+            out << bytes << " B";
+        }
+        return out.str();
+    }
+    
+    static void printMemoryUsage(const Vault::MemoryUsage& memory) {
+        std::cout << "Memory:\n";
+        std::cout << "  Fields:          " << formatBytes(memory.store.fields) << "\n";
+        std::cout << "  Entries:         " << formatBytes(memory.store.entries) << "\n";
+        std::cout << "  Lookup index:    " << formatBytes(memory.store.index) << "\n";
+        if (memory.transaction > 0) {
+            std::cout << "  Transaction:     " << formatBytes(memory.transaction) << "\n";
+        }
+        std::cout << "  Snapshot mapped: " << formatBytes(memory.snapshot) << "\n";
+        std::cout << "  Secure memory:   " << formatBytes(memory.secure.inUse) << " in "
+                  << formatBytes(memory.secure.reserved) << " ("
+                  << formatBytes(memory.secure.locked) << " locked)\n";
+        if (Memory::ENABLED) {
+            std::cout << "  Heap in use:     " << formatBytes(memory.heapInUse) << "\n";
+            if (memory.unlockPeak > 0) {
+                std::cout << "  Unlock peak:     " << formatBytes(memory.unlockPeak)
+                          << (memory.boundedLoad ? " (bounded)" : "") << "\n";
+            }
+            if (memory.savePeak > 0) {
+                std::cout << "  Save peak:       " << formatBytes(memory.savePeak)
+                          << (memory.boundedSave ? " (bounded)" : "") << "\n";
+            }
+        }
+        if (memory.resident > 0) {
+            std::cout << "  Resident:        " << formatBytes(memory.resident) << "\n";
+        }
+        std::cout << "  Limit:           "
+                  << (memory.limit ? formatBytes(memory.limit) : std::string("none")) << "\n";
+    }
+    
+    static std::string formatNanoseconds(uint64_t nanoseconds) {
+        std::ostringstream out;
+        out << std::fixed << std::setprecision(1);
+        if (nanoseconds >= 1000000000) {
+            out << nanoseconds / 1e9 << " s";
+        } else if (nanoseconds >= 1000000) {
+            out << nanoseconds / 1e6 << " ms";
+        } else if (nanoseconds >= 1000) {
+            out << nanoseconds / 1e3 << " us";
+        } else {
+            out << nanoseconds << " ns";
+        }
+        return out.str();
+    }
+    
+    void handleStatsCommand(bool json) {
+        updateActivity();
+        
+        if (json) {
+            Json::Writer stats;
+            Trace::addJson(stats);
+            std::cout << stats.finish() << "\n";
+            return;
+        }
+        if (!Trace::ENABLED) {
+            std::cout << "Timings are compiled out of this build (VAULT_NO_TRACE)\n";
+            return;
+        }
+        
+        std::cout << "\n⏱️  Timings since start:\n";
+        std::cout << "  " << std::left << std::setw(16) << "Phase" << std::right
+                  << std::setw(8) << "Count" << std::setw(11) << "p50" << std::setw(11) << "p99"
+                  << std::setw(11) << "Max" << std::setw(11) << "Total" << "\n";
+        bool any = false;
+        for (size_t i = 0; i < static_cast<size_t>(Trace::Phase::Count); ++i) {
+            Trace::Phase phase = static_cast<Trace::Phase>(i);
+            const Trace::LatencyHistogram& timings = Trace::histogram(phase);
+            uint64_t count = timings.count();
+            if (count == 0) continue;
+            any = true;
+            std::cout << "  " << std::left << std::setw(16) << Trace::phaseName(phase) << std::right
+                      << std::setw(8) << count
+                      << std::setw(11) << formatNanoseconds(timings.percentile(0.50))
+                      << std::setw(11) << formatNanoseconds(timings.percentile(0.99))
+                      << std::setw(11) << formatNanoseconds(timings.max())
+                      << std::setw(11) << formatNanoseconds(timings.total()) << "\n";
+        }
+        if (!any) {
+            std::cout << "  Nothing timed yet\n";
+        }
+    }
+    
+    void handleKdfCommand() {
+        updateActivity();
+        
+        std::cout << "Current: " << Crypto::describeKdf(vault.getKdfParams()) << "\n";
+        std::cout << "⏱️  Tuning " << Crypto::kdfName(Crypto::preferredKdf()) << " for a "
+                  << UNLOCK_TARGET.count() << " ms unlock...\n";
+        Crypto::KdfParams kdf = calibrateForHost();
+        std::cout << "Proposed: " << Crypto::describeKdf(kdf) << "\n";
+        
+        std::string password = Vault::Utils::getHiddenInput("Master Password: ");
+        if (vault.updateKdf(password, kdf)) {
+            std::cout << "✅ Key derivation updated!\n";
+        } else {
+            std::cout << "❌ Failed to update key derivation!\n";
+        }
+        Vault::Utils::secureErase(password);
+    }
+    
+    void handleImportCommand() {
+        updateActivity();
+        
+        std::string path;
+        std::cout << "File to import (.csv or .jsonl): ";
+        std::getline(std::cin, path);
+        
+        Vault::TransferFormat format;
+        if (!Vault::formatFromPath(path, format)) {
+            std::cout << "❌ Unknown file type; use .csv or .jsonl\n";
+            return;
+        }
+        
+        try {
+            auto start = std::chrono::steady_clock::now();
+            Vault::ImportSummary summary = Vault::importCredentials(vault, path, format);
+            auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now() - start).count();
+            if (!summary.saved) {
+                std::cout << "❌ Failed to save the vault; nothing was imported!\n";
+                return;
+            }
+            std::cout << "✅ Imported " << summary.imported << " credentials in " << elapsed << " ms";
+            if (summary.skipped > 0) {
+                std::cout << " (" << summary.skipped << " rows without a name skipped)";
+            }
+            std::cout << "\n";
+        } catch (const std::exception& e) {
+            std::cout << "❌ Import failed: " << e.what() << "\n";
+        }
+    }
+    
+    void handleExportCommand() {
+        updateActivity();
+        
+        std::string path;
+        std::cout << "File to export to (.csv or .jsonl): ";
+        std::getline(std::cin, path);
+        
+        Vault::TransferFormat format;
+        if (!Vault::formatFromPath(path, format)) {
+            std::cout << "❌ Unknown file type; use .csv or .jsonl\n";
+            return;
+        }
+        
+        std::cout << "⚠️  The file will hold every password in plain text. Continue? (y/N): ";
+        std::string choice;
+        std::getline(std::cin, choice);
+        if (choice != "y" && choice != "Y") return;
+        
+        try {
+            size_t written = Vault::exportCredentials(vault, path, format);
+            std::cout << "✅ Exported " << written << " credentials to " << path << "\n";
+        } catch (const std::exception& e) {
+            std::cout << "❌ Export failed: " << e.what() << "\n";
+        }
+    }
+    
     void checkAutoLock() {
         auto now = std::chrono::steady_clock::now();
         auto timeSinceActivity = std::chrono::duration_cast<std::chrono::minutes>(
@@ -308,6 +510,7 @@ private:
 
 public:
     PasswordManagerCLI() : vault("vault.dat") {
+        vault.setMemoryLimit(Vault::defaultMemoryLimit());
         lastActivity.store(std::chrono::steady_clock::now());
         
         // Handle Ctrl+C gracefully
@@ -366,6 +569,16 @@ public:
                 handleGenerateCommand();
             } else if (cmd == "status") {
                 handleStatusCommand();
+            } else if (cmd == "stats") {
+                std::string format;
+                iss >> format;
+                handleStatsCommand(format == "json");
+            } else if (cmd == "kdf") {
+                handleKdfCommand();
+            } else if (cmd == "import") {
+                handleImportCommand();
+            } else if (cmd == "export") {
+                handleExportCommand();
             } else if (cmd == "help") {
                 printCommands();
             } else if (cmd == "exit") {
@@ -387,7 +600,224 @@ public:
     }
 };
 
-int main() {
+// Read the master password without a prompt on stdout, which carries the
+// batch results; echo is off when it comes from a terminal
+std::string readMasterPassword() {
+    if (!isatty(STDIN_FILENO)) {
+        std::string password;
+        std::getline(std::cin, password);
+        return password;
+    }
+    
+    std::cerr << "Master Password: ";
+    struct termios oldt, newt;
+    tcgetattr(STDIN_FILENO, &oldt);
+    newt = oldt;
+    newt.c_lflag &= ~ECHO;
+    tcsetattr(STDIN_FILENO, TCSANOW, &newt);
+    std::string password;
+    std::getline(std::cin, password);
+    tcsetattr(STDIN_FILENO, TCSANOW, &oldt);
+    std::cerr << std::endl;
+    return password;
+}
+
+// Non-interactive mode: unlock once, apply a JSON Lines file of operations,
+// save once. The password is the first line of stdin; with "-" as the
+// file, the operations follow it on stdin.
+int runBatchMode(const std::string& opsPath) {
+    Vault::PasswordManager vault("vault.dat");
+    vault.setMemoryLimit(Vault::defaultMemoryLimit());
+    if (!vault.vaultExists()) {
+        std::cerr << "Error: no vault found; run interactively once to create it" << std::endl;
+        return 1;
+    }
+    
+    std::ifstream opsFile;
+    if (opsPath != "-") {
+        opsFile.open(opsPath);
+        if (!opsFile) {
+            std::cerr << "Error: cannot open " << opsPath << std::endl;
+            return 1;
+        }
+    }
+    
+    std::string password = readMasterPassword();
+    bool unlocked = vault.unlock(password);
+    Vault::Utils::secureErase(password);
+    if (!unlocked) {
+        std::cout << "{\"op\":\"unlock\",\"ok\":false,\"error\":\"incorrect password\"}\n";
+        return 1;
+    }
+    
+    std::istream& ops = opsPath == "-" ? std::cin : opsFile;
+    Vault::BatchSummary summary = Vault::runBatch(vault, ops, std::cout);
+    vault.lock();
+    return summary.failed == 0 && summary.saved ? 0 : 1;
+}
+
+// Non-interactive import or export of a whole CSV or JSON Lines file; the
+// password is the first line of stdin, as for --batch
+int runTransferMode(const std::string& path, bool importing) {
+    Vault::TransferFormat format;
+    if (!Vault::formatFromPath(path, format)) {
+        std::cerr << "Error: unknown file type for " << path << "; use .csv or .jsonl" << std::endl;
+        return 2;
+    }
+    
+    Vault::PasswordManager vault("vault.dat");
+    vault.setMemoryLimit(Vault::defaultMemoryLimit());
+    if (!vault.vaultExists()) {
+        std::cerr << "Error: no vault found; run interactively once to create it" << std::endl;
+        return 1;
+    }
+    
+    std::string password = readMasterPassword();
+    bool unlocked = vault.unlock(password);
+    Vault::Utils::secureErase(password);
+    if (!unlocked) {
+        std::cerr << "Error: incorrect password" << std::endl;
+        return 1;
+    }
+    
+    int status = 0;
+    if (importing) {
+        Vault::ImportSummary summary = Vault::importCredentials(vault, path, format);
+        std::cerr << "Imported " << summary.imported << " of " << summary.rows << " rows"
+                  << " (" << summary.skipped << " without a name)"
+                  << (summary.saved ? "" : "; vault not saved") << std::endl;
+        status = summary.saved ? 0 : 1;
+    } else {
+        size_t written = Vault::exportCredentials(vault, path, format);
+        std::cerr << "Exported " << written << " credentials" << std::endl;
+    }
+    vault.lock();
+    return status;
+}
+
+Vault::AgentServer* runningAgent = nullptr;
+
+// Keep the vault unlocked in this process and serve clients over a Unix
+// socket until it is idle for the auto-lock period, told to lock, or
+// interrupted. The password is the first line of stdin, as for --batch.
+int runAgentMode() {
+    Vault::PasswordManager vault("vault.dat");
+    vault.setMemoryLimit(Vault::defaultMemoryLimit());
+    if (!vault.vaultExists()) {
+        std::cerr << "Error: no vault found; run interactively once to create it" << std::endl;
+        return 1;
+    }
+    
+    std::string password = readMasterPassword();
+    bool unlocked = vault.unlock(password);
+    Vault::Utils::secureErase(password);
+    if (!unlocked) {
+        std::cerr << "Error: incorrect password" << std::endl;
+        return 1;
+    }
+    
+    std::string socketPath = Vault::defaultAgentSocketPath();
+    Vault::AgentServer server(vault, socketPath, std::chrono::minutes(AUTO_LOCK_MINUTES));
+    if (!server.listen()) {
+        vault.lock();
+        return 1;
+    }
+    
+    runningAgent = &server;
+    auto stopAgent = [](int) { runningAgent->stop(); };
+    signal(SIGINT, stopAgent);
+    signal(SIGTERM, stopAgent);
+    signal(SIGPIPE, SIG_IGN);
+    
+    std::cerr << "Agent listening on " << socketPath << " (locks after "
+              << AUTO_LOCK_MINUTES << " minutes idle)" << std::endl;
+    server.serve();
+    runningAgent = nullptr;
+    std::cerr << "Agent stopped; vault locked" << std::endl;
+    return 0;
+}
+
+bool connectAgent(Vault::AgentClient& agent) {
+    if (agent.connect(Vault::defaultAgentSocketPath())) return true;
+    if (errno == ENOENT || errno == ECONNREFUSED) {
+        std::cerr << "Error: no agent running; start one with --agent" << std::endl;
+    } else {
+        std::cerr << "Error: cannot reach the agent: " << std::strerror(errno) << std::endl;
+    }
+    return false;
+}
+
+// Look up one credential through a running agent and print its password
+int runAgentGet(const std::string& service) {
+    Vault::AgentClient agent;
+    if (!connectAgent(agent)) return 1;
+    
+    std::string username;
+    std::string password;
+    if (!agent.get(service, username, password)) {
+        std::cerr << "Error: service '" << service << "' not found" << std::endl;
+        return 1;
+    }
+    std::cout << password << std::endl;
+    Vault::Utils::secureErase(password);
+    return 0;
+}
+
+int runAgentLock() {
+    Vault::AgentClient agent;
+    if (!connectAgent(agent)) return 1;
+    return agent.lock() ? 0 : 1;
+}
+
+// Print the running agent's counters and latencies as JSON
+int runAgentStats() {
+    Vault::AgentClient agent;
+    if (!connectAgent(agent)) return 1;
+    
+    std::string json;
+    if (!agent.stats(json)) return 1;
+    std::cout << json << std::endl;
+    return 0;
+}
+
+void printUsage(const char* program) {
+    std::cerr << "Usage: " << program << " [--batch FILE | --import FILE | --export FILE |\n"
+              << "       " << std::string(std::strlen(program), ' ')
+              << "  --agent | --get SERVICE | --agent-stats | --agent-lock]\n"
+              << "  (no arguments)  Interactive session\n"
+              << "  --batch FILE    Apply JSON Lines operations from FILE (- for stdin)\n"
+              << "                  and print one JSON result per line\n"
+              << "  --import FILE   Add every credential in a .csv or .jsonl file\n"
+              << "  --export FILE   Write every credential to a .csv or .jsonl file\n"
+              << "  --agent         Unlock once and serve lookups on a local socket\n"
+              << "  --get SERVICE   Print a password from the running agent\n"
+              << "  --agent-stats   Print the running agent's request counts and latencies\n"
+              << "  --agent-lock    Lock the running agent's vault and stop it\n";
+}
+
+int main(int argc, char* argv[]) {
+    if (argc > 1) {
+        std::string option = argv[1];
+        try {
+            if (argc == 3) {
+                if (option == "--batch") return runBatchMode(argv[2]);
+                if (option == "--import" || option == "--export") {
+                    return runTransferMode(argv[2], option == "--import");
+                }
+                if (option == "--get") return runAgentGet(argv[2]);
+            } else if (argc == 2) {
+                if (option == "--agent") return runAgentMode();
+                if (option == "--agent-stats") return runAgentStats();
+                if (option == "--agent-lock") return runAgentLock();
+            }
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+            return 1;
+        }
+        printUsage(argv[0]);
+        return option == "--help" || option == "-h" ? 0 : 2;
+    }
+    
     try {
         PasswordManagerCLI app;
         app.run();
@@ -0,0 +1,99 @@
+#include "mapped_file.hpp"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+
+namespace Vault {
+
+// MappedFile Implementation
+MappedFile::~MappedFile() {
+    close();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept : bytes(other.bytes), length(other.length) {
+    other.bytes = nullptr;
+    other.length = 0;
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+    if (this != &other) {
+        close();
+        bytes = other.bytes;
+        length = other.length;
+        other.bytes = nullptr;
+        other.length = 0;
+    }
+    return *this;
+}
+
+bool MappedFile::open(const std::string& path) {
+    close();
+
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        ::close(fd);
+        return false;
+    }
+    if (st.st_size == 0) {
+        // mmap rejects empty ranges; no vault file is empty anyway
+        ::close(fd);
+        errno = EINVAL;
+        return false;
+    }
+
+    void* mapped = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    int mapError = errno;
+    ::close(fd); // The mapping keeps its own reference to the file
+    if (mapped == MAP_FAILED) {
+        errno = mapError;
+        return false;
+    }
+
+    bytes = static_cast<const uint8_t*>(mapped);
+    length = st.st_size;
+    return true;
+}
+
+void MappedFile::release(size_t offset, size_t size) const {
+    if (!bytes || offset >= length) return;
+
+    uintptr_t page = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+    uintptr_t start = reinterpret_cast<uintptr_t>(bytes) + offset;
+    uintptr_t end = start + std::min(size, length - offset);
+    start = (start + page - 1) & ~(page - 1);
+    end &= ~(page - 1);
+    if (start < end) {
+        // Advisory only: a failure leaves the pages where they were
+        madvise(reinterpret_cast<void*>(start), end - start, MADV_DONTNEED);
+    }
+}
+
+void MappedFile::close() {
+    if (!bytes) return;
+
+    munmap(const_cast<uint8_t*>(bytes), length);
+    bytes = nullptr;
+    length = 0;
+}
+
+bool writeAll(int fd, const void* data, size_t size) {
+    const char* bytes = static_cast<const char*>(data);
+    while (size > 0) {
+        ssize_t written = ::write(fd, bytes, size);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        bytes += written;
+        size -= written;
+    }
+    return true;
+}
+
+} // namespace Vault
@@ -0,0 +1,65 @@
+#ifndef MAPPED_FILE_HPP
+#define MAPPED_FILE_HPP
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+namespace Vault {
+    /**
+     * Read-only memory mapping of a whole file. The mapping stays valid
+     * after the file is renamed over or unlinked, so it is safe for vault
+     * snapshots, which are only ever replaced atomically.
+     */
+    class MappedFile {
+    public:
+        MappedFile() = default;
+        ~MappedFile();
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+        MappedFile(MappedFile&& other) noexcept;
+        MappedFile& operator=(MappedFile&& other) noexcept;
+
+        /**
+         * Map a file, replacing any current mapping
+         * @param path File to map
+         * @return true if successful; errno describes a failure
+         */
+        bool open(const std::string& path);
+
+        /**
+         * Unmap the file
+         */
+        void close();
+
+        /**
+         * Drop the pages of a range from this process's memory. The
+         * mapping stays valid; the pages are read back from the file (or
+         * the page cache) on next access.
+         * @param offset First byte of the range
+         * @param size Range length in bytes; only whole pages inside the
+         *        range are dropped
+         */
+        void release(size_t offset, size_t size) const;
+
+        const uint8_t* data() const { return bytes; }
+        size_t size() const { return length; }
+        bool isOpen() const { return bytes != nullptr; }
+
+    private:
+        const uint8_t* bytes = nullptr;
+        size_t length = 0;
+    };
+
+    /**
+     * Write a whole buffer, retrying short writes and EINTR
+     * @param fd Open file descriptor
+     * @param data Bytes to write
+     * @param size Number of bytes
+     * @return true if successful; errno describes a failure
+     */
+    bool writeAll(int fd, const void* data, size_t size);
+}
+
+#endif // MAPPED_FILE_HPP
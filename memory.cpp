@@ -0,0 +1,105 @@
+#include "memory.hpp"
+#include <atomic>
+#include <cstdlib>
+#include <fstream>
+#include <new>
+#include <unistd.h>
+
+#if defined(__GLIBC__) && !defined(VAULT_NO_TRACE)
+#include <malloc.h>
+
+namespace {
+    // Constant-initialised, so allocations made during static
+    // initialisation are counted too
+    std::atomic<size_t> allocated{0};
+    std::atomic<size_t> highWater{0};   // Since the process started; never lowered
+    std::atomic<size_t> scopeMark{0};   // Since the innermost PeakScope began
+
+    void raise(std::atomic<size_t>& mark, size_t bytes) {
+        size_t seen = mark.load(std::memory_order_relaxed);
+        while (bytes > seen &&
+               !mark.compare_exchange_weak(seen, bytes, std::memory_order_relaxed)) {
+        }
+    }
+
+    void raisePeak(size_t bytes) {
+        raise(highWater, bytes);
+        raise(scopeMark, bytes);
+    }
+}
+
+// The array, nothrow and sized forms of the library forward to these two.
+// Blocks are counted at their usable size, which is what free() returns.
+void* operator new(size_t size) {
+    void* block;
+    while (!(block = std::malloc(size ? size : 1))) {
+        std::new_handler handler = std::get_new_handler();
+        if (!handler) throw std::bad_alloc();
+        handler();
+    }
+    size_t bytes = malloc_usable_size(block);
+    raisePeak(allocated.fetch_add(bytes, std::memory_order_relaxed) + bytes);
+    return block;
+}
+
+void operator delete(void* block) noexcept {
+    if (!block) return;
+    allocated.fetch_sub(malloc_usable_size(block), std::memory_order_relaxed);
+    std::free(block);
+}
+
+void operator delete(void* block, size_t) noexcept {
+    ::operator delete(block);
+}
+
+namespace Memory {
+
+size_t inUse() {
+    return allocated.load(std::memory_order_relaxed);
+}
+
+size_t peak() {
+    return highWater.load(std::memory_order_relaxed);
+}
+
+// PeakScope Implementation
+PeakScope::PeakScope(size_t& peakBytes)
+    : result(peakBytes),
+      outerPeak(scopeMark.exchange(allocated.load(std::memory_order_relaxed),
+                                   std::memory_order_relaxed)) {}
+
+PeakScope::~PeakScope() {
+    result = scopeMark.load(std::memory_order_relaxed);
+    raise(scopeMark, outerPeak);
+}
+
+} // namespace Memory
+
+#else
+
+namespace Memory {
+
+size_t inUse() {
+    return 0;
+}
+
+size_t peak() {
+    return 0;
+}
+
+} // namespace Memory
+
+#endif
+
+namespace Memory {
+
+size_t residentSize() {
+    // statm: total and resident size, in pages
+    std::ifstream statm("/proc/self/statm");
+    size_t pages = 0;
+    size_t resident = 0;
+    if (!(statm >> pages >> resident)) return 0;
+    return resident * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+}
+
+} // namespace Memory
@@ -0,0 +1,64 @@
+#ifndef MEMORY_HPP
+#define MEMORY_HPP
+
+#include <cstddef>
+
+/*
+ * Heap accounting. Every operator new and delete in the process is
+ * counted, so the bytes in use and their high-water mark can be read at
+ * any time, and the peak of one stretch of work (an unlock, a save) is
+ * measured by a Memory::PeakScope on the stack. Counting costs a relaxed
+ * atomic add per allocation and per release.
+ *
+ * It needs glibc's malloc_usable_size() and is compiled out along with
+ * the timings under -DVAULT_NO_TRACE (make TRACE=0); every figure is then 0.
+ * Allocations made inside OpenSSL go straight to malloc and are not seen.
+ */
+namespace Memory {
+#if defined(__GLIBC__) && !defined(VAULT_NO_TRACE)
+    constexpr bool ENABLED = true;
+#else
+    constexpr bool ENABLED = false;
+#endif
+
+    /**
+     * @return Heap bytes currently allocated through operator new
+     */
+    size_t inUse();
+
+    /**
+     * @return Highest inUse() seen since the process started
+     */
+    size_t peak();
+
+    /**
+     * @return Resident set size of the process in bytes, heap, stacks and
+     *         mapped files included; 0 where it cannot be read
+     */
+    size_t residentSize();
+
+#if defined(__GLIBC__) && !defined(VAULT_NO_TRACE)
+    // Stores the heap high-water mark between construction and
+    // destruction in `result`. Scopes nest: an enclosing scope still sees
+    // the peak of the ones inside it. peak() is not affected.
+    class PeakScope {
+    public:
+        explicit PeakScope(size_t& result);
+        ~PeakScope();
+
+        PeakScope(const PeakScope&) = delete;
+        PeakScope& operator=(const PeakScope&) = delete;
+
+    private:
+        size_t& result;
+        size_t outerPeak;
+    };
+#else
+    class PeakScope {
+    public:
+        explicit PeakScope(size_t&) {}
+    };
+#endif
+}
+
+#endif // MEMORY_HPP
@@ -0,0 +1,359 @@
+// Performance regression harness: builds synthetic vaults, times what users
+// wait on (unlock, lookup, list, mutation, save) and compares the timings
+// with a stored baseline. Run with: make perf-test
+#include "crypto.hpp"
+#include "vault.hpp"
+#include "synthetic.hpp"
+#include "json.hpp"
+#include "bench.hpp"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iterator>
+#include <iomanip>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <functional>
+#include <stdexcept>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <unistd.h>
+
+namespace {
+
+const std::string PERF_PASSWORD = "Perf!Passw0rd#2024";
+const uint64_t PERF_SEED = 1;
+const int ROUNDS = 7;                  // Each metric is the median of this many rounds
+const int LOOKUPS_PER_ROUND = 20000;
+const int MUTATIONS_PER_ROUND = 100;
+const int REFERENCE_ITERATIONS = 10000;  // PBKDF2 rounds in the host speed reference
+const std::string REFERENCE_SUFFIX = " reference";
+
+struct Metric {
+    std::string name;                  // "<operation>/<entries>"
+    double nanoseconds;                // Per operation
+    double reference;                  // The reference work, timed alongside
+};
+
+double median(std::vector<double> samples) {
+    std::sort(samples.begin(), samples.end());
+    return samples[samples.size() / 2];
+}
+
+template <typename Fn>
+double timeOps(int operations, Fn&& fn) {
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    return std::chrono::duration<double, std::nano>(
+        std::chrono::steady_clock::now() - start).count() / operations;
+}
+
+// Shared and throttled machines change speed from one run to the next,
+// and within a run. Each round also times fixed CPU work right before
+// the operation, and metrics are compared by their ratio to it.
+double referenceRound() {
+    static const std::vector<uint8_t> salt(Crypto::SALT_SIZE, 0x5a);
+    return timeOps(1, [] { Crypto::deriveKey(PERF_PASSWORD, salt, REFERENCE_ITERATIONS); });
+}
+
+// Median of ROUNDS runs of `round`, which returns nanoseconds per operation
+Metric timeMetric(const std::string& name, const std::function<double()>& round) {
+    std::vector<double> samples;
+    std::vector<double> references;
+    for (int i = 0; i < ROUNDS; ++i) {
+        references.push_back(referenceRound());
+        samples.push_back(round());
+    }
+    return {name, median(samples), median(references)};
+}
+
+std::string formatTime(double nanoseconds) {
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(nanoseconds < 10 ? 2 : 1);
+    if (nanoseconds >= 1e6) {
+        out << nanoseconds / 1e6 << " ms";
+    } else if (nanoseconds >= 1e3) {
+        out << nanoseconds / 1e3 << " us";
+    } else {
+        out << nanoseconds << " ns";
+    }
+    return out.str();
+}
+
+// Vaults go to $PERF_DIR (default /tmp)
+std::string tempVaultPath(size_t entries) {
+    const char* dir = std::getenv("PERF_DIR");
+    return std::string(dir ? dir : "/tmp") + "/spm_perf_" + std::to_string(entries) + "_" +
+           std::to_string(getpid()) + ".dat";
+}
+
+void removeVault(const std::string& path) {
+    std::remove(path.c_str());
+    std::remove((path + ".journal").c_str());
+}
+
+// Time every operation against a fresh synthetic vault of `entries`
+void measure(size_t entries, std::vector<Metric>& metrics) {
+    std::string path = tempVaultPath(entries);
+    removeVault(path);
+    auto start = std::chrono::steady_clock::now();
+    Vault::generateVault(path, PERF_PASSWORD, entries, PERF_SEED);
+    std::cout << "  generated " << entries << " entries in " << std::fixed << std::setprecision(1)
+              << std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count()
+              << " s\n";
+
+    // Look up the same services in the same order on every run
+    std::vector<std::string> names;
+    for (const Vault::Credential& credential :
+         Vault::syntheticCredentials(std::min<size_t>(entries, LOOKUPS_PER_ROUND), PERF_SEED)) {
+        names.push_back(credential.service);
+    }
+    std::vector<std::string> lookups;
+    for (int i = 0; i < LOOKUPS_PER_ROUND; ++i) {
+        lookups.push_back(names[(static_cast<size_t>(i) * 7919) % names.size()]);
+    }
+
+    std::string suffix = "/" + std::to_string(entries);
+
+    metrics.push_back(timeMetric("unlock" + suffix, [&] {
+        Vault::PasswordManager vault(path);
+        double ns = timeOps(1, [&] {
+            if (!vault.unlock(PERF_PASSWORD)) throw std::runtime_error("cannot unlock " + path);
+        });
+        vault.lock();
+        return ns;
+    }));
+
+    Vault::PasswordManager vault(path);
+    vault.unlock(PERF_PASSWORD);
+    // The journal's fsync would measure the disk, not the code
+    vault.setDurability(Vault::Durability::None);
+
+    metrics.push_back(timeMetric("lookup" + suffix, [&] {
+        return timeOps(LOOKUPS_PER_ROUND, [&] {
+            for (const std::string& service : lookups) {
+                Bench::doNotOptimize(vault.getCredential(service).password.size());
+            }
+        });
+    }));
+    // Whole-vault passes, repeated on small vaults to stay above timer noise
+    int passes = static_cast<int>(std::max<size_t>(1, 200000 / entries));
+    metrics.push_back(timeMetric("list" + suffix, [&] {
+        return timeOps(passes, [&] {
+            for (int i = 0; i < passes; ++i) {
+                vault.forEachCredential([&](const Vault::CredentialSummary& credential) {
+                    Bench::doNotOptimize(credential.username.size());
+                });
+            }
+        });
+    }));
+    metrics.push_back(timeMetric("services" + suffix, [&] {
+        return timeOps(passes, [&] {
+            for (int i = 0; i < passes; ++i) Bench::doNotOptimize(vault.getServices().size());
+        });
+    }));
+    metrics.push_back(timeMetric("add+remove" + suffix, [&] {
+        return timeOps(MUTATIONS_PER_ROUND, [&] {
+            for (int i = 0; i < MUTATIONS_PER_ROUND; ++i) {
+                std::string service = "perf-" + std::to_string(i);
+                vault.addCredential(service, "perf@example.com", "Pa55word!perf");
+                vault.removeCredential(service);
+            }
+        });
+    }));
+    metrics.push_back(timeMetric("save" + suffix, [&] {
+        return timeOps(1, [&] {
+            if (!vault.saveVault()) throw std::runtime_error("cannot save " + path);
+        });
+    }));
+
+    vault.lock();
+    removeVault(path);
+}
+
+// Host details stored with a baseline: timings from another kind of
+// machine are not comparable
+void describeHost(Json::Writer& out) {
+    out.add("host_threads", static_cast<size_t>(std::thread::hardware_concurrency()))
+       .add("cipher_suite", Crypto::cipherSuiteName(Crypto::preferredCipherSuite()))
+       .add("aes_acceleration", Crypto::hasAesAcceleration());
+}
+
+void writeBaseline(const std::string& path, const std::vector<Metric>& metrics) {
+    Json::Writer out;
+    describeHost(out);
+    for (const Metric& metric : metrics) {
+        out.add(metric.name, metric.nanoseconds)
+           .add(metric.name + REFERENCE_SUFFIX, metric.reference);
+    }
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file << out.finish() << "\n";
+    if (!file.flush()) throw std::runtime_error("cannot write " + path);
+}
+
+// Print each metric against the baseline
+// @return Number of metrics slower than the baseline by more than threshold
+int compare(const Json::Object& baseline, const std::vector<Metric>& metrics,
+            double thresholdPercent) {
+    Json::Writer host;
+    describeHost(host);
+    Json::Object current = Json::Object::parse(host.finish());
+    for (const Json::Field& field : current.fields()) {
+        const Json::Field* stored = baseline.find(field.name);
+        if (!stored || stored->value != field.value) {
+            std::cout << "  warning: baseline " << field.name << " is "
+                      << (stored ? stored->value : "missing") << ", this host has "
+                      << field.value << "\n";
+        }
+    }
+
+    auto stored = [&](const std::string& name) {
+        const Json::Field* field = baseline.find(name);
+        return field && !field->isString ? std::strtod(field->value.c_str(), nullptr) : 0.0;
+    };
+
+    std::cout << "\n  Baseline timings are scaled to this host's speed on the reference work\n"
+              << "  " << std::left << std::setw(22) << "metric" << std::right
+              << std::setw(12) << "baseline" << std::setw(12) << "now" << std::setw(10)
+              << "change\n";
+    int regressions = 0;
+    for (const Metric& metric : metrics) {
+        std::cout << "  " << std::left << std::setw(22) << metric.name << std::right;
+        double reference = stored(metric.name + REFERENCE_SUFFIX);
+        double before = reference > 0 ? stored(metric.name) * metric.reference / reference : 0;
+        if (before <= 0) {
+            std::cout << std::setw(12) << "-" << std::setw(12) << formatTime(metric.nanoseconds)
+                      << "       new\n";
+            continue;
+        }
+        double change = (metric.nanoseconds / before - 1) * 100;
+        bool regressed = change > thresholdPercent;
+        regressions += regressed;
+        std::cout << std::setw(12) << formatTime(before) << std::setw(12)
+                  << formatTime(metric.nanoseconds) << std::setw(9) << std::showpos
+                  << std::fixed << std::setprecision(1) << change << std::noshowpos << "%"
+                  << (regressed ? "  REGRESSED" : "") << "\n";
+    }
+    return regressions;
+}
+
+std::vector<size_t> parseEntries(const std::string& list) {
+    std::vector<size_t> sizes;
+    std::istringstream in(list);
+    std::string item;
+    while (std::getline(in, item, ',')) {
+        size_t used = 0;
+        unsigned long long value = 0;
+        try {
+            value = std::stoull(item, &used);
+        } catch (const std::exception&) {
+        }
+        if (used != item.size() || value == 0) {
+            throw std::runtime_error("bad entry count '" + item + "'");
+        }
+        sizes.push_back(static_cast<size_t>(value));
+    }
+    if (sizes.empty()) throw std::runtime_error("no entry counts given");
+    return sizes;
+}
+
+int runCheck(const std::vector<size_t>& sizes, const std::string& baselinePath,
+             double thresholdPercent, bool record) {
+    std::vector<Metric> metrics;
+    for (size_t entries : sizes) {
+        std::cout << "\nvault of " << entries << " entries\n";
+        size_t first = metrics.size();
+        measure(entries, metrics);
+        for (size_t i = first; i < metrics.size(); ++i) {
+            std::cout << "  " << std::left << std::setw(22) << metrics[i].name << std::right
+                      << std::setw(12) << formatTime(metrics[i].nanoseconds) << "\n";
+        }
+    }
+
+    std::ifstream file(baselinePath, std::ios::binary);
+    if (record || !file) {
+        writeBaseline(baselinePath, metrics);
+        std::cout << "\nBaseline " << (record ? "recorded" : "missing; recorded") << " in "
+                  << baselinePath << "\n";
+        return 0;
+    }
+    std::string text((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    int regressions = compare(Json::Object::parse(text), metrics, thresholdPercent);
+    if (regressions > 0) {
+        std::cout << "\n❌ " << regressions << " metric(s) more than " << thresholdPercent
+                  << "% slower than " << baselinePath << "\n";
+        return 1;
+    }
+    std::cout << "\n✅ Within " << thresholdPercent << "% of " << baselinePath << "\n";
+    return 0;
+}
+
+// Create a vault for manual testing; the master password is the first
+// line of stdin
+int runGenerate(const std::string& path, size_t entries, uint64_t seed) {
+    std::string password;
+    std::getline(std::cin, password);
+    if (password.empty()) throw std::runtime_error("no master password on stdin");
+    Vault::generateVault(path, password, entries, seed);
+    Vault::Utils::secureErase(password);
+    std::cout << "Created " << path << " with " << entries << " entries (seed " << seed << ")\n";
+    return 0;
+}
+
+void printPerfUsage(const char* program) {
+    std::cerr << "Usage: " << program << " generate FILE ENTRIES [SEED]\n"
+              << "       " << program << " check [--entries N[,N...]] [--baseline FILE]\n"
+              << "       " << std::string(std::strlen(program), ' ')
+              << "       [--threshold PERCENT] [--record]\n"
+              << "  generate  Create a vault of synthetic credentials; the master\n"
+              << "            password is read from the first line of stdin\n"
+              << "  check     Time unlock, lookup, list, add+remove and save on\n"
+              << "            synthetic vaults and fail on regressions past the\n"
+              << "            threshold (default 25%); --record stores a new baseline\n";
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    std::string command = argc > 1 ? argv[1] : "";
+    try {
+        if (command == "generate" && (argc == 4 || argc == 5)) {
+            std::vector<size_t> entries = parseEntries(argv[3]);
+            if (entries.size() != 1) throw std::runtime_error("give one entry count");
+            uint64_t seed = argc == 5 ? std::stoull(argv[4]) : PERF_SEED;
+            return runGenerate(argv[2], entries.front(), seed);
+        }
+        if (command == "check") {
+            std::vector<size_t> sizes = {10000, 500000};
+            std::string baselinePath = "perf_baseline.json";
+            double threshold = 25;
+            bool record = false;
+            for (int i = 2; i < argc; ++i) {
+                std::string arg = argv[i];
+                if (arg == "--entries" && i + 1 < argc) {
+                    sizes = parseEntries(argv[++i]);
+                } else if (arg == "--baseline" && i + 1 < argc) {
+                    baselinePath = argv[++i];
+                } else if (arg == "--threshold" && i + 1 < argc) {
+                    threshold = std::stod(argv[++i]);
+                } else if (arg == "--record") {
+                    record = true;
+                } else {
+                    printPerfUsage(argv[0]);
+                    return 2;
+                }
+            }
+            std::cout << "🏁 Secure Password Manager performance check\n";
+            return runCheck(sizes, baselinePath, threshold, record);
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    printPerfUsage(argv[0]);
+    return command == "--help" || command == "-h" ? 0 : 2;
+}
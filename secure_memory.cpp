@@ -0,0 +1,267 @@
+#include "secure_memory.hpp"
+#include <openssl/crypto.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstring>
+#include <new>
+
+namespace Crypto {
+
+namespace {
+    // Smallest block a SecureString grows into
+    const size_t MIN_CAPACITY = 16;
+
+    size_t pageRound(size_t size) {
+        size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        return (size + page - 1) / page * page;
+    }
+}
+
+// SecureArena Implementation
+SecureArena::SecureArena() {
+    std::fill(freeLists, freeLists + SIZE_CLASSES, nullptr);
+}
+
+void* SecureArena::mapPages(size_t size, bool& locked) {
+    void* pages = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (pages == MAP_FAILED) {
+        throw std::bad_alloc();
+    }
+#ifdef MADV_DONTDUMP
+    madvise(pages, size, MADV_DONTDUMP);
+#endif
+#ifdef MADV_WIPEONFORK
+    madvise(pages, size, MADV_WIPEONFORK);
+#endif
+    // Best effort: mlock fails past RLIMIT_MEMLOCK, the wipe still applies
+    locked = (mlock(pages, size) == 0);
+    totals.reserved += size;
+    if (locked) totals.locked += size;
+    return pages;
+}
+
+void SecureArena::addSlab(int sizeClass) {
+    bool locked;
+    char* base = static_cast<char*>(mapPages(SLAB_SIZE, locked));
+    slabs.emplace(reinterpret_cast<uintptr_t>(base), Slab{sizeClass, 0, locked});
+
+    // Thread the fresh blocks onto the free list, lowest address first
+    size_t blockSize = MIN_BLOCK << sizeClass;
+    for (size_t offset = SLAB_SIZE; offset >= blockSize; offset -= blockSize) {
+        FreeBlock* block = reinterpret_cast<FreeBlock*>(base + offset - blockSize);
+        block->next = freeLists[sizeClass];
+        freeLists[sizeClass] = block;
+    }
+}
+
+void* SecureArena::allocate(size_t size) {
+    size = std::max<size_t>(size, 1);
+    std::lock_guard<std::mutex> guard(mutex);
+
+    if (size > MAX_SMALL_BLOCK) {
+        bool locked;
+        void* pages = mapPages(pageRound(size), locked);
+        largeBlocks.emplace(reinterpret_cast<uintptr_t>(pages), locked);
+        totals.inUse += size;
+        return pages;
+    }
+
+    int sizeClass = 0;
+    while ((MIN_BLOCK << sizeClass) < size) {
+        ++sizeClass;
+    }
+    if (!freeLists[sizeClass]) {
+        addSlab(sizeClass);
+    }
+    FreeBlock* block = freeLists[sizeClass];
+    freeLists[sizeClass] = block->next;
+    block->next = nullptr; // Blocks are handed out zeroed
+
+    auto slab = std::prev(slabs.upper_bound(reinterpret_cast<uintptr_t>(block)));
+    ++slab->second.live;
+    totals.inUse += size;
+    return block;
+}
+
+void SecureArena::deallocate(void* block, size_t size) noexcept {
+    if (!block) return;
+    size = std::max<size_t>(size, 1);
+    OPENSSL_cleanse(block, size);
+    std::lock_guard<std::mutex> guard(mutex);
+    totals.inUse -= size;
+
+    uintptr_t address = reinterpret_cast<uintptr_t>(block);
+    if (size > MAX_SMALL_BLOCK) {
+        auto large = largeBlocks.find(address);
+        size_t pages = pageRound(size);
+        totals.reserved -= pages;
+        if (large->second) totals.locked -= pages;
+        largeBlocks.erase(large);
+        munmap(block, pages); // Unlocks as well
+        return;
+    }
+
+    auto slab = std::prev(slabs.upper_bound(address));
+    --slab->second.live;
+    FreeBlock* freed = static_cast<FreeBlock*>(block);
+    freed->next = freeLists[slab->second.sizeClass];
+    freeLists[slab->second.sizeClass] = freed;
+}
+
+size_t SecureArena::trim() {
+    std::lock_guard<std::mutex> guard(mutex);
+
+    // Unlink the blocks of empty slabs from the free lists first
+    auto isEmpty = [this](FreeBlock* block) {
+        auto slab = std::prev(slabs.upper_bound(reinterpret_cast<uintptr_t>(block)));
+        return slab->second.live == 0;
+    };
+    for (FreeBlock*& head : freeLists) {
+        FreeBlock** link = &head;
+        while (*link) {
+            if (isEmpty(*link)) {
+                *link = (*link)->next;
+            } else {
+                link = &(*link)->next;
+            }
+        }
+    }
+
+    size_t released = 0;
+    for (auto slab = slabs.begin(); slab != slabs.end();) {
+        if (slab->second.live > 0) {
+            ++slab;
+            continue;
+        }
+        munmap(reinterpret_cast<void*>(slab->first), SLAB_SIZE);
+        totals.reserved -= SLAB_SIZE;
+        if (slab->second.locked) totals.locked -= SLAB_SIZE;
+        released += SLAB_SIZE;
+        slab = slabs.erase(slab);
+    }
+    return released;
+}
+
+SecureArena::Usage SecureArena::usage() const {
+    std::lock_guard<std::mutex> guard(mutex);
+    return totals;
+}
+
+SecureArena& secureArena() {
+    // Never destroyed, so buffers freed during static destruction still
+    // have somewhere to go
+    static SecureArena* arena = new SecureArena();
+    return *arena;
+}
+
+// SecureString Implementation
+SecureString::SecureString(std::string_view text) {
+    assign(text);
+}
+
+SecureString::~SecureString() {
+    release();
+}
+
+SecureString::SecureString(const SecureString& other) {
+    assign(other.view());
+}
+
+SecureString& SecureString::operator=(const SecureString& other) {
+    if (this != &other) {
+        assign(other.view());
+    }
+    return *this;
+}
+
+SecureString::SecureString(SecureString&& other) noexcept
+    : bytes(other.bytes), length(other.length), space(other.space) {
+    other.bytes = nullptr;
+    other.length = 0;
+    other.space = 0;
+}
+
+SecureString& SecureString::operator=(SecureString&& other) noexcept {
+    if (this != &other) {
+        release();
+        bytes = other.bytes;
+        length = other.length;
+        space = other.space;
+        other.bytes = nullptr;
+        other.length = 0;
+        other.space = 0;
+    }
+    return *this;
+}
+
+SecureString& SecureString::operator=(std::string_view text) {
+    assign(text);
+    return *this;
+}
+
+void SecureString::assign(std::string_view text) {
+    clear();
+    append(text.data(), text.size());
+}
+
+void SecureString::append(const char* text, size_t size) {
+    if (size == 0) return;
+    if (length + size > space) {
+        grow(length + size);
+    }
+    std::memcpy(bytes + length, text, size);
+    length += size;
+}
+
+void SecureString::erase(size_t position, size_t count) {
+    if (position >= length) return;
+    count = std::min(count, length - position);
+    std::memmove(bytes + position, bytes + position + count, length - position - count);
+    OPENSSL_cleanse(bytes + length - count, count);
+    length -= count;
+}
+
+void SecureString::resize(size_t size) {
+    if (size > space) {
+        reserve(size);
+    }
+    if (size < length) {
+        OPENSSL_cleanse(bytes + size, length - size);
+    } else if (size > length) {
+        std::memset(bytes + length, 0, size - length);
+    }
+    length = size;
+}
+
+void SecureString::reserve(size_t capacity) {
+    if (capacity <= space) return;
+
+    char* fresh = static_cast<char*>(secureArena().allocate(capacity));
+    if (length > 0) {
+        std::memcpy(fresh, bytes, length);
+    }
+    secureArena().deallocate(bytes, space);
+    bytes = fresh;
+    space = capacity;
+}
+
+void SecureString::grow(size_t size) {
+    reserve(std::max({size, space * 2, MIN_CAPACITY}));
+}
+
+void SecureString::clear() {
+    if (length > 0) {
+        OPENSSL_cleanse(bytes, length);
+    }
+    length = 0;
+}
+
+void SecureString::release() {
+    secureArena().deallocate(bytes, space);
+    bytes = nullptr;
+    length = 0;
+    space = 0;
+}
+
+} // namespace Crypto
@@ -0,0 +1,153 @@
+#ifndef SECURE_MEMORY_HPP
+#define SECURE_MEMORY_HPP
+
+#include <string_view>
+#include <cstdint>
+#include <cstddef>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+
+namespace Crypto {
+    /**
+     * Allocator for secrets. Memory comes from anonymous pages that are
+     * locked into RAM where RLIMIT_MEMLOCK allows, left out of core dumps
+     * and zeroed in forked children; every block is wiped when it is
+     * freed. Small blocks are carved from 64 KiB slabs in power-of-two
+     * size classes, so thousands of secrets share a few pages and a
+     * single mlock; larger blocks get pages of their own. Thread-safe.
+     */
+    class SecureArena {
+    public:
+        struct Usage {
+            size_t reserved = 0;  // Pages mapped for secrets
+            size_t locked = 0;    // Part of reserved that mlock succeeded on
+            size_t inUse = 0;     // Bytes handed out
+        };
+
+        SecureArena();
+
+        SecureArena(const SecureArena&) = delete;
+        SecureArena& operator=(const SecureArena&) = delete;
+
+        /**
+         * @param size Block size in bytes (0 is treated as 1)
+         * @return Zeroed block
+         * @throws std::bad_alloc if no pages can be mapped
+         */
+        void* allocate(size_t size);
+
+        /**
+         * Wipe a block and give it back
+         * @param block Block from allocate(), or nullptr
+         * @param size The size it was allocated with
+         */
+        void deallocate(void* block, size_t size) noexcept;
+
+        /**
+         * Unmap the slabs nothing is allocated from, e.g. once a vault is
+         * locked and its secrets are gone
+         * @return Bytes returned to the system
+         */
+        size_t trim();
+
+        Usage usage() const;
+
+    private:
+        static const size_t SLAB_SIZE = 64 * 1024;
+        static const size_t MIN_BLOCK = 16;
+        static const size_t MAX_SMALL_BLOCK = 4096;
+        static const int SIZE_CLASSES = 9;  // MIN_BLOCK << 0 .. 8
+
+        struct FreeBlock {
+            FreeBlock* next;
+        };
+
+        struct Slab {
+            int sizeClass;
+            size_t live;     // Blocks allocated from it
+            bool locked;
+        };
+
+        // Map `size` bytes of secret pages; sets `locked` if mlock worked
+        void* mapPages(size_t size, bool& locked);
+        void addSlab(int sizeClass);
+
+        mutable std::mutex mutex;
+        FreeBlock* freeLists[SIZE_CLASSES];
+        std::map<uintptr_t, Slab> slabs;                 // By base address
+        std::unordered_map<uintptr_t, bool> largeBlocks; // Base -> locked
+        Usage totals;
+    };
+
+    /**
+     * The process-wide arena every SecureBuffer and SecureString uses
+     */
+    SecureArena& secureArena();
+
+    /**
+     * Growable string for plaintext secrets, held in secureArena(). Unlike
+     * std::string it has no small-string buffer, so even a short password
+     * never sits in the object itself, and contents are wiped whenever
+     * they are cleared, moved to a larger block or freed.
+     */
+    class SecureString {
+    public:
+        SecureString() = default;
+        explicit SecureString(std::string_view text);
+        ~SecureString();
+
+        SecureString(const SecureString& other);
+        SecureString& operator=(const SecureString& other);
+        SecureString(SecureString&& other) noexcept;
+        SecureString& operator=(SecureString&& other) noexcept;
+        SecureString& operator=(std::string_view text);
+
+        void assign(std::string_view text);
+        void append(const char* text, size_t size);
+        void append(std::string_view text) { append(text.data(), text.size()); }
+        void push_back(char c) {
+            if (length == space) grow(length + 1);
+            bytes[length++] = c;
+        }
+
+        /**
+         * Remove characters, wiping the vacated tail
+         * @param position First character to remove
+         * @param count Number of characters to remove
+         */
+        void erase(size_t position, size_t count);
+
+        /**
+         * @param size New size; added characters are '\0'
+         */
+        void resize(size_t size);
+        void reserve(size_t capacity);
+
+        /**
+         * Wipe the contents; the block is kept for reuse
+         */
+        void clear();
+
+        char* data() { return bytes; }
+        const char* data() const { return bytes; }
+        size_t size() const { return length; }
+        size_t capacity() const { return space; }
+        bool empty() const { return length == 0; }
+
+        std::string_view view() const { return std::string_view(bytes, length); }
+        operator std::string_view() const { return view(); }
+
+    private:
+        // Reserve at least `size`, doubling to keep appends amortised
+        void grow(size_t size);
+        // Free the block, wiping it
+        void release();
+
+        char* bytes = nullptr;
+        size_t length = 0;
+        size_t space = 0;
+    };
+}
+
+#endif // SECURE_MEMORY_HPP
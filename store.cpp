@@ -0,0 +1,315 @@
+#include "store.hpp"
+#include <openssl/crypto.h>
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+#include <cstring>
+#include <climits>
+
+namespace Vault {
+
+namespace {
+    const uint32_t EMPTY_SLOT = 0;
+    const uint32_t TOMBSTONE = UINT32_MAX;
+    const size_t MIN_TABLE_SIZE = 16;
+    const size_t MIN_ARENA_SIZE = 4096;
+    const size_t MIN_COMPACT_BYTES = 4096;
+}
+
+// CredentialStore Implementation
+CredentialStore::CredentialStore()
+    : externalBase(nullptr), externalSize(0), arenaUsed(0), deadBytes(0), tombstones(0),
+      bulkStart(SIZE_MAX) {}
+
+CredentialStore::~CredentialStore() {
+    clear();
+}
+
+StoredCredential CredentialStore::viewOf(const Entry& entry) const {
+    const char* base = arena.data() + entry.offset;
+    const char* secret = entry.isInline() ? base + entry.serviceLen + entry.usernameLen
+                                          : externalBase + entry.externalOffset;
+    return {std::string_view(base, entry.serviceLen),
+            std::string_view(base + entry.serviceLen, entry.usernameLen),
+            std::string_view(secret, entry.secretLen)};
+}
+
+std::string_view CredentialStore::serviceOf(uint32_t index) const {
+    const Entry& entry = entries[index];
+    return std::string_view(arena.data() + entry.offset, entry.serviceLen);
+}
+
+size_t CredentialStore::probe(std::string_view service, size_t hash, bool& found) const {
+    // Linear probing; the load factor guarantees an empty slot exists
+    size_t mask = table.size() - 1;
+    size_t slot = hash & mask;
+    size_t firstTombstone = SIZE_MAX;
+
+    while (true) {
+        uint32_t value = table[slot];
+        if (value == EMPTY_SLOT) {
+            found = false;
+            return firstTombstone != SIZE_MAX ? firstTombstone : slot;
+        }
+        if (value == TOMBSTONE) {
+            if (firstTombstone == SIZE_MAX) firstTombstone = slot;
+        } else if (entries[value - 1].hash == hash && serviceOf(value - 1) == service) {
+            found = true;
+            return slot;
+        }
+        slot = (slot + 1) & mask;
+    }
+}
+
+void CredentialStore::rehash(size_t capacity) {
+    std::vector<uint32_t> fresh(capacity, EMPTY_SLOT);
+    size_t mask = capacity - 1;
+    for (uint32_t index : sorted) {
+        size_t slot = entries[index].hash & mask;
+        while (fresh[slot] != EMPTY_SLOT) {
+            slot = (slot + 1) & mask;
+        }
+        fresh[slot] = index + 1;
+    }
+    table.swap(fresh);
+    tombstones = 0;
+}
+
+StoredCredential CredentialStore::find(std::string_view service) const {
+    if (table.empty()) return StoredCredential();
+
+    bool found = false;
+    size_t slot = probe(service, std::hash<std::string_view>{}(service), found);
+    if (!found) return StoredCredential();
+    return viewOf(entries[table[slot] - 1]);
+}
+
+void CredentialStore::put(std::string_view service, std::string_view username,
+                          std::string_view secret) {
+    insert(service, username, secret, INLINE_SECRET, secret.size());
+}
+
+void CredentialStore::putExternal(std::string_view service, std::string_view username,
+                                  size_t secretOffset, size_t secretLength) {
+    if (secretOffset > externalSize || secretLength > externalSize - secretOffset ||
+        secretLength > UINT32_MAX) {
+        throw std::out_of_range("Secret outside the attached block");
+    }
+    insert(service, username, std::string_view(), secretOffset, secretLength);
+}
+
+void CredentialStore::attachExternal(const char* base, size_t size) {
+    externalBase = base;
+    externalSize = size;
+}
+
+void CredentialStore::insert(std::string_view service, std::string_view username,
+                             std::string_view secret, uint64_t externalOffset,
+                             size_t secretLength) {
+    if (service.empty()) {
+        throw std::invalid_argument("Service name cannot be empty");
+    }
+
+    // Keep live entries plus tombstones under 3/4 of the table
+    if ((sorted.size() + tombstones + 1) * 4 > table.size() * 3) {
+        size_t capacity = MIN_TABLE_SIZE;
+        while (capacity < (sorted.size() + 1) * 2) {
+            capacity *= 2;
+        }
+        rehash(capacity);
+    }
+
+    size_t hash = std::hash<std::string_view>{}(service);
+    bool found = false;
+    size_t slot = probe(service, hash, found);
+
+    if (found) {
+        Entry& entry = entries[table[slot] - 1];
+        size_t oldLength = entry.length() - entry.serviceLen;
+        size_t newLength = username.size() + secret.size();
+
+        if (newLength <= oldLength) {
+            // Overwrite in place and wipe what is left of the old fields
+            char* base = arena.data() + entry.offset + entry.serviceLen;
+            std::memcpy(base, username.data(), username.size());
+            if (!secret.empty()) {
+                std::memcpy(base + username.size(), secret.data(), secret.size());
+            }
+            OPENSSL_cleanse(base + newLength, oldLength - newLength);
+            deadBytes += oldLength - newLength;
+        } else {
+            OPENSSL_cleanse(arena.data() + entry.offset, entry.length());
+            deadBytes += entry.length();
+            entry.offset = appendFields(service, username, secret);
+        }
+
+        entry.usernameLen = username.size();
+        entry.secretLen = secretLength;
+        entry.externalOffset = externalOffset;
+        compactArena();
+        return;
+    }
+
+    uint32_t offset = appendFields(service, username, secret);
+    uint32_t index;
+    if (!freeEntries.empty()) {
+        index = freeEntries.back();
+        freeEntries.pop_back();
+    } else {
+        index = entries.size();
+        entries.emplace_back();
+    }
+    entries[index] = Entry{hash, offset, static_cast<uint32_t>(service.size()),
+                           static_cast<uint32_t>(username.size()),
+                           static_cast<uint32_t>(secretLength), externalOffset};
+
+    if (table[slot] == TOMBSTONE) --tombstones;
+    table[slot] = index + 1;
+
+    // Loads arrive in service order, so the common case is an append
+    if (bulkStart != SIZE_MAX || sorted.empty() || serviceOf(sorted.back()) < service) {
+        sorted.push_back(index);
+    } else {
+        auto pos = std::lower_bound(sorted.begin(), sorted.end(), service,
+            [this](uint32_t i, std::string_view name) { return serviceOf(i) < name; });
+        sorted.insert(pos, index);
+    }
+}
+
+bool CredentialStore::erase(std::string_view service) {
+    if (table.empty()) return false;
+
+    bool found = false;
+    size_t slot = probe(service, std::hash<std::string_view>{}(service), found);
+    if (!found) return false;
+
+    endBulkInsert();
+    uint32_t index = table[slot] - 1;
+    table[slot] = TOMBSTONE;
+    ++tombstones;
+
+    auto pos = std::lower_bound(sorted.begin(), sorted.end(), service,
+        [this](uint32_t i, std::string_view name) { return serviceOf(i) < name; });
+    sorted.erase(pos);
+
+    Entry& entry = entries[index];
+    OPENSSL_cleanse(arena.data() + entry.offset, entry.length());
+    deadBytes += entry.length();
+    entry = Entry();
+    freeEntries.push_back(index);
+
+    compactArena();
+    return true;
+}
+
+void CredentialStore::clear() {
+    if (!arena.empty()) {
+        OPENSSL_cleanse(arena.data(), arenaUsed);
+    }
+    std::vector<char>().swap(arena);
+    std::vector<Entry>().swap(entries);
+    std::vector<uint32_t>().swap(freeEntries);
+    std::vector<uint32_t>().swap(table);
+    std::vector<uint32_t>().swap(sorted);
+    bulkStart = SIZE_MAX;
+    arenaUsed = 0;
+    deadBytes = 0;
+    tombstones = 0;
+    externalBase = nullptr;
+    externalSize = 0;
+}
+
+void CredentialStore::reserve(size_t count, size_t bytes) {
+    size_t capacity = std::max(table.size(), MIN_TABLE_SIZE);
+    while (capacity < count * 2) {
+        capacity *= 2;
+    }
+    if (capacity != table.size()) {
+        rehash(capacity);
+    }
+    entries.reserve(count);
+    sorted.reserve(count);
+    if (arenaUsed + bytes > arena.size()) {
+        growArena(arenaUsed + bytes);
+    }
+}
+
+StoreMemory CredentialStore::memoryUsage() const {
+    StoreMemory usage;
+    usage.fields = arena.capacity();
+    usage.entries = entries.capacity() * sizeof(Entry) + freeEntries.capacity() * sizeof(uint32_t);
+    usage.index = (table.capacity() + sorted.capacity()) * sizeof(uint32_t);
+    return usage;
+}
+
+void CredentialStore::beginBulkInsert() {
+    if (bulkStart == SIZE_MAX) {
+        bulkStart = sorted.size();
+    }
+}
+
+void CredentialStore::endBulkInsert() {
+    if (bulkStart == SIZE_MAX) return;
+
+    // One sort and a linear merge instead of a shifting insert per service
+    auto byService = [this](uint32_t a, uint32_t b) { return serviceOf(a) < serviceOf(b); };
+    auto tail = sorted.begin() + bulkStart;
+    bulkStart = SIZE_MAX;
+    std::sort(tail, sorted.end(), byService);
+    std::inplace_merge(sorted.begin(), tail, sorted.end(), byService);
+}
+
+uint32_t CredentialStore::appendFields(std::string_view service, std::string_view username,
+                                       std::string_view secret) {
+    size_t length = service.size() + username.size() + secret.size();
+    if (arenaUsed + length > UINT32_MAX) {
+        throw std::length_error("Credential store is full");
+    }
+    if (arenaUsed + length > arena.size()) {
+        growArena(arenaUsed + length);
+    }
+
+    uint32_t offset = arenaUsed;
+    char* out = arena.data() + offset;
+    std::memcpy(out, service.data(), service.size());
+    std::memcpy(out + service.size(), username.data(), username.size());
+    if (!secret.empty()) {
+        std::memcpy(out + service.size() + username.size(), secret.data(), secret.size());
+    }
+    arenaUsed += length;
+    return offset;
+}
+
+void CredentialStore::growArena(size_t minCapacity) {
+    // Grow by hand rather than via vector::resize so the old block can be
+    // wiped before it goes back to the allocator
+    size_t capacity = std::max({minCapacity, arena.size() * 2, MIN_ARENA_SIZE});
+    std::vector<char> fresh(capacity);
+    if (arenaUsed > 0) {
+        std::memcpy(fresh.data(), arena.data(), arenaUsed);
+        OPENSSL_cleanse(arena.data(), arenaUsed);
+    }
+    arena.swap(fresh);
+}
+
+void CredentialStore::compactArena() {
+    if (deadBytes < MIN_COMPACT_BYTES || deadBytes * 2 < arenaUsed) return;
+
+    // Repack live entries in service order, which also helps listing
+    size_t liveBytes = arenaUsed - deadBytes;
+    std::vector<char> fresh(std::max(liveBytes + liveBytes / 2, MIN_ARENA_SIZE));
+    size_t used = 0;
+    for (uint32_t index : sorted) {
+        Entry& entry = entries[index];
+        std::memcpy(fresh.data() + used, arena.data() + entry.offset, entry.length());
+        entry.offset = used;
+        used += entry.length();
+    }
+
+    OPENSSL_cleanse(arena.data(), arenaUsed);
+    arena.swap(fresh);
+    arenaUsed = used;
+    deadBytes = 0;
+}
+
+} // namespace Vault
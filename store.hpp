@@ -0,0 +1,185 @@
+#ifndef STORE_HPP
+#define STORE_HPP
+
+#include <string_view>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+namespace Vault {
+    /**
+     * Read-only view of a stored credential. `secret` is the password as
+     * the vault sealed it; the store never holds plaintext passwords. The
+     * views stay valid until the next mutation of the store.
+     */
+    struct StoredCredential {
+        std::string_view service;
+        std::string_view username;
+        std::string_view secret;
+
+        explicit operator bool() const { return !service.empty(); }
+    };
+
+    /**
+     * Heap held by a CredentialStore, in bytes of allocated capacity
+     */
+    struct StoreMemory {
+        size_t fields = 0;    // Arena of service names, usernames and inline secrets
+        size_t entries = 0;   // One record per credential, plus the free list
+        size_t index = 0;     // Hash table and service order
+
+        size_t total() const { return fields + entries + index; }
+    };
+
+    /**
+     * In-memory credential store: field bytes packed in one arena, an
+     * open-addressing hash index for O(1) lookups by service name, and a
+     * service-ordered index kept sorted incrementally for listing. Secrets
+     * either live in the arena or stay in an attached external block (the
+     * loaded snapshot) and are referenced from there without copying.
+     */
+    class CredentialStore {
+    public:
+        CredentialStore();
+        ~CredentialStore();
+
+        CredentialStore(const CredentialStore&) = delete;
+        CredentialStore& operator=(const CredentialStore&) = delete;
+
+        /**
+         * Look up a credential without copying or allocating
+         * @param service Service name
+         * @return View of the credential, empty if not found
+         */
+        StoredCredential find(std::string_view service) const;
+
+        /**
+         * Insert or replace a credential, copying all fields into the arena.
+         * The arguments must not point into the store itself (e.g. views
+         * returned by find()).
+         * @param service Service name (must not be empty)
+         * @param username Username
+         * @param secret Sealed password
+         */
+        void put(std::string_view service, std::string_view username, std::string_view secret);
+
+        /**
+         * Insert or replace a credential whose secret stays in the attached
+         * external block
+         * @param service Service name (must not be empty)
+         * @param username Username
+         * @param secretOffset Offset of the sealed password in the block
+         * @param secretLength Length of the sealed password
+         */
+        void putExternal(std::string_view service, std::string_view username,
+                         size_t secretOffset, size_t secretLength);
+
+        /**
+         * Attach the block that putExternal() offsets refer to. The block
+         * must outlive the store's contents; clear() detaches it.
+         * @param base First byte of the block
+         * @param size Block size in bytes
+         */
+        void attachExternal(const char* base, size_t size);
+
+        /**
+         * Remove a credential
+         * @param service Service name
+         * @return true if it was present
+         */
+        bool erase(std::string_view service);
+
+        /**
+         * Wipe and drop every credential
+         */
+        void clear();
+
+        /**
+         * Pre-size the store before a bulk load
+         * @param count Expected number of credentials
+         * @param bytes Expected total size of all fields
+         */
+        void reserve(size_t count, size_t bytes);
+
+        /**
+         * Start a run of inserts that appends new services to the ordered
+         * index unsorted, for loads far too large to keep it sorted one
+         * insert at a time. Lookups keep working; erase() ends the run.
+         */
+        void beginBulkInsert();
+
+        /**
+         * Sort the services added since beginBulkInsert() and merge them
+         * into the ordered index. Must be called before forEachSorted().
+         */
+        void endBulkInsert();
+
+        /**
+         * @return Heap the store holds; attached external blocks not included
+         */
+        StoreMemory memoryUsage() const;
+
+        size_t size() const { return sorted.size(); }
+        bool empty() const { return sorted.empty(); }
+
+        /**
+         * Visit every credential in service-name order
+         * @param visit Callable taking a StoredCredential
+         */
+        template <typename Visitor>
+        void forEachSorted(Visitor&& visit) const {
+            for (uint32_t index : sorted) {
+                visit(viewOf(entries[index]));
+            }
+        }
+
+    private:
+        static const uint64_t INLINE_SECRET = UINT64_MAX;
+
+        struct Entry {
+            size_t hash;
+            uint32_t offset;         // First byte of service in the arena
+            uint32_t serviceLen;
+            uint32_t usernameLen;
+            uint32_t secretLen;
+            uint64_t externalOffset; // Secret offset in the external block,
+                                     // or INLINE_SECRET if it follows username
+
+            bool isInline() const { return externalOffset == INLINE_SECRET; }
+            // Bytes this entry occupies in the arena
+            uint32_t length() const {
+                return serviceLen + usernameLen + (isInline() ? secretLen : 0);
+            }
+        };
+
+        StoredCredential viewOf(const Entry& entry) const;
+        void insert(std::string_view service, std::string_view username,
+                    std::string_view secret, uint64_t externalOffset, size_t secretLength);
+        std::string_view serviceOf(uint32_t index) const;
+
+        // Slot of `service` in the hash table, or of the first free slot
+        // where it would go; sets `found` accordingly
+        size_t probe(std::string_view service, size_t hash, bool& found) const;
+        void rehash(size_t capacity);
+
+        uint32_t appendFields(std::string_view service, std::string_view username,
+                              std::string_view secret);
+        void growArena(size_t minCapacity);
+        void compactArena();
+
+        const char* externalBase;         // Attached block for external secrets
+        size_t externalSize;
+        std::vector<char> arena;          // Field bytes, entry after entry
+        size_t arenaUsed;
+        size_t deadBytes;                 // Arena bytes of replaced or erased entries
+        std::vector<Entry> entries;       // Slots, some of them on the free list
+        std::vector<uint32_t> freeEntries;
+        std::vector<uint32_t> table;      // Entry index + 1; EMPTY_SLOT or TOMBSTONE
+        size_t tombstones;
+        std::vector<uint32_t> sorted;     // Entry indices in service-name order
+        size_t bulkStart;                 // Start of the unsorted tail of `sorted`
+                                          // during a bulk insert, else SIZE_MAX
+    };
+}
+
+#endif // STORE_HPP
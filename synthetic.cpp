@@ -0,0 +1,159 @@
+#include "synthetic.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+namespace Vault {
+
+namespace {
+    // splitmix64: tiny and fully specified, unlike the standard
+    // distributions, so a seed gives the same vault everywhere
+    class SplitMix {
+    public:
+        explicit SplitMix(uint64_t seed) : state(seed) {}
+
+        uint64_t next() {
+            uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+            return z ^ (z >> 31);
+        }
+
+        size_t below(size_t bound) { return static_cast<size_t>(next() % bound); }
+        size_t between(size_t low, size_t high) { return low + below(high - low + 1); }
+
+        template <size_t N>
+        const char* pick(const char* const (&items)[N]) { return items[below(N)]; }
+
+    private:
+        uint64_t state;
+    };
+
+    const char* const SITES[] = {
+        "acme", "northwind", "contoso", "globex", "initech", "umbrella", "hooli", "stark",
+        "bank", "mail", "cloud", "shop", "travel", "insurance", "fitness", "news", "photos",
+        "games", "music", "video", "health", "energy", "school", "library", "forum",
+        "hosting", "payments", "social", "calendar", "notes", "drive", "chat", "jobs",
+        "recipes", "weather", "tickets", "rentals", "pharmacy", "telecom", "utilities",
+        "streaming", "marketplace", "developer", "government", "university"
+    };
+    const char* const TLDS[] = {"com", "com", "com", "org", "net", "io", "co.uk", "de", "fr",
+                                "app", "dev", "com.au"};
+    const char* const SUBDOMAINS[] = {"login", "accounts", "mail", "app", "portal", "my",
+                                      "secure", "auth", "admin", "id"};
+    const char* const DEVICES[] = {"Router", "Wi-Fi", "VPN", "Server", "Database", "Laptop",
+                                   "Phone PIN", "Backup", "Printer", "NAS", "Alarm"};
+    const char* const FIRST_NAMES[] = {"alice", "bob", "carol", "dave", "erin", "frank",
+                                       "grace", "heidi", "ivan", "judy", "mallory", "oscar",
+                                       "peggy", "rupert", "sybil", "trent", "victor", "walter",
+                                       "alexandra", "maximilian"};
+    const char* const LAST_NAMES[] = {"smith", "jones", "garcia", "miller", "davis", "lopez",
+                                      "wilson", "anderson", "thomas", "taylor", "moore",
+                                      "martin", "lee", "nguyen", "kowalski", "oconnor",
+                                      "van-der-berg", "schneider"};
+    const char* const MAIL_DOMAINS[] = {"gmail.com", "outlook.com", "yahoo.com", "icloud.com",
+                                        "proton.me", "example.com", "corp-example.com"};
+    const char* const WORDS[] = {"summer", "dragon", "sunshine", "monkey", "football",
+                                 "shadow", "master", "coffee", "winter", "purple", "tiger",
+                                 "rainbow", "pepper", "cookie"};
+
+    const char PRINTABLE[] =
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789!@#$%^&*()-_=+[]{};:,.<>?";
+    const char TOKEN[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+
+    // Distinct per entry, so names stay unique whatever else is drawn
+    std::string base36(uint64_t value) {
+        std::string digits;
+        do {
+            digits.push_back("0123456789abcdefghijklmnopqrstuvwxyz"[value % 36]);
+            value /= 36;
+        } while (value > 0);
+        std::reverse(digits.begin(), digits.end());
+        return digits;
+    }
+
+    std::string randomChars(SplitMix& rng, const char* alphabet, size_t alphabetSize,
+                            size_t length) {
+        std::string out(length, '\0');
+        for (char& c : out) c = alphabet[rng.below(alphabetSize)];
+        return out;
+    }
+
+    // "site-tag.tld", "sub.site-tag.tld" or "Device site tag"; the shapes
+    // cannot produce each other's names
+    std::string serviceName(SplitMix& rng, size_t index) {
+        std::string tag = base36(index);
+        size_t kind = rng.below(100);
+        if (kind < 55) {
+            return std::string(rng.pick(SITES)) + "-" + tag + "." + rng.pick(TLDS);
+        }
+        if (kind < 85) {
+            return std::string(rng.pick(SUBDOMAINS)) + "." + rng.pick(SITES) + "-" + tag + "." +
+                   rng.pick(TLDS);
+        }
+        return std::string(rng.pick(DEVICES)) + " " + rng.pick(SITES) + " " + tag;
+    }
+
+    std::string username(SplitMix& rng) {
+        std::string first = rng.pick(FIRST_NAMES);
+        std::string last = rng.pick(LAST_NAMES);
+        std::string digits = rng.below(2) ? std::to_string(rng.below(10000)) : "";
+        size_t kind = rng.below(100);
+        if (kind < 65) {
+            const char* separators[] = {".", "_", ""};
+            return first + rng.pick(separators) + last + digits + "@" + rng.pick(MAIL_DOMAINS);
+        }
+        if (kind < 90) return first + digits;
+        return first + "." + last + "@" + rng.pick(SITES) + "-corp.example.com";
+    }
+
+    std::string password(SplitMix& rng) {
+        size_t kind = rng.below(100);
+        if (kind < 25) {
+            std::string word = rng.pick(WORDS);
+            word[0] = static_cast<char>(word[0] - 'a' + 'A');
+            return word + std::to_string(rng.between(1, 9999)) + "!@#$%&*?"[rng.below(8)];
+        }
+        if (kind < 75) {
+            return randomChars(rng, PRINTABLE, sizeof(PRINTABLE) - 1, rng.between(16, 24));
+        }
+        if (kind < 95) return randomChars(rng, PRINTABLE, sizeof(PRINTABLE) - 1, 32);
+        return randomChars(rng, TOKEN, sizeof(TOKEN) - 1, rng.between(64, 128));
+    }
+}
+
+std::vector<Credential> syntheticCredentials(size_t count, uint64_t seed) {
+    std::vector<Credential> credentials(count);
+    for (size_t i = 0; i < count; ++i) {
+        // Seeded per entry, so entry i is the same for any count
+        SplitMix rng(seed ^ (0xD1B54A32D192ED03ULL * (i + 1)));
+        Credential& credential = credentials[i];
+        credential.service = serviceName(rng, i);
+        credential.username = username(rng);
+        credential.password = password(rng);
+    }
+    return credentials;
+}
+
+void generateVault(const std::string& path, const std::string& masterPassword,
+                   size_t count, uint64_t seed) {
+    PasswordManager vault(path);
+    if (vault.vaultExists()) {
+        throw std::runtime_error(path + " already exists");
+    }
+    std::vector<Credential> credentials = syntheticCredentials(count, seed);
+    if (!vault.initializeVault(masterPassword)) {
+        throw std::runtime_error("cannot create " + path);
+    }
+
+    bool saved;
+    {
+        Transaction transaction(vault);
+        saved = vault.addCredentials(credentials) && transaction.commit();
+    }
+    vault.lock();
+    if (!saved) {
+        throw std::runtime_error("cannot save " + path);
+    }
+}
+
+} // namespace Vault
@@ -0,0 +1,40 @@
+#ifndef SYNTHETIC_HPP
+#define SYNTHETIC_HPP
+
+#include "vault.hpp"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace Vault {
+    /**
+     * Made-up credentials for load and performance testing, the same for
+     * the same seed on every platform. Field lengths follow what real
+     * vaults hold:
+     *   service   domains, subdomains and app names, 6 to about 40 chars
+     *   username  mostly e-mail addresses, some handles, 5 to about 45
+     *   password  a quarter memorable (8-14), half generated (16-24), the
+     *             rest long (32) or tokens (64-128)
+     * Service names are unique.
+     * @param count Number of credentials
+     * @param seed Random seed
+     * @return Credentials; entry i does not depend on count
+     */
+    std::vector<Credential> syntheticCredentials(size_t count, uint64_t seed);
+
+    /**
+     * Create a vault holding syntheticCredentials(count, seed) without a
+     * key derivation or journal append per entry: one derivation, entries
+     * sealed in parallel, one save
+     * @param path Vault file to create
+     * @param masterPassword Master password
+     * @param count Number of credentials
+     * @param seed Random seed
+     * @throws std::runtime_error if the vault already exists or cannot be
+     *         saved
+     */
+    void generateVault(const std::string& path, const std::string& masterPassword,
+                       size_t count, uint64_t seed);
+}
+
+#endif // SYNTHETIC_HPP
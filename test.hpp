@@ -0,0 +1,109 @@
+#ifndef TEST_HPP
+#define TEST_HPP
+
+#include <string>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+/*
+ * Minimal unit test support for the test_*.cpp files. A TEST_CASE
+ * registers itself; password_manager_tests runs them all, or those whose
+ * name contains a filter given on the command line (make test).
+ */
+namespace Test {
+    // Thrown by a failed check; ends the case
+    struct Failure : std::runtime_error {
+        using std::runtime_error::runtime_error;
+    };
+
+    struct Case {
+        const char* name;
+        void (*run)();
+    };
+
+    /**
+     * @return Every registered case, in registration order
+     */
+    std::vector<Case>& cases();
+
+    struct Register {
+        Register(const char* name, void (*run)()) { cases().push_back({name, run}); }
+    };
+
+    [[noreturn]] void fail(const char* file, int line, const std::string& message);
+
+    template <typename A, typename B>
+    void checkEqual(const A& actual, const B& expected, const char* expression,
+                    const char* file, int line) {
+        if (actual == expected) return;
+        std::ostringstream message;
+        message << expression << ": got " << actual << ", expected " << expected;
+        fail(file, line, message.str());
+    }
+
+    /**
+     * Directory for a case's files, removed with everything in it when
+     * the case ends
+     */
+    class TempDir {
+    public:
+        TempDir();
+        ~TempDir();
+
+        TempDir(const TempDir&) = delete;
+        TempDir& operator=(const TempDir&) = delete;
+
+        /**
+         * @param name File name
+         * @return Path of that file inside the directory
+         */
+        std::string path(const std::string& name) const { return dir + "/" + name; }
+
+    private:
+        std::string dir;
+    };
+
+    /**
+     * @param path File to read
+     * @return Its contents
+     * @throws Failure if it cannot be read
+     */
+    std::string readFile(const std::string& path);
+
+    /**
+     * @param path File to replace
+     * @param contents What to write
+     * @throws Failure if it cannot be written
+     */
+    void writeFile(const std::string& path, const std::string& contents);
+}
+
+#define TEST_CASE(name)                                             \
+    static void name();                                             \
+    static const Test::Register name##Registration(#name, name);    \
+    static void name()
+
+#define CHECK(condition)                                            \
+    do {                                                            \
+        if (!(condition)) Test::fail(__FILE__, __LINE__, #condition); \
+    } while (0)
+
+#define CHECK_EQ(actual, expected) \
+    Test::checkEqual((actual), (expected), #actual, __FILE__, __LINE__)
+
+// Passes if `expression` throws `type` (or a subclass)
+#define CHECK_THROWS(expression, type)                              \
+    do {                                                            \
+        bool thrown = false;                                        \
+        try {                                                       \
+            expression;                                             \
+        } catch (const type&) {                                     \
+            thrown = true;                                          \
+        }                                                           \
+        if (!thrown) {                                              \
+            Test::fail(__FILE__, __LINE__, #expression " did not throw " #type); \
+        }                                                           \
+    } while (0)
+
+#endif // TEST_HPP
@@ -0,0 +1,111 @@
+// CSV and JSON Lines import parsing, and export round trips
+#include "test.hpp"
+#include "import_export.hpp"
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+const std::string PASSWORD = "Test!Passw0rd#42";
+
+std::vector<Vault::Credential> parseCsv(std::string_view text) {
+    size_t skipped = 0;
+    std::vector<Vault::Credential> records =
+        Vault::parseCredentials(text, Vault::TransferFormat::Csv, skipped);
+    CHECK_EQ(skipped, size_t(0));
+    return records;
+}
+
+// A password that makes the CSV writer quote it: commas, a line break
+// and quotes, both alone and doubled
+std::string awkwardPassword(size_t index, size_t padding) {
+    return "p" + std::to_string(index) + ",\"x\"\n" + std::string(padding, 'y') + "\"\"\r\nz";
+}
+
+std::string csvQuote(const std::string& value) {
+    std::string out = "\"";
+    for (char c : value) {
+        if (c == '"') out.push_back('"');
+        out.push_back(c);
+    }
+    return out + "\"";
+}
+
+} // namespace
+
+TEST_CASE(import_csv_quoted_line_break_and_escaped_quotes) {
+    auto records = parseCsv("name,url,username,password\n"
+                            "\"a,b\",,\"say \"\"hi\"\"\",\"line1\nline2\"\n"
+                            "plain,,bob,\"\"\"\"\n");
+    CHECK_EQ(records.size(), size_t(2));
+    CHECK_EQ(records[0].service, std::string("a,b"));
+    CHECK_EQ(records[0].username, std::string("say \"hi\""));
+    CHECK_EQ(records[0].password.view(), std::string_view("line1\nline2"));
+    CHECK_EQ(records[1].service, std::string("plain"));
+    CHECK_EQ(records[1].password.view(), std::string_view("\""));
+}
+
+TEST_CASE(import_csv_crlf_line_endings) {
+    auto records = parseCsv("name,url,username,password\r\n"
+                            "one,,alice,first\r\n"
+                            "two,,bob,\"kept\r\nbreak\"\r\n");
+    CHECK_EQ(records.size(), size_t(2));
+    CHECK_EQ(records[0].password.view(), std::string_view("first"));
+    CHECK_EQ(records[1].username, std::string("bob"));
+    // A line break inside quotes is data, CR included
+    CHECK_EQ(records[1].password.view(), std::string_view("kept\r\nbreak"));
+}
+
+TEST_CASE(import_csv_byte_order_mark) {
+    auto records = parseCsv("\xEF\xBB\xBFname,username,password\none,alice,first\n");
+    CHECK_EQ(records.size(), size_t(1));
+    CHECK_EQ(records[0].service, std::string("one"));
+}
+
+TEST_CASE(import_csv_chunk_split_inside_quotes) {
+    // Nearly every byte is inside a quoted field, so the parallel split
+    // points land inside quotes and must move to the next record. Uneven
+    // sizes keep the points off record boundaries.
+    const size_t count = 37;
+    std::string text = "name,url,username,password\n";
+    for (size_t i = 0; i < count; ++i) {
+        text += "service" + std::to_string(i) + ",,user,";
+        text += csvQuote(awkwardPassword(i, 40 * 1024 + 997 * i)) + "\n";
+    }
+
+    auto records = parseCsv(text);
+    CHECK_EQ(records.size(), count);
+    for (size_t i = 0; i < records.size(); ++i) {
+        CHECK_EQ(records[i].service, "service" + std::to_string(i));
+        CHECK_EQ(records[i].password.view(),
+                 std::string_view(awkwardPassword(i, 40 * 1024 + 997 * i)));
+    }
+}
+
+TEST_CASE(import_csv_unterminated_quote_is_rejected) {
+    size_t skipped = 0;
+    CHECK_THROWS(Vault::parseCredentials("name,password\none,\"open\n",
+                                         Vault::TransferFormat::Csv, skipped),
+                 std::runtime_error);
+}
+
+TEST_CASE(export_round_trips_through_both_formats) {
+    for (Vault::TransferFormat format : {Vault::TransferFormat::Csv, Vault::TransferFormat::JsonLines}) {
+        Test::TempDir dir;
+        Vault::PasswordManager source(dir.path("source.dat"));
+        CHECK(source.initializeVault(PASSWORD));
+        CHECK(source.addCredential("a,b", "say \"hi\"", awkwardPassword(1, 3)));
+        CHECK(source.addCredential("plain", "", "x"));
+        std::string file = dir.path("export");
+        CHECK_EQ(Vault::exportCredentials(source, file, format), size_t(2));
+
+        Vault::PasswordManager target(dir.path("target.dat"));
+        CHECK(target.initializeVault(PASSWORD));
+        Vault::ImportSummary summary = Vault::importCredentials(target, file, format);
+        CHECK_EQ(summary.imported, size_t(2));
+        CHECK_EQ(target.getCredential("a,b").username, std::string_view("say \"hi\""));
+        CHECK_EQ(target.getCredential("a,b").password, std::string_view(awkwardPassword(1, 3)));
+        CHECK_EQ(target.getCredential("plain").password, std::string_view("x"));
+    }
+}
@@ -0,0 +1,95 @@
+// Journal replay and the ordering of journal appends and store changes
+#include "test.hpp"
+#include "vault.hpp"
+#include <string>
+#include <sys/stat.h>
+
+namespace {
+
+const std::string PASSWORD = "Test!Passw0rd#42";
+
+// Vault whose journal holds three puts, a, b and c
+void writeThreeRecords(const std::string& path) {
+    Vault::PasswordManager vault(path);
+    CHECK(vault.initializeVault(PASSWORD));
+    CHECK(vault.addCredential("a", "user-a", "password-a"));
+    CHECK(vault.addCredential("b", "user-b", "password-b"));
+    CHECK(vault.addCredential("c", "user-c", "password-c"));
+}
+
+} // namespace
+
+TEST_CASE(journal_replays_every_record) {
+    Test::TempDir dir;
+    std::string path = dir.path("vault.dat");
+    writeThreeRecords(path);
+
+    Vault::PasswordManager vault(path);
+    CHECK(vault.unlock(PASSWORD));
+    CHECK_EQ(vault.getCredentialCount(), size_t(3));
+    CHECK_EQ(vault.getCredential("c").password, std::string_view("password-c"));
+}
+
+TEST_CASE(journal_torn_tail_is_dropped) {
+    Test::TempDir dir;
+    std::string path = dir.path("vault.dat");
+    writeThreeRecords(path);
+    std::string journal = Test::readFile(path + ".journal");
+    Test::writeFile(path + ".journal", journal.substr(0, journal.size() - 5));
+
+    Vault::PasswordManager vault(path);
+    CHECK(vault.unlock(PASSWORD));
+    CHECK_EQ(vault.getCredentialCount(), size_t(2));
+    CHECK(vault.getCredential("c").service.empty());
+    // The partial frame is trimmed so the next append follows "b"
+    CHECK(Test::readFile(path + ".journal").size() < journal.size() - 5);
+    CHECK(vault.addCredential("d", "user-d", "password-d"));
+    vault.lock();
+    CHECK(vault.unlock(PASSWORD));
+    CHECK_EQ(vault.getCredential("d").password, std::string_view("password-d"));
+}
+
+TEST_CASE(journal_corrupt_record_fails_unlock_and_keeps_file) {
+    Test::TempDir dir;
+    std::string path = dir.path("vault.dat");
+    writeThreeRecords(path);
+    std::string journal = Test::readFile(path + ".journal");
+    std::string damaged = journal;
+    damaged[journal.size() / 2] ^= 0x01;
+    Test::writeFile(path + ".journal", damaged);
+
+    Vault::PasswordManager vault(path);
+    CHECK(!vault.unlock(PASSWORD));
+    CHECK(vault.isVaultLocked());
+    CHECK_EQ(Test::readFile(path + ".journal"), damaged);
+
+    // With the damage repaired, every record is still there
+    Test::writeFile(path + ".journal", journal);
+    CHECK(vault.unlock(PASSWORD));
+    CHECK_EQ(vault.getCredentialCount(), size_t(3));
+}
+
+TEST_CASE(journal_failed_append_changes_nothing) {
+    Test::TempDir dir;
+    std::string path = dir.path("vault.dat");
+    {
+        Vault::PasswordManager vault(path);
+        CHECK(vault.initializeVault(PASSWORD));
+        CHECK(vault.addCredential("kept", "user", "password"));
+        CHECK(vault.saveVault());
+    }
+    // A directory where the journal should go makes every append fail
+    CHECK_EQ(mkdir((path + ".journal").c_str(), 0700), 0);
+
+    Vault::PasswordManager vault(path);
+    CHECK(vault.unlock(PASSWORD));
+    CHECK(!vault.addCredential("added", "user", "password"));
+    CHECK(vault.getCredential("added").service.empty());
+    CHECK(!vault.removeCredential("kept"));
+    CHECK_EQ(vault.getCredential("kept").password, std::string_view("password"));
+
+    std::vector<Vault::Credential> batch;
+    batch.emplace_back("batch", "user", "password");
+    CHECK(!vault.addCredentials(batch));
+    CHECK_EQ(vault.getCredentialCount(), size_t(1));
+}
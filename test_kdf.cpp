@@ -0,0 +1,83 @@
+// Key derivation: scrypt against RFC 7914 and OpenSSL's implementation
+#include "test.hpp"
+#include "crypto.hpp"
+#include <openssl/evp.h>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+std::string hex(const uint8_t* bytes, size_t length) {
+    static const char digits[] = "0123456789abcdef";
+    std::string out;
+    for (size_t i = 0; i < length; ++i) {
+        out.push_back(digits[bytes[i] >> 4]);
+        out.push_back(digits[bytes[i] & 0x0F]);
+    }
+    return out;
+}
+
+std::string scryptHex(const std::string& password, const std::string& salt, uint64_t n,
+                      uint32_t r, uint32_t p, uint32_t threads, size_t length) {
+    std::vector<uint8_t> out(length);
+    Crypto::scrypt(password, Crypto::ByteSpan(reinterpret_cast<const uint8_t*>(salt.data()), salt.size()),
+                   n, r, p, threads, out.data(), out.size());
+    return hex(out.data(), out.size());
+}
+
+std::string opensslScryptHex(const std::string& password, const std::string& salt, uint64_t n,
+                             uint32_t r, uint32_t p, size_t length) {
+    std::vector<uint8_t> out(length);
+    if (EVP_PBE_scrypt(password.data(), password.size(),
+                       reinterpret_cast<const unsigned char*>(salt.data()), salt.size(),
+                       n, r, p, 0, out.data(), out.size()) != 1) {
+        throw std::runtime_error("EVP_PBE_scrypt failed");
+    }
+    return hex(out.data(), out.size());
+}
+
+} // namespace
+
+TEST_CASE(scrypt_rfc7914_vectors) {
+    CHECK_EQ(scryptHex("", "", 16, 1, 1, 1, 64),
+             "77d6576238657b203b19ca42c18a0497f16b4844e3074ae8dfdffa3fede21442"
+             "fcd0069ded0948f8326a753a0fc81f17e8d3e0fb2e0d3628cf35e20c38d18906");
+    CHECK_EQ(scryptHex("password", "NaCl", 1024, 8, 16, 4, 64),
+             "fdbabe1c9d3472007856e7190d01e9fe7c6ad7cbc8237830e77376634b373162"
+             "2eaf30d92e22a3886ff109279d9830dac727afb94a83ee6d8360cbdfa2cc0640");
+    CHECK_EQ(scryptHex("pleaseletmein", "SodiumChloride", 16384, 8, 1, 1, 64),
+             "7023bdcb3afd7348461c06cd81fd38ebfda8fbba904f8e3ea9b543f6545da1f2"
+             "d5432955613f0fcf62d49705242a9af9e61e85dc0d651e40dfcf017b45575887");
+}
+
+TEST_CASE(scrypt_matches_openssl_for_any_thread_count) {
+    for (uint32_t p : {1u, 3u, 7u}) {
+        std::string expected = opensslScryptHex("correct horse", "battery staple", 1024, 8, p, 32);
+        for (uint32_t threads : {1u, 2u, p, 64u}) {
+            CHECK_EQ(scryptHex("correct horse", "battery staple", 1024, 8, p, threads, 32), expected);
+        }
+    }
+}
+
+TEST_CASE(scrypt_vault_key_matches_openssl) {
+    const std::string salt = "0123456789abcdef0123456789abcdef";
+    Crypto::KdfParams kdf;
+    kdf.algorithm = Crypto::KdfAlgorithm::Scrypt;
+    kdf.iterations = 1;
+    kdf.memoryKiB = 2048;
+    kdf.parallelism = 4;
+    kdf.threads = 4;
+    Crypto::SecureBuffer key = Crypto::deriveSecureKey(
+        "Test!Passw0rd#42", Crypto::ByteSpan(reinterpret_cast<const uint8_t*>(salt.data()), salt.size()), kdf);
+    CHECK_EQ(hex(key.data(), key.size()),
+             opensslScryptHex("Test!Passw0rd#42", salt, kdf.memoryKiB, Crypto::SCRYPT_BLOCK_SIZE,
+                              kdf.parallelism, Crypto::AES_KEY_SIZE));
+}
+
+TEST_CASE(scrypt_rejects_tables_past_the_memory_cap) {
+    // One table of 128 * r * n bytes is already twice MAX_KDF_MEMORY_KIB
+    uint64_t n = static_cast<uint64_t>(Crypto::MAX_KDF_MEMORY_KIB) * 2;
+    CHECK_THROWS(scryptHex("x", "y", n, Crypto::SCRYPT_BLOCK_SIZE, 1, 1, 32), std::runtime_error);
+    CHECK_THROWS(scryptHex("x", "y", 1000, 8, 1, 1, 32), std::runtime_error);
+}
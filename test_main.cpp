@@ -0,0 +1,69 @@
+// Unit test driver: runs every TEST_CASE linked into it, or those whose
+// name contains the first argument. Run with: make test
+#include "test.hpp"
+#include <iostream>
+#include <fstream>
+#include <filesystem>
+#include <iterator>
+#include <cstring>
+#include <cstdlib>
+#include <cerrno>
+#include <unistd.h>
+
+namespace Test {
+
+std::vector<Case>& cases() {
+    // Built on first use: cases register during static initialisation
+    static std::vector<Case> registered;
+    return registered;
+}
+
+void fail(const char* file, int line, const std::string& message) {
+    throw Failure(std::string(file) + ":" + std::to_string(line) + ": " + message);
+}
+
+TempDir::TempDir() {
+    char pattern[] = "/tmp/spm-test-XXXXXX";
+    if (!mkdtemp(pattern)) {
+        fail(__FILE__, __LINE__, std::string("mkdtemp: ") + std::strerror(errno));
+    }
+    dir = pattern;
+}
+
+TempDir::~TempDir() {
+    std::error_code error;
+    std::filesystem::remove_all(dir, error);
+}
+
+std::string readFile(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) fail(__FILE__, __LINE__, "cannot read " + path);
+    return std::string((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+}
+
+void writeFile(const std::string& path, const std::string& contents) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out << contents;
+    if (!out) fail(__FILE__, __LINE__, "cannot write " + path);
+}
+
+} // namespace Test
+
+int main(int argc, char* argv[]) {
+    const char* filter = argc > 1 ? argv[1] : "";
+    int passed = 0;
+    int failed = 0;
+    for (const Test::Case& test : Test::cases()) {
+        if (!std::strstr(test.name, filter)) continue;
+        try {
+            test.run();
+            ++passed;
+            std::cout << "✅ " << test.name << std::endl;
+        } catch (const std::exception& e) {
+            ++failed;
+            std::cout << "❌ " << test.name << ": " << e.what() << std::endl;
+        }
+    }
+    std::cout << "\n" << passed << " passed, " << failed << " failed" << std::endl;
+    return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,51 @@
+// Heap accounting: the process-wide peak and per-scope peaks
+#include "test.hpp"
+#include "memory.hpp"
+#include <memory>
+
+namespace {
+
+// Keeps a block from being optimised away with its allocation
+char* volatile escaped = nullptr;
+
+std::unique_ptr<char[]> allocate(size_t bytes) {
+    std::unique_ptr<char[]> block(new char[bytes]);
+    escaped = block.get();
+    return block;
+}
+
+} // namespace
+
+TEST_CASE(memory_scope_does_not_lower_process_peak) {
+    if (!Memory::ENABLED) return;
+    {
+        std::unique_ptr<char[]> large = allocate(8 << 20);
+    }
+    size_t before = Memory::peak();
+    CHECK(before >= Memory::inUse() + (8 << 20));
+
+    size_t scopePeak = 0;
+    {
+        Memory::PeakScope scope(scopePeak);
+        std::unique_ptr<char[]> small = allocate(1 << 20);
+        CHECK(Memory::peak() >= before);
+    }
+    CHECK(scopePeak >= size_t(1) << 20);
+    CHECK(scopePeak < before);
+    CHECK(Memory::peak() >= before);
+}
+
+TEST_CASE(memory_enclosing_scope_sees_inner_peak) {
+    if (!Memory::ENABLED) return;
+    size_t outer = 0;
+    size_t inner = 0;
+    {
+        Memory::PeakScope outerScope(outer);
+        {
+            Memory::PeakScope innerScope(inner);
+            std::unique_ptr<char[]> block = allocate(4 << 20);
+        }
+    }
+    CHECK(inner >= size_t(4) << 20);
+    CHECK(outer >= inner);
+}
@@ -0,0 +1,145 @@
+// Credential index format: binary records and the text payload of
+// baseline (v1) vaults
+#include "test.hpp"
+#include "vault.hpp"
+#include <string>
+#include <vector>
+#include <utility>
+
+namespace {
+
+const std::string PASSWORD = "Test!Passw0rd#42";
+
+// Fixture written by the original text-format release
+const std::string BASELINE_VAULT = "test_data/baseline_v1.dat";
+const std::string BASELINE_PASSWORD = "Baseline!Passw0rd";
+
+std::vector<std::pair<std::string, std::string>> listCredentials(const Vault::PasswordManager& vault) {
+    std::vector<std::pair<std::string, std::string>> listed;
+    vault.forEachCredential([&](const Vault::CredentialSummary& cred) {
+        listed.emplace_back(std::string(cred.service), std::string(cred.username));
+    });
+    return listed;
+}
+
+// Header of a plaintext-password (version 1) binary index
+std::string plaintextIndexHeader(uint32_t count) {
+    std::string header("SPMR\x01\x00\x00\x00", 8);
+    for (int shift = 0; shift < 32; shift += 8) {
+        header.push_back(static_cast<char>((count >> shift) & 0xFF));
+    }
+    return header;
+}
+
+} // namespace
+
+TEST_CASE(records_round_trip) {
+    Test::TempDir dir;
+    Vault::PasswordManager vault(dir.path("vault.dat"));
+    CHECK(vault.initializeVault(PASSWORD));
+    vault.addCredential("github.com", "alice", "s3cret");
+    vault.addCredential("empty-user", "", "pw");
+    // Long enough for multi-byte length varints
+    vault.addCredential(std::string(300, 's'), std::string(20000, 'u'), std::string(200, 'p'));
+    vault.addCredential("unicode-\xc3\xa9", "\xe2\x9c\x93", "\xf0\x9f\x94\x91");
+
+    std::string index = Vault::RecordFormat::serialize(vault);
+    std::string secrets = Vault::RecordFormat::secrets(vault);
+    auto before = listCredentials(vault);
+
+    Vault::RecordFormat::deserialize(vault, index, secrets);
+    CHECK(listCredentials(vault) == before);
+    CHECK_EQ(vault.getCredential("github.com").password, std::string_view("s3cret"));
+    CHECK_EQ(vault.getCredential(std::string(300, 's')).password, std::string(200, 'p'));
+    CHECK_EQ(vault.getCredential("unicode-\xc3\xa9").password, std::string_view("\xf0\x9f\x94\x91"));
+
+    // The streamed parser takes the same index in one call
+    CHECK_EQ(Vault::RecordFormat::parse(vault, index, secrets), index.size());
+    CHECK(listCredentials(vault) == before);
+}
+
+TEST_CASE(records_truncated_tail_waits_for_more) {
+    Test::TempDir dir;
+    Vault::PasswordManager vault(dir.path("vault.dat"));
+    CHECK(vault.initializeVault(PASSWORD));
+    vault.addCredential("a", "first", "1");
+    vault.addCredential("b", "second", "2");
+    std::string index = Vault::RecordFormat::serialize(vault);
+    std::string secrets = Vault::RecordFormat::secrets(vault);
+
+    // Every cut inside the second record consumes exactly the first one
+    size_t firstEnd = Vault::RecordFormat::parse(vault, index.substr(0, index.size() - 1), secrets);
+    CHECK(firstEnd > 12 && firstEnd < index.size());
+    for (size_t cut = firstEnd; cut < index.size(); ++cut) {
+        CHECK_EQ(Vault::RecordFormat::parse(vault, index.substr(0, cut), secrets), firstEnd);
+        CHECK_EQ(vault.getCredentialCount(), size_t(1));
+    }
+
+    // As a whole index, a cut-off record is an error
+    CHECK_THROWS(Vault::RecordFormat::deserialize(vault, index.substr(0, index.size() - 1), secrets),
+                 std::runtime_error);
+}
+
+TEST_CASE(records_malformed_varint_is_not_truncation) {
+    Test::TempDir dir;
+    Vault::PasswordManager vault(dir.path("vault.dat"));
+    CHECK(vault.initializeVault(PASSWORD));
+
+    // Six continuation bytes: longer than any 32-bit length
+    std::string tooLong = plaintextIndexHeader(1) + std::string("\x80\x80\x80\x80\x80\x01", 6);
+    CHECK_THROWS(Vault::RecordFormat::parse(vault, tooLong, {}), std::runtime_error);
+    // A fifth byte with bits above 32
+    std::string overflow = plaintextIndexHeader(1) + std::string("\xFF\xFF\xFF\xFF\x7F", 5) + "x";
+    CHECK_THROWS(Vault::RecordFormat::parse(vault, overflow, {}), std::runtime_error);
+
+    // The largest 32-bit length is well-formed, only cut off
+    std::string maximal = plaintextIndexHeader(1) + std::string("\xFF\xFF\xFF\xFF\x0F", 5);
+    CHECK_EQ(Vault::RecordFormat::parse(vault, maximal, {}), size_t(12));
+
+    std::string plaintext = plaintextIndexHeader(1) + "\x01" "a" "\x01" "u" "\x02" "pw";
+    CHECK_EQ(Vault::RecordFormat::parse(vault, plaintext, {}), plaintext.size());
+    CHECK_EQ(vault.getCredential("a").password, std::string_view("pw"));
+}
+
+TEST_CASE(records_text_payload_needs_its_markers) {
+    Test::TempDir dir;
+    Vault::PasswordManager vault(dir.path("vault.dat"));
+    CHECK(vault.initializeVault(PASSWORD));
+
+    CHECK_THROWS(Vault::RecordFormat::deserialize(vault, "", {}), std::runtime_error);
+    CHECK_THROWS(Vault::RecordFormat::deserialize(vault, "garbage\nCREDENTIALS_START\n0\n", {}),
+                 std::runtime_error);
+    CHECK_THROWS(Vault::RecordFormat::deserialize(vault, "AUTH_DATA_START\n3\n1 2\n", {}),
+                 std::runtime_error);
+}
+
+TEST_CASE(baseline_text_vault_unlocks_and_converts) {
+    Test::TempDir dir;
+    std::string path = dir.path("vault.dat");
+    std::string original = Test::readFile(BASELINE_VAULT);
+    Test::writeFile(path, original);
+
+    {
+        Vault::PasswordManager vault(path);
+        CHECK(!vault.unlock("not the password"));
+        CHECK_EQ(Test::readFile(path), original);
+    }
+
+    Vault::PasswordManager vault(path);
+    CHECK(vault.unlock(BASELINE_PASSWORD));
+    auto listed = listCredentials(vault);
+    CHECK_EQ(listed.size(), size_t(3));
+    CHECK_EQ(vault.getCredential("github.com").username, std::string_view("alice"));
+    CHECK_EQ(vault.getCredential("github.com").password, std::string_view("s3cret:with:colons"));
+    CHECK_EQ(vault.getCredential("mail.example.org").username, std::string_view("bob smith"));
+    CHECK_EQ(vault.getCredential("mail.example.org").password, std::string_view("p@ss word"));
+    CHECK_EQ(vault.getCredential("no-username").username, std::string_view(""));
+    vault.lock();
+
+    // Converted in place, with the original kept beside it
+    CHECK_EQ(Test::readFile(path + ".v1"), original);
+    CHECK(Test::readFile(path).compare(0, 4, "SPMV") == 0);
+    Vault::PasswordManager reopened(path);
+    CHECK(reopened.unlock(BASELINE_PASSWORD));
+    CHECK(listCredentials(reopened) == listed);
+}
@@ -0,0 +1,121 @@
+#include "trace.hpp"
+#include "json.hpp"
+#include <algorithm>
+#include <cmath>
+#include <string>
+
+namespace Trace {
+
+namespace {
+    const char* const PHASE_NAMES[] = {
+        "unlock", "read_file", "derive_key", "load", "parse", "replay_journal",
+        "save", "fsync", "encrypt", "decrypt", "seal_stream", "open_stream"
+    };
+    static_assert(sizeof(PHASE_NAMES) / sizeof(PHASE_NAMES[0]) ==
+                  static_cast<size_t>(Phase::Count), "a phase has no name");
+
+    // Built on first use, so phases timed during static initialisation
+    // still land somewhere
+    LatencyHistogram* phaseHistograms() {
+        static LatencyHistogram histograms[static_cast<size_t>(Phase::Count)];
+        return histograms;
+    }
+}
+
+// LatencyHistogram Implementation
+LatencyHistogram::LatencyHistogram() : sum(0), maximum(0) {
+    for (std::atomic<uint64_t>& bucket : buckets) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+}
+
+void LatencyHistogram::record(uint64_t nanoseconds) {
+    // Values below SUB_BUCKETS get a bucket each; above, the top bits
+    // after the leading one pick a bucket within the power of two
+    int index = static_cast<int>(nanoseconds);
+    if (nanoseconds >= SUB_BUCKETS) {
+        int exponent = 63 - __builtin_clzll(nanoseconds);
+        int shift = exponent - SUB_BUCKET_BITS;
+        index = (shift + 1) * SUB_BUCKETS +
+                static_cast<int>((nanoseconds >> shift) & (SUB_BUCKETS - 1));
+    }
+    buckets[index].fetch_add(1, std::memory_order_relaxed);
+    sum.fetch_add(nanoseconds, std::memory_order_relaxed);
+
+    uint64_t seen = maximum.load(std::memory_order_relaxed);
+    while (nanoseconds > seen &&
+           !maximum.compare_exchange_weak(seen, nanoseconds, std::memory_order_relaxed)) {
+    }
+}
+
+uint64_t LatencyHistogram::percentile(double fraction) const {
+    uint64_t counts[BUCKETS];
+    uint64_t total = 0;
+    for (int i = 0; i < BUCKETS; ++i) {
+        counts[i] = buckets[i].load(std::memory_order_relaxed);
+        total += counts[i];
+    }
+    if (total == 0) return 0;
+
+    uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(fraction * total)));
+    uint64_t seen = 0;
+    int index = 0;
+    while (index < BUCKETS - 1 && (seen += counts[index]) < rank) {
+        ++index;
+    }
+    if (index < SUB_BUCKETS) return index;
+    int shift = index / SUB_BUCKETS - 1;
+    uint64_t bound = ((static_cast<uint64_t>(SUB_BUCKETS + index % SUB_BUCKETS) + 1) << shift) - 1;
+    // The top bucket's bound can only overstate; the exact max is known
+    return std::min(bound, max());
+}
+
+uint64_t LatencyHistogram::count() const {
+    uint64_t total = 0;
+    for (const std::atomic<uint64_t>& bucket : buckets) {
+        total += bucket.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+void LatencyHistogram::reset() {
+    for (std::atomic<uint64_t>& bucket : buckets) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+    sum.store(0, std::memory_order_relaxed);
+    maximum.store(0, std::memory_order_relaxed);
+}
+
+// Phase registry
+const char* phaseName(Phase phase) {
+    return PHASE_NAMES[static_cast<size_t>(phase)];
+}
+
+const LatencyHistogram& histogram(Phase phase) {
+    return phaseHistograms()[static_cast<size_t>(phase)];
+}
+
+void record(Phase phase, uint64_t nanoseconds) {
+    phaseHistograms()[static_cast<size_t>(phase)].record(nanoseconds);
+}
+
+void reset() {
+    for (size_t i = 0; i < static_cast<size_t>(Phase::Count); ++i) {
+        phaseHistograms()[i].reset();
+    }
+}
+
+void addJson(Json::Writer& out) {
+    out.add("tracing", ENABLED);
+    for (size_t i = 0; i < static_cast<size_t>(Phase::Count); ++i) {
+        const LatencyHistogram& phase = phaseHistograms()[i];
+        std::string name = PHASE_NAMES[i];
+        out.add(name + "_count", static_cast<size_t>(phase.count()))
+           .add(name + "_p50_ns", static_cast<size_t>(phase.percentile(0.50)))
+           .add(name + "_p99_ns", static_cast<size_t>(phase.percentile(0.99)))
+           .add(name + "_max_ns", static_cast<size_t>(phase.max()))
+           .add(name + "_total_ns", static_cast<size_t>(phase.total()));
+    }
+}
+
+} // namespace Trace
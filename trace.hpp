@@ -0,0 +1,182 @@
+#ifndef TRACE_HPP
+#define TRACE_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace Json {
+    class Writer;
+}
+
+/*
+ * Timing of the phases of unlock, load and save and of the crypto under
+ * them, so a slow unlock can be pinned on the KDF, file I/O, decryption or
+ * parsing. A phase is timed by a Trace::Scope on the stack; each sample
+ * goes into a lock-free histogram kept for the life of the process.
+ *
+ * Building with -DVAULT_NO_TRACE (make TRACE=0) makes Scope and Total
+ * empty, so the instrumentation compiles away entirely.
+ */
+namespace Trace {
+#ifdef VAULT_NO_TRACE
+    constexpr bool ENABLED = false;
+#else
+    constexpr bool ENABLED = true;
+#endif
+
+    /**
+     * Lock-free latency histogram with log-linear buckets, sixteen per
+     * power of two (as in HDR histograms), so a percentile is within 6.25%
+     * of the true value. Recording is a few relaxed atomic adds.
+     */
+    class LatencyHistogram {
+    public:
+        LatencyHistogram();
+
+        /**
+         * @param nanoseconds One observation
+         */
+        void record(uint64_t nanoseconds);
+
+        /**
+         * @param fraction Percentile as a fraction, e.g. 0.99
+         * @return Upper bound of the bucket holding it, in nanoseconds;
+         *         0 with no observations
+         */
+        uint64_t percentile(double fraction) const;
+
+        uint64_t count() const;
+        uint64_t total() const { return sum.load(std::memory_order_relaxed); }
+        uint64_t max() const { return maximum.load(std::memory_order_relaxed); }
+
+        /**
+         * Forget every observation. Not atomic with respect to record().
+         */
+        void reset();
+
+    private:
+        static const int SUB_BUCKET_BITS = 4;
+        static const int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+        static const int BUCKETS = (65 - SUB_BUCKET_BITS) * SUB_BUCKETS;
+
+        std::atomic<uint64_t> buckets[BUCKETS];
+        std::atomic<uint64_t> sum;
+        std::atomic<uint64_t> maximum;
+    };
+
+    // Timed phases. Nested phases are also counted in the enclosing one,
+    // e.g. DeriveKey and Load are part of Unlock.
+    enum class Phase {
+        Unlock,         // PasswordManager::unlock, end to end
+        ReadFile,       // Map the vault file and parse its header
+        DeriveKey,      // Master key derivation (PBKDF2, scrypt, Argon2id)
+        Load,           // Unwrap the data key, decrypt and parse the index
+        Parse,          // Index parsing alone, summed over a load
+        ReplayJournal,  // Apply the journal on top of the snapshot
+        Save,           // PasswordManager::saveVault, end to end
+        Sync,           // Each fsync / fdatasync
+        Encrypt,        // Whole-payload encryption (legacy container)
+        Decrypt,        // Whole-payload decryption (legacy container)
+        SealStream,     // One batch of index chunks sealed
+        OpenStream,     // One batch of index chunks opened
+        Count
+    };
+
+    /**
+     * @param phase Phase
+     * @return Short name, e.g. "derive_key"
+     */
+    const char* phaseName(Phase phase);
+
+    /**
+     * @param phase Phase
+     * @return Its histogram
+     */
+    const LatencyHistogram& histogram(Phase phase);
+
+    /**
+     * @param phase Phase
+     * @param nanoseconds Time spent in it
+     */
+    void record(Phase phase, uint64_t nanoseconds);
+
+    /**
+     * Forget every recorded sample
+     */
+    void reset();
+
+    /**
+     * Add tracing (true/false) and, for every phase, <name>_count,
+     * _p50_ns, _p99_ns, _max_ns and _total_ns members
+     * @param out Object being written
+     */
+    void addJson(Json::Writer& out);
+
+#ifndef VAULT_NO_TRACE
+    inline uint64_t elapsedSince(std::chrono::steady_clock::time_point start) {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count());
+    }
+
+    // Records the time from construction to destruction
+    class Scope {
+    public:
+        explicit Scope(Phase phase) : phase(phase), start(std::chrono::steady_clock::now()) {}
+        ~Scope() { record(phase, elapsedSince(start)); }
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        Phase phase;
+        std::chrono::steady_clock::time_point start;
+    };
+
+    // Several timed stretches recorded as one sample on destruction, e.g.
+    // the parsing interleaved with decryption in a streamed load
+    class Total {
+    public:
+        explicit Total(Phase phase) : phase(phase), nanoseconds(0) {}
+        ~Total() { record(phase, nanoseconds); }
+
+        Total(const Total&) = delete;
+        Total& operator=(const Total&) = delete;
+
+        // Adds the time from construction to destruction to the total
+        class Lap {
+        public:
+            explicit Lap(Total& total) : total(total), start(std::chrono::steady_clock::now()) {}
+            ~Lap() { total.nanoseconds += elapsedSince(start); }
+
+            Lap(const Lap&) = delete;
+            Lap& operator=(const Lap&) = delete;
+
+        private:
+            Total& total;
+            std::chrono::steady_clock::time_point start;
+        };
+
+    private:
+        Phase phase;
+        uint64_t nanoseconds;
+    };
+#else
+    class Scope {
+    public:
+        explicit Scope(Phase) {}
+    };
+
+    class Total {
+    public:
+        explicit Total(Phase) {}
+
+        class Lap {
+        public:
+            explicit Lap(Total&) {}
+        };
+    };
+#endif
+}
+
+#endif // TRACE_HPP
@@ -1,30 +1,343 @@
 #include "vault.hpp"
+#include "trace.hpp"
+#include "memory.hpp"
+#include <openssl/crypto.h>
 #include <fstream>
-#include <sstream>
+#include <iterator>
 #include <algorithm>
 #include <random>
 #include <iostream>
 #include <termios.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
 #include <regex>
+#include <stdexcept>
+#include <functional>
+#include <cstdlib>
+#include <cstdint>
+#include <cctype>
 
 namespace Vault {
 
+namespace {
+    // Binary credential record format. Version 1 records carry plaintext
+    // passwords; version 2 records carry the length of a sealed secret kept
+    // outside the index.
+    const char RECORD_MAGIC[4] = {'S', 'P', 'M', 'R'};
+    const uint32_t PLAINTEXT_RECORD_VERSION = 1;
+    const uint32_t RECORD_FORMAT_VERSION = 2;
+    const size_t RECORD_HEADER_SIZE = 12;
+    const size_t MAX_VARINT_SIZE = 5; // Enough for 32-bit lengths
+
+    // Journal format: header [magic][version u32][id size u32][snapshot id],
+    // then frames of [sealed size u32][sealed record]. Version 1 journals
+    // belong to single-payload snapshots and carry plaintext passwords.
+    const char JOURNAL_MAGIC[4] = {'S', 'P', 'M', 'J'};
+    const uint32_t LEGACY_JOURNAL_VERSION = 1;
+    const uint32_t JOURNAL_FORMAT_VERSION = 2;
+    const char* const JOURNAL_KEY_LABEL = "SPMV-JOURNAL";
+    const uint8_t JOURNAL_PUT = 1;
+    const uint8_t JOURNAL_REMOVE = 2;
+
+    // Text payloads from before the key check open with an AUTH_DATA block:
+    // this plaintext sealed under the password on its own, the only proof
+    // such a file gives that the password is right
+    const char LEGACY_AUTH_CHECK[] = "VAULT_AUTH_CHECK";
+
+    // Suffix of the copy a legacy vault leaves when it is converted
+    const char LEGACY_BACKUP_SUFFIX[] = ".v1";
+
+    // Envelope format: the snapshot id doubles as associated data for the
+    // index; each secret is bound to its service name
+    const size_t SNAPSHOT_ID_SIZE = 16;
+    const char INDEX_AAD_LABEL[] = "SPMV-INDEX";
+    const char SECRET_AAD_LABEL[] = "SPMV-SECRET";
+
+    // Heap a loaded store takes per byte of sealed index: the fields in
+    // the arena plus an entry record, hash slots and a place in the order
+    // per credential. Synthetic vaults come to just over 2.
+    const size_t STORE_BYTES_PER_INDEX_BYTE = 2;
+
+    // A bounded-memory save drops the snapshot pages it has copied secrets
+    // from whenever this much more has been written
+    const size_t SNAPSHOT_RELEASE_BYTES = 8 * 1024 * 1024;
+
+    std::vector<uint8_t> labelledAad(const char* label, size_t labelSize,
+                                     const uint8_t* data, size_t size) {
+        std::vector<uint8_t> aad(label, label + labelSize);
+        aad.insert(aad.end(), data, data + size);
+        return aad;
+    }
+
+    // Flush file data to stable storage
+    bool syncFile(int fd) {
+        Trace::Scope trace(Trace::Phase::Sync);
+#ifdef __APPLE__
+        // fsync on macOS stops at the drive cache
+        return fcntl(fd, F_FULLFSYNC) == 0 || fsync(fd) == 0;
+#else
+        return fdatasync(fd) == 0;
+#endif
+    }
+
+    // Make a rename or file creation in the directory of `path` durable
+    bool syncParentDirectory(const std::string& path) {
+        size_t slash = path.find_last_of('/');
+        std::string dir = slash == std::string::npos ? "." : path.substr(0, slash == 0 ? 1 : slash);
+        int fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY);
+        if (fd < 0) return false;
+        Trace::Scope trace(Trace::Phase::Sync);
+        bool synced = fsync(fd) == 0;
+        ::close(fd);
+        return synced;
+    }
+
+    // Replace `path` with what `writeContents` writes so that readers and
+    // crashes see either the old or the new contents, never a mix: temp
+    // file, fsync, rename, fsync dir
+    bool writeFileAtomic(const std::string& path, bool sync,
+                         const std::function<bool(int fd)>& writeContents) {
+        std::string tempPath = path + ".tmp";
+        int fd = ::open(tempPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0600);
+        if (fd < 0) return false;
+        
+        bool ok = false;
+        try {
+            ok = writeContents(fd);
+        } catch (...) {
+            ::close(fd);
+            std::remove(tempPath.c_str());
+            throw;
+        }
+        if (ok && sync) {
+            ok = syncFile(fd);
+        }
+        ok = (::close(fd) == 0) && ok;
+        
+        if (!ok || std::rename(tempPath.c_str(), path.c_str()) != 0) {
+            std::remove(tempPath.c_str());
+            return false;
+        }
+        return !sync || syncParentDirectory(path);
+    }
+
+    // Keep `path` as `copyPath` too: a hard link, so a later rename over
+    // `path` leaves the old contents in place, or a copy where links are
+    // not supported. An existing copy is left alone.
+    bool keepCopy(const std::string& path, const std::string& copyPath) {
+        if (::link(path.c_str(), copyPath.c_str()) == 0 || errno == EEXIST) {
+            return true;
+        }
+        std::ifstream in(path, std::ios::binary);
+        std::string contents((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        if (!in.good() && !in.eof()) return false;
+        return writeFileAtomic(copyPath, true, [&](int fd) {
+            return writeAll(fd, contents.data(), contents.size());
+        });
+    }
+
+    // Coalesces small writes (e.g. one sealed secret at a time) into
+    // chunk-sized write() calls
+    class BufferedWriter {
+    public:
+        explicit BufferedWriter(int fd) : fd(fd), ok(true) {
+            buffer.reserve(Crypto::STREAM_CHUNK_SIZE);
+        }
+
+        void write(const void* data, size_t size) {
+            const char* bytes = static_cast<const char*>(data);
+            if (buffer.size() + size > buffer.capacity()) {
+                flush();
+            }
+            if (size >= buffer.capacity()) {
+                ok = ok && writeAll(fd, bytes, size);
+            } else {
+                buffer.insert(buffer.end(), bytes, bytes + size);
+            }
+        }
+
+        bool flush() {
+            ok = ok && writeAll(fd, buffer.data(), buffer.size());
+            buffer.clear();
+            return ok;
+        }
+
+    private:
+        int fd;
+        bool ok;
+        std::vector<char> buffer;
+    };
+
+    // Appenders for serialized records, into a std::string or, for
+    // plaintext, a Crypto::SecureString
+    template <typename Buffer>
+    void appendFixed(Buffer& out, uint32_t value, int bytes) {
+        for (int i = 0; i < bytes; ++i) {
+            out.push_back(static_cast<char>((value >> (8 * i)) & 0xFF));
+        }
+    }
+
+    template <typename Buffer>
+    void appendVarint(Buffer& out, uint32_t value) {
+        while (value >= 0x80) {
+            out.push_back(static_cast<char>((value & 0x7F) | 0x80));
+            value >>= 7;
+        }
+        out.push_back(static_cast<char>(value));
+    }
+
+    size_t varintSize(uint32_t value) {
+        size_t size = 1;
+        while (value >= 0x80) {
+            value >>= 7;
+            ++size;
+        }
+        return size;
+    }
+
+    template <typename Buffer>
+    void appendField(Buffer& out, std::string_view field) {
+        appendVarint(out, field.size());
+        out.append(field);
+    }
+
+    // Thrown when a record runs past the end of the buffer. A streamed
+    // index parses it again once more data arrives; anything else wrong
+    // with a record is a plain runtime_error.
+    class TruncatedRecord : public std::runtime_error {
+    public:
+        TruncatedRecord() : std::runtime_error("Truncated credential record") {}
+    };
+
+    // Bounds-checked cursor over a contiguous serialized buffer
+    class RecordReader {
+    public:
+        RecordReader(const char* data, size_t size) : pos(data), end(data + size) {}
+
+        bool atEnd() const { return pos == end; }
+        size_t remaining() const { return end - pos; }
+
+        void skip(size_t count) {
+            require(count);
+            pos += count;
+        }
+
+        uint32_t readFixed(int bytes) {
+            require(bytes);
+            uint32_t value = 0;
+            for (int i = 0; i < bytes; ++i) {
+                value |= static_cast<uint32_t>(static_cast<uint8_t>(pos[i])) << (8 * i);
+            }
+            pos += bytes;
+            return value;
+        }
+
+        size_t consumed(const char* start) const { return pos - start; }
+
+        const char* take(size_t count) {
+            require(count);
+            const char* start = pos;
+            pos += count;
+            return start;
+        }
+
+        uint32_t readVarint() {
+            uint32_t value = 0;
+            for (int shift = 0; shift < 35; shift += 7) {
+                require(1);
+                uint8_t byte = static_cast<uint8_t>(*pos++);
+                if (shift == 28 && (byte & 0x70)) {
+                    break; // Over 32 bits
+                }
+                value |= static_cast<uint32_t>(byte & 0x7F) << shift;
+                if (!(byte & 0x80)) return value;
+            }
+            throw std::runtime_error("Malformed credential record");
+        }
+
+        std::string_view readField() {
+            uint32_t length = readVarint();
+            return std::string_view(take(length), length);
+        }
+
+    private:
+        void require(size_t count) const {
+            if (count > static_cast<size_t>(end - pos)) {
+                throw TruncatedRecord();
+            }
+        }
+
+        const char* pos;
+        const char* end;
+    };
+}
+
+size_t defaultMemoryLimit() {
+    const char* setting = std::getenv("SPM_MEMORY_LIMIT");
+    if (!setting || !*setting) return 0;
+    
+    char* end = nullptr;
+    errno = 0;
+    unsigned long long value = std::strtoull(setting, &end, 10);
+    int shift = 0;
+    switch (*end) {
+        case 'K': case 'k': shift = 10; ++end; break;
+        case 'M': case 'm': shift = 20; ++end; break;
+        case 'G': case 'g': shift = 30; ++end; break;
+    }
+    if (!std::isdigit(static_cast<unsigned char>(*setting)) || *end != '\0' || errno == ERANGE ||
+        value > (SIZE_MAX >> shift)) {
+        throw std::invalid_argument(std::string("SPM_MEMORY_LIMIT is not a size: ") + setting);
+    }
+    return static_cast<size_t>(value) << shift;
+}
+
 // PasswordManager Implementation
 PasswordManager::PasswordManager(const std::string& vaultPath) 
-    : vaultFilePath(vaultPath), isLocked(true) {}
+    : vaultFilePath(vaultPath), isLocked(true),
+      cipherSuite(Crypto::CipherSuite::Aes256Gcm), journalSequence(0), journalBytes(0),
+      journalCompactionThreshold(JOURNAL_COMPACTION_BYTES), journaling(true), journalFd(-1),
+      durability(Durability::GroupCommit), groupCommitWindow(DEFAULT_GROUP_COMMIT_WINDOW),
+      journalDirty(false), flusherStop(false), memoryLimit(0), unlockPeakBytes(0),
+      savePeakBytes(0), boundedLoad(false), boundedSave(false), inTransaction(false),
+      journalingBeforeTransaction(true) {}
 
-bool PasswordManager::initializeVault(const std::string& password) {
+PasswordManager::~PasswordManager() {
+    {
+        std::lock_guard<std::mutex> guard(journalMutex);
+        flusherStop = true;
+    }
+    journalCv.notify_all();
+    if (flusherThread.joinable()) {
+        flusherThread.join();
+    }
+    closeJournal();
+}
+
+bool PasswordManager::initializeVault(const std::string& password, Crypto::CipherSuite suite,
+                                      const Crypto::KdfParams& kdf) {
     if (vaultExists()) {
         return false; // Vault already exists
     }
     
-    masterPassword = password;
+    // Derive the session key once; every save reuses it with a fresh IV
+    vaultSalt = Crypto::generateRandomBytes(Crypto::SALT_SIZE);
+    kdfParams = kdf;
+    try {
+        sessionKey = Crypto::deriveSecureKey(password, vaultSalt, kdfParams);
+    } catch (const std::exception& e) {
+        std::cerr << "Error creating vault: " << e.what() << std::endl;
+        return false;
+    }
+    cipherSuite = suite;
+    Crypto::SecureBuffer dataKey = Crypto::generateSecureKey();
+    wrappedDataKey = Crypto::wrapKey(sessionKey, dataKey, cipherSuite);
+    useDataKey(dataKey);
     isLocked = false;
     
-    // Create authentication data for password verification
-    authData = createAuthData(password);
-    
     // Save initial empty vault
     return saveVault();
 }
@@ -33,21 +346,118 @@ bool PasswordManager::unlock(const std::string& password) {
     if (!vaultExists()) {
         return false;
     }
+    Trace::Scope trace(Trace::Phase::Unlock);
+    Memory::PeakScope peak(unlockPeakBytes);
+    
+    MappedFile file;
+    Crypto::EncryptedView encrypted;
+    if (!readVaultFile(file, encrypted)) {
+        return false;
+    }
     
-    if (!loadVault()) {
+    // Single key derivation; the header's key check rejects a wrong
+    // password without touching the payload
+    Crypto::SecureBuffer key;
+    try {
+        key = Crypto::deriveSecureKey(password, encrypted.salt, encrypted.kdf);
+    } catch (const std::exception& e) {
+        std::cerr << "Error loading vault: " << e.what() << std::endl;
         return false;
     }
     
-    // Verify password using authentication data
-    if (!Crypto::verifyPassword(authData, password)) {
+    bool legacyFormat = encrypted.keyCheck.empty();
+    if (!legacyFormat && !Crypto::verifyKey(encrypted, key)) {
         return false;
     }
     
-    masterPassword = password;
+    // Keep the derived key for the session instead of the password; it
+    // unwraps the data key now and wraps it again on save
+    sessionKey = std::move(key);
+    vaultSalt = encrypted.salt.toVector();
+    kdfParams = encrypted.kdf;
     isLocked = false;
     
-    // Load and decrypt all credentials
-    return loadVault();
+    // Only the index is decrypted. Legacy files have no key check: a
+    // wrong password shows up as a failed decryption or, since CBC padding
+    // can pass by chance, as an AUTH_DATA block that does not open. They
+    // are converted only once the password is known to be right.
+    bool loaded = loadCredentials(file, encrypted);
+    if (loaded && legacyFormat) {
+        loaded = verifyLegacyAuth(password) && migrateLegacyVault();
+    }
+    if (!loaded) {
+        lock();
+        return false;
+    }
+    return true;
+}
+
+bool PasswordManager::migrateLegacyVault() {
+    // The old file and its journal stay behind as vault.dat.v1, readable
+    // by the version that wrote them
+    std::string backupPath = vaultFilePath + LEGACY_BACKUP_SUFFIX;
+    bool kept = keepCopy(vaultFilePath, backupPath);
+    if (kept && access(journalPath().c_str(), F_OK) == 0) {
+        kept = keepCopy(journalPath(), backupPath + ".journal");
+    }
+    if (!kept) {
+        std::cerr << "Error converting vault: cannot keep a copy at " << backupPath
+                  << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    
+    // Rewrite in the envelope format so later unlocks skip the passwords
+    return saveVault();
+}
+
+bool PasswordManager::verifyLegacyAuth(const std::string& password) {
+    try {
+        Crypto::EncryptedData auth = std::move(legacyAuth);
+        legacyAuth = Crypto::EncryptedData();
+        // Trial decryption alone is not enough: CBC padding passes by chance
+        return Crypto::decrypt(auth, password) == LEGACY_AUTH_CHECK;
+    } catch (const std::exception&) {
+        return false;
+    }
+}
+
+bool PasswordManager::updateKdf(const std::string& password, const Crypto::KdfParams& kdf) {
+    if (isLocked) return false;
+    
+    try {
+        Crypto::SecureBuffer current = Crypto::deriveSecureKey(password, vaultSalt, kdfParams);
+        if (CRYPTO_memcmp(current.data(), sessionKey.data(), sessionKey.size()) != 0) {
+            return false;
+        }
+        
+        // Re-wrap the data key under a key derived with the new parameters
+        Crypto::SecureBuffer dataKey = Crypto::unwrapKey(sessionKey, wrappedDataKey, cipherSuite);
+        if (dataKey.empty()) {
+            throw std::runtime_error("Data key is not authentic");
+        }
+        std::vector<uint8_t> salt = Crypto::generateRandomBytes(Crypto::SALT_SIZE);
+        Crypto::SecureBuffer key = Crypto::deriveSecureKey(password, salt, kdf);
+        std::vector<uint8_t> wrapped = Crypto::wrapKey(key, dataKey, cipherSuite);
+        
+        // Swap in the new header fields, keeping the old ones until the
+        // snapshot carrying them is on disk
+        std::swap(sessionKey, key);
+        std::swap(vaultSalt, salt);
+        std::swap(wrappedDataKey, wrapped);
+        Crypto::KdfParams previous = kdfParams;
+        kdfParams = kdf;
+        if (!saveVault()) {
+            std::swap(sessionKey, key);
+            std::swap(vaultSalt, salt);
+            std::swap(wrappedDataKey, wrapped);
+            kdfParams = previous;
+            return false;
+        }
+        return true;
+    } catch (const std::exception& e) {
+        std::cerr << "Error changing key derivation: " << e.what() << std::endl;
+        return false;
+    }
 }
 
 void PasswordManager::lock() {
@@ -63,189 +473,967 @@ bool PasswordManager::vaultExists() const {
 bool PasswordManager::addCredential(const std::string& service, 
                                   const std::string& username, 
                                   const std::string& password) {
+    if (isLocked || service.empty()) return false;
+    
+    std::string secret;
+    try {
+        secret = sealSecret(service, password);
+    } catch (const std::exception& e) {
+        std::cerr << "Error adding credential: " << e.what() << std::endl;
+        return false;
+    }
+    // Journal first: if the record cannot be written, nothing has changed
+    if (journaling && !appendJournal(JOURNAL_PUT, service, username, secret)) {
+        return false;
+    }
+    recordUndo(service);
+    credentials.put(service, username, secret);
+    if (journaling) compactJournalIfDue();
+    return true;
+}
+
+bool PasswordManager::addCredentials(const std::vector<Credential>& batch) {
     if (isLocked) return false;
     
-    credentials[service] = Credential(service, username, password);
-    return saveVault();
+    // Sealing dominates; spread it over contiguous slices of the batch
+    std::vector<std::string> sealed(batch.size());
+    Crypto::ThreadPool& pool = Crypto::cryptoPool();
+    size_t slices = std::min(batch.size(), pool.size() * Crypto::STREAM_CHUNKS_PER_THREAD);
+    try {
+        pool.run(slices, [&](size_t slice) {
+            size_t end = batch.size() * (slice + 1) / slices;
+            for (size_t i = batch.size() * slice / slices; i < end; ++i) {
+                if (!batch[i].service.empty()) {
+                    sealed[i] = sealSecret(batch[i].service, batch[i].password);
+                }
+            }
+        });
+    } catch (const std::exception& e) {
+        std::cerr << "Error adding credentials: " << e.what() << std::endl;
+        return false;
+    }
+    
+    size_t bytes = 0;
+    for (size_t i = 0; i < batch.size(); ++i) {
+        bytes += batch[i].service.size() + batch[i].username.size() + sealed[i].size();
+    }
+    credentials.reserve(credentials.size() + batch.size(), bytes);
+    
+    bool allAdded = true;
+    credentials.beginBulkInsert();
+    try {
+        for (size_t i = 0; i < batch.size(); ++i) {
+            const Credential& entry = batch[i];
+            if (entry.service.empty()) {
+                allAdded = false;
+                continue;
+            }
+            if (journaling && !appendJournal(JOURNAL_PUT, entry.service, entry.username, sealed[i])) {
+                allAdded = false;
+                continue;
+            }
+            recordUndo(entry.service);
+            credentials.put(entry.service, entry.username, sealed[i]);
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error adding credentials: " << e.what() << std::endl;
+        allAdded = false;
+    }
+    credentials.endBulkInsert();
+    if (journaling) compactJournalIfDue();
+    return allAdded;
+}
+
+CredentialView PasswordManager::getCredential(std::string_view service) const {
+    if (isLocked) return CredentialView();
+    
+    StoredCredential stored = credentials.find(service);
+    if (!stored) return CredentialView();
+    
+    // Decrypt this one password; the previous one is wiped first
+    if (!openSecret(stored, revealedPassword)) {
+        std::cerr << "Error reading credential: secret for " << stored.service
+                  << " is not authentic" << std::endl;
+        return CredentialView();
+    }
+    return CredentialView{stored.service, stored.username, revealedPassword};
 }
 
-Credential PasswordManager::getCredential(const std::string& service) const {
-    if (isLocked) return Credential();
+bool PasswordManager::readCredential(std::string_view service, std::string& username,
+                                     Crypto::SecureString& password) const {
+    if (isLocked) return false;
+    
+    StoredCredential stored = credentials.find(service);
+    if (!stored) return false;
     
-    auto it = credentials.find(service);
-    if (it != credentials.end()) {
-        return it->second;
+    if (!openSecret(stored, password)) {
+        std::cerr << "Error reading credential: secret for " << stored.service
+                  << " is not authentic" << std::endl;
+        return false;
+    }
+    username.assign(stored.username);
+    return true;
+}
+
+bool PasswordManager::hasCredential(std::string_view service) const {
+    return !isLocked && static_cast<bool>(credentials.find(service));
+}
+
+void PasswordManager::useDataKey(const Crypto::SecureBuffer& dataKey) {
+    // Both keep their contexts keyed for the whole session, so sealing or
+    // opening a record costs only the AEAD itself
+    dataCipher.reset(new Crypto::Cipher(dataKey, cipherSuite));
+    journalCipher.reset(new Crypto::Cipher(Crypto::deriveSubkey(dataKey, JOURNAL_KEY_LABEL),
+                                           cipherSuite));
+}
+
+std::string PasswordManager::sealSecret(std::string_view service, std::string_view password) const {
+    std::vector<uint8_t> aad = labelledAad(SECRET_AAD_LABEL, sizeof(SECRET_AAD_LABEL) - 1,
+                                           reinterpret_cast<const uint8_t*>(service.data()),
+                                           service.size());
+    std::vector<uint8_t> sealed = dataCipher->seal(
+        reinterpret_cast<const uint8_t*>(password.data()), password.size(), aad.data(), aad.size());
+    return std::string(sealed.begin(), sealed.end());
+}
+
+bool PasswordManager::openSecret(const StoredCredential& stored,
+                                 Crypto::SecureString& password) const {
+    password.clear();
+    std::vector<uint8_t> aad = labelledAad(SECRET_AAD_LABEL, sizeof(SECRET_AAD_LABEL) - 1,
+                                           reinterpret_cast<const uint8_t*>(stored.service.data()),
+                                           stored.service.size());
+    try {
+        return dataCipher->open(reinterpret_cast<const uint8_t*>(stored.secret.data()),
+                                stored.secret.size(), aad.data(), aad.size(), password);
+    } catch (const std::exception&) {
+        return false;
     }
-    return Credential();
 }
 
 std::vector<std::string> PasswordManager::getServices() const {
     std::vector<std::string> services;
     if (isLocked) return services;
     
-    for (const auto& pair : credentials) {
-        services.push_back(pair.first);
-    }
-    std::sort(services.begin(), services.end());
+    // The store keeps its own sorted index
+    services.reserve(credentials.size());
+    credentials.forEachSorted([&](const StoredCredential& cred) {
+        services.emplace_back(cred.service);
+    });
     return services;
 }
 
 bool PasswordManager::removeCredential(const std::string& service) {
     if (isLocked) return false;
     
-    auto it = credentials.find(service);
-    if (it != credentials.end()) {
-        credentials.erase(it);
-        return saveVault();
+    if (!credentials.find(service)) return false;
+    if (journaling && !appendJournal(JOURNAL_REMOVE, service, {}, {})) {
+        return false;
     }
-    return false;
+    recordUndo(service);
+    credentials.erase(service);
+    if (journaling) compactJournalIfDue();
+    return true;
+}
+
+// Where parsing stands in an index that may arrive in pieces
+struct PasswordManager::RecordCursor {
+    bool started = false;
+    uint32_t version = 0;
+    uint32_t remaining = 0;     // Records still to come
+    size_t secretOffset = 0;    // Secrets referenced so far
+    size_t sizeHint = 0;        // Expected index size, for reserving
+};
+
+void PasswordManager::measureCredentials(size_t& indexSize, size_t& secretsSize) const {
+    indexSize = RECORD_HEADER_SIZE;
+    secretsSize = 0;
+    credentials.forEachSorted([&](const StoredCredential& cred) {
+        indexSize += varintSize(cred.service.size()) + cred.service.size() +
+                     varintSize(cred.username.size()) + cred.username.size() +
+                     varintSize(cred.secret.size());
+        secretsSize += cred.secret.size();
+    });
 }
 
-std::string PasswordManager::serializeCredentials() const {
-    std::ostringstream oss;
-    oss << "AUTH_DATA_START\n";
+void PasswordManager::serializeCredentials(const Crypto::ChunkSink& sink) const {
+    // Records are built in a chunk-sized block and handed on as it fills
+    Crypto::SecureString block;
+    block.reserve(Crypto::STREAM_CHUNK_SIZE + RECORD_HEADER_SIZE);
+    auto emit = [&]() {
+        sink(reinterpret_cast<const uint8_t*>(block.data()), block.size());
+        block.clear();
+    };
     
-    // Serialize authentication data
-    auto authSerialized = Crypto::serialize(authData);
-    oss << authSerialized.size() << "\n";
-    for (uint8_t byte : authSerialized) {
-        oss << static_cast<int>(byte) << " ";
-    }
-    oss << "\nAUTH_DATA_END\n";
+    // Header: [magic][version u16][flags u16][record count u32]
+    block.append(RECORD_MAGIC, sizeof(RECORD_MAGIC));
+    appendFixed(block, RECORD_FORMAT_VERSION, 2);
+    appendFixed(block, 0, 2);
+    appendFixed(block, credentials.size(), 4);
     
-    oss << "CREDENTIALS_START\n";
-    oss << credentials.size() << "\n";
+    // Records: [len][service][len][username][secret len], back to back;
+    // the secrets follow the index in the same order
+    credentials.forEachSorted([&](const StoredCredential& cred) {
+        appendField(block, cred.service);
+        appendField(block, cred.username);
+        appendVarint(block, cred.secret.size());
+        if (block.size() >= Crypto::STREAM_CHUNK_SIZE) {
+            emit();
+        }
+    });
+    emit();
+}
+
+size_t PasswordManager::parseCredentialRecords(std::string_view data, RecordCursor& cursor) {
+    RecordReader reader(data.data(), data.size());
     
-    for (const auto& pair : credentials) {
-        const Credential& cred = pair.second;
-        oss << "SERVICE:" << cred.service << "\n";
-        oss << "USERNAME:" << cred.username << "\n";
-        oss << "PASSWORD:" << cred.password << "\n";
-        oss << "---\n";
+    if (!cursor.started) {
+        if (data.size() < RECORD_HEADER_SIZE) return 0;
+        reader.skip(sizeof(RECORD_MAGIC));
+        cursor.version = reader.readFixed(2);
+        if (cursor.version != RECORD_FORMAT_VERSION && cursor.version != PLAINTEXT_RECORD_VERSION) {
+            throw std::runtime_error("Unsupported credential record version");
+        }
+        reader.readFixed(2); // flags, none defined yet
+        cursor.remaining = reader.readFixed(4);
+        cursor.started = true;
+        credentials.reserve(cursor.remaining, cursor.sizeHint);
     }
-    oss << "CREDENTIALS_END\n";
     
-    return oss.str();
+    // Fields are views into the decrypted buffer, copied once into the
+    // store's arena. Records are in service order, so inserts append.
+    size_t consumed = reader.consumed(data.data());
+    try {
+        while (cursor.remaining > 0) {
+            std::string_view service = reader.readField();
+            std::string_view username = reader.readField();
+            
+            if (cursor.version == RECORD_FORMAT_VERSION) {
+                // The secret stays where it is in the snapshot
+                uint32_t secretLength = reader.readVarint();
+                if (!service.empty()) {
+                    credentials.putExternal(service, username, cursor.secretOffset, secretLength);
+                }
+                cursor.secretOffset += secretLength;
+            } else {
+                std::string_view password = reader.readField();
+                if (!service.empty()) {
+                    credentials.put(service, username, sealSecret(service, password));
+                }
+            }
+            
+            --cursor.remaining;
+            consumed = reader.consumed(data.data());
+        }
+    } catch (const TruncatedRecord&) {
+        // The last record is cut off; it is parsed again once the rest
+        // arrives, and reported by the caller if it never does
+    }
+    return consumed;
 }
 
-void PasswordManager::deserializeCredentials(const std::string& data) {
-    std::istringstream iss(data);
-    std::string line;
+void PasswordManager::deserializeCredentials(std::string_view data, size_t secretsSize) {
+    Trace::Scope trace(Trace::Phase::Parse);
+    if (data.compare(0, sizeof(RECORD_MAGIC), RECORD_MAGIC, sizeof(RECORD_MAGIC)) != 0) {
+        // Text payload from an older version; rewritten as binary on next save
+        deserializeLegacyCredentials(data);
+        return;
+    }
     
-    credentials.clear();
+    RecordCursor cursor;
+    cursor.sizeHint = data.size();
+    size_t consumed = parseCredentialRecords(data, cursor);
+    if (!cursor.started || cursor.remaining > 0) {
+        throw std::runtime_error("Truncated credential record");
+    }
+    if (consumed != data.size()) {
+        throw std::runtime_error("Trailing data after credential records");
+    }
+    if (cursor.version == RECORD_FORMAT_VERSION && cursor.secretOffset != secretsSize) {
+        throw std::runtime_error("Sealed secrets do not match the index");
+    }
+}
+
+// RecordFormat Implementation
+std::string RecordFormat::serialize(const PasswordManager& vault) {
+    std::string index;
+    vault.serializeCredentials([&](const uint8_t* data, size_t size) {
+        index.append(reinterpret_cast<const char*>(data), size);
+    });
+    return index;
+}
+
+std::string RecordFormat::secrets(const PasswordManager& vault) {
+    std::string secrets;
+    vault.credentials.forEachSorted([&](const StoredCredential& cred) {
+        secrets.append(cred.secret);
+    });
+    return secrets;
+}
+
+void RecordFormat::deserialize(PasswordManager& vault, std::string_view index,
+                               std::string_view secrets) {
+    vault.credentials.clear();
+    vault.credentials.attachExternal(secrets.data(), secrets.size());
+    vault.deserializeCredentials(index, secrets.size());
+}
+
+size_t RecordFormat::parse(PasswordManager& vault, std::string_view data,
+                           std::string_view secrets) {
+    vault.credentials.clear();
+    vault.credentials.attachExternal(secrets.data(), secrets.size());
+    PasswordManager::RecordCursor cursor;
+    return vault.parseCredentialRecords(data, cursor);
+}
+
+void PasswordManager::deserializeLegacyCredentials(std::string_view data) {
+    // Split on newlines in place, like std::getline but without copies
+    std::string_view line;
+    auto nextLine = [&]() {
+        if (data.empty()) return false;
+        size_t end = data.find('\n');
+        line = data.substr(0, end);
+        data.remove_prefix(end == std::string_view::npos ? data.size() : end + 1);
+        return true;
+    };
     
-    // Parse authentication data
-    while (std::getline(iss, line) && line != "AUTH_DATA_START") {}
+    auto expectLine = [&](std::string_view marker) {
+        if (!nextLine() || line != marker) {
+            throw std::runtime_error("Malformed legacy vault");
+        }
+    };
+    auto readCount = [&]() {
+        if (!nextLine() || line.empty() || line.size() > 9 ||
+            line.find_first_not_of("0123456789") != std::string_view::npos) {
+            throw std::runtime_error("Malformed legacy vault");
+        }
+        return static_cast<size_t>(std::stoul(std::string(line)));
+    };
     
-    if (std::getline(iss, line)) {
-        size_t authSize = std::stoul(line);
-        std::vector<uint8_t> authBytes;
-        
-        if (std::getline(iss, line)) {
-            std::istringstream authStream(line);
-            int byte;
-            while (authStream >> byte) {
-                authBytes.push_back(static_cast<uint8_t>(byte));
+    // The AUTH_DATA block comes first: a serialized container as decimal
+    // bytes, checked against the password by unlock()
+    expectLine("AUTH_DATA_START");
+    size_t authSize = readCount();
+    std::vector<uint8_t> authBytes;
+    authBytes.reserve(authSize);
+    if (nextLine()) {
+        std::string_view bytes = line;
+        while (!bytes.empty()) {
+            size_t end = bytes.find(' ');
+            std::string_view byte = bytes.substr(0, end);
+            bytes.remove_prefix(end == std::string_view::npos ? bytes.size() : end + 1);
+            if (byte.empty()) continue;
+            if (byte.size() > 3 || byte.find_first_not_of("0123456789") != std::string_view::npos) {
+                throw std::runtime_error("Malformed legacy vault");
             }
+            unsigned value = std::stoul(std::string(byte));
+            if (value > 0xFF) {
+                throw std::runtime_error("Malformed legacy vault");
+            }
+            authBytes.push_back(static_cast<uint8_t>(value));
+        }
+    }
+    if (authBytes.size() != authSize) {
+        throw std::runtime_error("Malformed legacy vault");
+    }
+    legacyAuth = Crypto::deserialize(authBytes);
+    expectLine("AUTH_DATA_END");
+    expectLine("CREDENTIALS_START");
+    
+    size_t credCount = readCount();
+    for (size_t i = 0; i < credCount; ++i) {
+        std::string_view service, username, password;
+        
+        if (nextLine() && line.substr(0, 8) == "SERVICE:") {
+            service = line.substr(8);
+        }
+        if (nextLine() && line.substr(0, 9) == "USERNAME:") {
+            username = line.substr(9);
+        }
+        if (nextLine() && line.substr(0, 9) == "PASSWORD:") {
+            password = line.substr(9);
         }
         
-        if (authBytes.size() == authSize) {
-            authData = Crypto::deserialize(authBytes);
+        if (!service.empty()) {
+            credentials.put(service, username, sealSecret(service, password));
         }
+        
+        nextLine(); // Skip separator
     }
+}
+
+bool PasswordManager::saveVault() {
+    if (isLocked || inTransaction) return false;
+    Trace::Scope trace(Trace::Phase::Save);
+    Memory::PeakScope peak(savePeakBytes);
     
-    // Skip to credentials section
-    while (std::getline(iss, line) && line != "CREDENTIALS_START") {}
-    
-    if (std::getline(iss, line)) {
-        size_t credCount = std::stoul(line);
+    try {
+        // Secrets are already sealed, so a save only seals the index
+        Crypto::EncryptedData encrypted;
+        encrypted.salt = vaultSalt;
+        encrypted.kdf = kdfParams;
+        encrypted.cipherSuite = cipherSuite;
+        encrypted.keyCheck = Crypto::computeKeyCheck(sessionKey, vaultSalt, kdfParams);
+        encrypted.wrappedKey = wrappedDataKey;
+        encrypted.iv = Crypto::generateRandomBytes(SNAPSHOT_ID_SIZE);
+        
+        std::vector<uint8_t> aad = labelledAad(INDEX_AAD_LABEL, sizeof(INDEX_AAD_LABEL) - 1,
+                                               encrypted.iv.data(), encrypted.iv.size());
+        
+        size_t indexSize = 0;
+        size_t secretsSize = 0;
+        measureCredentials(indexSize, secretsSize);
+        size_t streamSize = Crypto::StreamEncryptor::sealedSize(indexSize);
+        if (streamSize > UINT32_MAX || secretsSize > UINT32_MAX) {
+            throw std::length_error("Vault is too large");
+        }
+        
+        // The pipeline's buffers are all that a save adds to the heap
+        boundedSave = exceedsMemoryLimit(credentials.memoryUsage().total() + undoLogSize() +
+                                         Crypto::streamBufferSize());
+        size_t batchBytes = boundedSave ? Crypto::STREAM_CHUNK_SIZE : Crypto::STREAM_BATCH_BYTES;
         
-        for (size_t i = 0; i < credCount; ++i) {
-            Credential cred;
+        // Serialization, encryption and writing run as one pipeline: the
+        // index is sealed a chunk at a time and secrets are copied from the
+        // store, so no part of the file is ever built up in memory
+        auto writeSnapshot = [&](int fd) {
+            BufferedWriter out(fd);
+            std::vector<uint8_t> header = Crypto::serializeHeader(encrypted, streamSize);
+            out.write(header.data(), header.size());
             
-            if (std::getline(iss, line) && line.substr(0, 8) == "SERVICE:") {
-                cred.service = line.substr(8);
-            }
-            if (std::getline(iss, line) && line.substr(0, 9) == "USERNAME:") {
-                cred.username = line.substr(9);
-            }
-            if (std::getline(iss, line) && line.substr(0, 9) == "PASSWORD:") {
-                cred.password = line.substr(9);
-            }
+            Crypto::StreamEncryptor stream(*dataCipher, aad, [&](const uint8_t* data, size_t size) {
+                out.write(data, size);
+            }, Crypto::STREAM_CHUNK_SIZE, batchBytes);
+            serializeCredentials([&](const uint8_t* data, size_t size) {
+                stream.update(data, size);
+            });
+            stream.finish();
             
-            if (!cred.service.empty()) {
-                credentials[cred.service] = cred;
+            std::string secretsHeader;
+            appendFixed(secretsHeader, secretsSize, 4);
+            out.write(secretsHeader.data(), secretsHeader.size());
+            // Copying the secrets reads the whole old snapshot; a bounded
+            // save lets go of its pages as it goes
+            size_t unreleased = 0;
+            credentials.forEachSorted([&](const StoredCredential& cred) {
+                out.write(cred.secret.data(), cred.secret.size());
+                unreleased += cred.secret.size();
+                if (boundedSave && unreleased >= SNAPSHOT_RELEASE_BYTES) {
+                    snapshotFile.release(0, snapshotFile.size());
+                    unreleased = 0;
+                }
+            });
+            if (boundedSave) {
+                snapshotFile.release(0, snapshotFile.size());
             }
-            
-            std::getline(iss, line); // Skip separator
+            return out.flush();
+        };
+        
+        if (!writeFileAtomic(vaultFilePath, durability != Durability::None, writeSnapshot)) {
+            std::cerr << "Error saving vault: " << std::strerror(errno) << std::endl;
+            return false;
         }
+        
+        // The new snapshot is durable and contains everything the journal
+        // recorded, so the journal can go
+        snapshotId = encrypted.iv;
+        closeJournal();
+        std::remove(journalPath().c_str());
+        journalSequence = 0;
+        journalBytes = 0;
+        return true;
+        
+    } catch (const std::exception& e) {
+        std::cerr << "Error saving vault: " << e.what() << std::endl;
+        return false;
     }
 }
 
-Crypto::EncryptedData PasswordManager::createAuthData(const std::string& password) const {
-    // Create a known plaintext to verify password correctness
-    const std::string authPlaintext = "VAULT_AUTH_CHECK";
-    return Crypto::encrypt(authPlaintext, password);
+bool PasswordManager::beginTransaction() {
+    if (isLocked || inTransaction) return false;
+    
+    inTransaction = true;
+    journalingBeforeTransaction = journaling;
+    journaling = false;
+    return true;
 }
 
-bool PasswordManager::saveVault() {
-    if (isLocked) return false;
+bool PasswordManager::commit() {
+    if (!inTransaction) return false;
+    
+    inTransaction = false;
+    bool saved = saveVault();
+    if (!saved) {
+        // Nothing reached disk; leave memory matching it
+        inTransaction = true;
+        rollback();
+        return false;
+    }
+    undoLog.clear();
+    journaling = journalingBeforeTransaction;
+    return true;
+}
+
+void PasswordManager::rollback() {
+    if (!inTransaction) return;
+    
+    for (const auto& [service, entry] : undoLog) {
+        if (entry.existed) {
+            credentials.put(service, entry.username, entry.secret);
+        } else {
+            credentials.erase(service);
+        }
+    }
+    undoLog.clear();
+    inTransaction = false;
+    journaling = journalingBeforeTransaction;
+}
+
+void PasswordManager::recordUndo(const std::string& service) {
+    if (!inTransaction || undoLog.count(service)) return;
+    
+    UndoEntry entry;
+    StoredCredential stored = credentials.find(service);
+    if (stored) {
+        entry.existed = true;
+        entry.username.assign(stored.username);
+        entry.secret.assign(stored.secret);
+    }
+    undoLog.emplace(service, std::move(entry));
+}
+
+size_t PasswordManager::undoLogSize() const {
+    // A node per service plus whatever its strings keep outside the object
+    if (undoLog.empty()) return 0;
+    const size_t inlineCapacity = std::string().capacity();
+    size_t bytes = undoLog.bucket_count() * sizeof(void*);
+    for (const auto& [service, entry] : undoLog) {
+        bytes += sizeof(std::pair<const std::string, UndoEntry>) + 2 * sizeof(void*);
+        for (const std::string* field : {&service, &entry.username, &entry.secret}) {
+            if (field->capacity() > inlineCapacity) {
+                bytes += field->capacity() + 1;
+            }
+        }
+    }
+    return bytes;
+}
+
+MemoryUsage PasswordManager::getMemoryUsage() const {
+    MemoryUsage usage;
+    usage.store = credentials.memoryUsage();
+    usage.secure = Crypto::secureArena().usage();
+    usage.transaction = undoLogSize();
+    usage.snapshot = snapshotFile.size();
+    usage.heapInUse = Memory::inUse();
+    usage.resident = Memory::residentSize();
+    usage.unlockPeak = unlockPeakBytes;
+    usage.savePeak = savePeakBytes;
+    usage.limit = memoryLimit;
+    usage.boundedLoad = boundedLoad;
+    usage.boundedSave = boundedSave;
+    return usage;
+}
+
+bool PasswordManager::loadVault() {
+    if (isLocked || inTransaction) return false;
+    
+    MappedFile file;
+    Crypto::EncryptedView encrypted;
+    if (!readVaultFile(file, encrypted)) {
+        return false;
+    }
+    return loadCredentials(file, encrypted);
+}
+
+bool PasswordManager::readVaultFile(MappedFile& file, Crypto::EncryptedView& encrypted) const {
+    Trace::Scope trace(Trace::Phase::ReadFile);
+    // Map rather than read: the container is parsed in place and the
+    // sealed secrets are later read straight from the page cache
+    if (!file.open(vaultFilePath)) {
+        return false;
+    }
     
     try {
-        std::string serialized = serializeCredentials();
-        Crypto::EncryptedData encrypted = Crypto::encrypt(serialized, masterPassword);
-        std::vector<uint8_t> fileData = Crypto::serialize(encrypted);
-        
-        std::ofstream file(vaultFilePath, std::ios::binary);
-        if (!file) return false;
-        
-        file.write(reinterpret_cast<const char*>(fileData.data()), fileData.size());
-        return file.good();
+        encrypted = Crypto::deserializeView(file.data(), file.size());
+        return true;
         
     } catch (const std::exception& e) {
-        std::cerr << "Error saving vault: " << e.what() << std::endl;
+        std::cerr << "Error loading vault: " << e.what() << std::endl;
         return false;
     }
 }
 
-bool PasswordManager::loadVault() {
+bool PasswordManager::loadCredentials(MappedFile& file, const Crypto::EncryptedView& encrypted) {
+    Trace::Scope trace(Trace::Phase::Load);
     try {
-        std::ifstream file(vaultFilePath, std::ios::binary);
-        if (!file) return false;
+        // The store may point into the old mapping; drop it first
+        credentials.clear();
+        snapshotFile = std::move(file);
         
-        // Read entire file
-        file.seekg(0, std::ios::end);
-        size_t fileSize = file.tellg();
-        file.seekg(0, std::ios::beg);
+        if (encrypted.version >= 3) {
+            cipherSuite = encrypted.cipherSuite;
+            Crypto::SecureBuffer dataKey = Crypto::unwrapKey(sessionKey, encrypted.wrappedKey,
+                                                             cipherSuite);
+            if (dataKey.empty()) {
+                throw std::runtime_error("Data key is not authentic");
+            }
+            wrappedDataKey = encrypted.wrappedKey.toVector();
+            useDataKey(dataKey);
+            
+            // Secrets stay sealed in the mapping; the store keeps offsets
+            credentials.attachExternal(reinterpret_cast<const char*>(encrypted.secrets.data),
+                                       encrypted.secrets.size);
+            std::vector<uint8_t> aad = labelledAad(INDEX_AAD_LABEL, sizeof(INDEX_AAD_LABEL) - 1,
+                                                   encrypted.iv.data, encrypted.iv.size);
+            
+            if (encrypted.version >= 4) {
+                boundedLoad = exceedsMemoryLimit(
+                    encrypted.ciphertext.size * STORE_BYTES_PER_INDEX_BYTE +
+                    Crypto::streamBufferSize());
+                loadIndexStream(encrypted.ciphertext, aad, encrypted.secrets.size,
+                                boundedLoad ? Crypto::STREAM_CHUNK_SIZE
+                                            : Crypto::STREAM_BATCH_BYTES);
+                if (boundedLoad) {
+                    // The sealed index is not read again
+                    snapshotFile.release(encrypted.ciphertext.data - snapshotFile.data(),
+                                         encrypted.ciphertext.size);
+                }
+            } else {
+                // Version 3 seals the whole index as one record
+                Crypto::SecureBuffer index;
+                if (!dataCipher->open(encrypted.ciphertext.data, encrypted.ciphertext.size,
+                                      aad.data(), aad.size(), index)) {
+                    throw std::runtime_error("Vault index is not authentic");
+                }
+                deserializeCredentials(std::string_view(reinterpret_cast<const char*>(index.data()),
+                                                        index.size()),
+                                       encrypted.secrets.size);
+            }
+            
+            snapshotId = encrypted.iv.toVector();
+            replayJournal(JOURNAL_FORMAT_VERSION);
+            return true;
+        }
         
-        std::vector<uint8_t> fileData(fileSize);
-        file.read(reinterpret_cast<char*>(fileData.data()), fileSize);
+        // Older vaults hold every password in one payload under the
+        // password-derived key: seal them one by one under a new data key,
+        // with the suite a new vault on this host would get
+        Crypto::SecureBuffer decrypted;
+        size_t length = Crypto::decrypt(encrypted, sessionKey, decrypted);
+        cipherSuite = Crypto::preferredCipherSuite();
+        Crypto::SecureBuffer dataKey = Crypto::generateSecureKey();
+        wrappedDataKey = Crypto::wrapKey(sessionKey, dataKey, cipherSuite);
+        useDataKey(dataKey);
+        deserializeCredentials(std::string_view(reinterpret_cast<const char*>(decrypted.data()),
+                                                length),
+                               0);
+        decrypted.clear();
         
-        if (!file.good()) return false;
+        snapshotId = encrypted.iv.toVector();
+        snapshotFile.close(); // Nothing points into the old payload
+        replayJournal(LEGACY_JOURNAL_VERSION);
         
-        // Deserialize and decrypt
-        Crypto::EncryptedData encrypted = Crypto::deserialize(fileData);
+        // unlock() rewrites it in the envelope format once the password
+        // has been checked against the AUTH_DATA block
+        return true;
         
-        if (isLocked) {
-            // Just load auth data for password verification
-            authData = encrypted;
-            return true;
+    } catch (const std::exception& e) {
+        // A legacy vault without a key check fails here on a wrong password
+        if (!encrypted.keyCheck.empty()) {
+            std::cerr << "Error loading vault: " << e.what() << std::endl;
+        }
+        return false;
+    }
+}
+
+void PasswordManager::loadIndexStream(Crypto::ByteSpan stream, const std::vector<uint8_t>& aad,
+                                      size_t secretsSize, size_t batchBytes) {
+    // Each chunk is parsed as soon as it is opened; only a chunk and the
+    // tail of a record cut at its end are ever held in plaintext
+    RecordCursor cursor;
+    cursor.sizeHint = stream.size;
+    Crypto::SecureString pending;
+    pending.reserve(2 * Crypto::STREAM_CHUNK_SIZE);
+    Trace::Total parsing(Trace::Phase::Parse);
+    
+    Crypto::StreamDecryptor decryptor(*dataCipher, aad, [&](const uint8_t* data, size_t size) {
+        Trace::Total::Lap lap(parsing);
+        pending.append(reinterpret_cast<const char*>(data), size);
+        size_t consumed = parseCredentialRecords(pending, cursor);
+        pending.erase(0, consumed);
+    }, batchBytes);
+    decryptor.update(stream.data, stream.size);
+    decryptor.finish();
+    
+    bool complete = cursor.started && cursor.remaining == 0 && pending.empty();
+    if (!complete) {
+        throw std::runtime_error("Truncated credential index");
+    }
+    if (cursor.version == RECORD_FORMAT_VERSION && cursor.secretOffset != secretsSize) {
+        throw std::runtime_error("Sealed secrets do not match the index");
+    }
+}
+
+std::string PasswordManager::journalPath() const {
+    return vaultFilePath + ".journal";
+}
+
+std::vector<uint8_t> PasswordManager::journalAad(uint64_t sequence) const {
+    std::vector<uint8_t> aad(snapshotId);
+    for (int shift = 0; shift < 64; shift += 8) {
+        aad.push_back((sequence >> shift) & 0xFF);
+    }
+    return aad;
+}
+
+bool PasswordManager::appendJournal(uint8_t op, std::string_view service,
+                                    std::string_view username, std::string_view secret) {
+    try {
+        // Record: [op][service][username][sealed secret], fields as in snapshots
+        Crypto::SecureString record;
+        record.push_back(static_cast<char>(op));
+        appendField(record, service);
+        if (op == JOURNAL_PUT) {
+            appendField(record, username);
+            appendField(record, secret);
         }
         
-        std::string decrypted = Crypto::decrypt(encrypted, masterPassword);
-        deserializeCredentials(decrypted);
+        std::vector<uint8_t> aad = journalAad(journalSequence);
+        std::vector<uint8_t> sealed = journalCipher->seal(
+            reinterpret_cast<const uint8_t*>(record.data()), record.size(), aad.data(), aad.size());
+        record.clear();
         
+        // A fresh journal starts with a header naming its snapshot
+        std::string frame;
+        if (journalBytes == 0) {
+            frame.append(JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC));
+            appendFixed(frame, JOURNAL_FORMAT_VERSION, 4);
+            appendFixed(frame, snapshotId.size(), 4);
+            frame.append(snapshotId.begin(), snapshotId.end());
+        }
+        appendFixed(frame, sealed.size(), 4);
+        frame.append(sealed.begin(), sealed.end());
+        
+        if (!openJournal()) return false;
+        
+        bool written = writeAll(journalFd, frame.data(), frame.size());
+        if (!written || (durability == Durability::Full && !syncFile(journalFd))) {
+            // Never leave a torn frame for later appends to land behind,
+            // nor a record the caller is told did not happen
+            if (ftruncate(journalFd, journalBytes) != 0) {
+                std::cerr << "Error writing journal: could not roll back partial record" << std::endl;
+            }
+            return false;
+        }
+        
+        journalBytes += frame.size();
+        ++journalSequence;
+        if (durability == Durability::GroupCommit) {
+            markJournalDirty();
+        }
         return true;
         
     } catch (const std::exception& e) {
-        std::cerr << "Error loading vault: " << e.what() << std::endl;
+        std::cerr << "Error writing journal: " << e.what() << std::endl;
         return false;
     }
 }
 
+void PasswordManager::compactJournalIfDue() {
+    if (journalBytes >= journalCompactionThreshold) {
+        saveVault();
+    }
+}
+
+bool PasswordManager::openJournal() {
+    if (journalFd >= 0) return true;
+    
+    // A journal for an older snapshot (or a torn one) is started over
+    bool fresh = (journalBytes == 0);
+    int flags = O_WRONLY | O_CREAT | O_APPEND | (fresh ? O_TRUNC : 0);
+    int fd = ::open(journalPath().c_str(), flags, 0600);
+    if (fd < 0) {
+        std::cerr << "Error writing journal: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    if (fresh && durability != Durability::None && !syncParentDirectory(journalPath())) {
+        ::close(fd);
+        return false;
+    }
+    
+    std::lock_guard<std::mutex> guard(journalMutex);
+    journalFd = fd;
+    return true;
+}
+
+void PasswordManager::closeJournal() {
+    std::lock_guard<std::mutex> guard(journalMutex);
+    if (journalFd < 0) return;
+    
+    if (journalDirty) {
+        syncFile(journalFd);
+        journalDirty = false;
+    }
+    ::close(journalFd);
+    journalFd = -1;
+}
+
+void PasswordManager::markJournalDirty() {
+    std::lock_guard<std::mutex> guard(journalMutex);
+    if (!flusherThread.joinable()) {
+        flusherThread = std::thread(&PasswordManager::flusherLoop, this);
+    }
+    if (!journalDirty) {
+        journalDirty = true;
+        journalCv.notify_one();
+    }
+}
+
+void PasswordManager::flusherLoop() {
+    std::unique_lock<std::mutex> guard(journalMutex);
+    while (!flusherStop) {
+        journalCv.wait(guard, [this] { return flusherStop || journalDirty; });
+        if (flusherStop) break;
+        
+        // Let the rest of the burst land, then sync it all at once
+        journalCv.wait_for(guard, groupCommitWindow, [this] { return flusherStop; });
+        if (journalDirty && journalFd >= 0) {
+            syncFile(journalFd);
+        }
+        journalDirty = false;
+    }
+}
+
+void PasswordManager::setDurability(Durability level, std::chrono::milliseconds window) {
+    // Anything appended under the old level is synced before switching
+    flush();
+    durability = level;
+    groupCommitWindow = window;
+}
+
+bool PasswordManager::flush() {
+    std::lock_guard<std::mutex> guard(journalMutex);
+    if (!journalDirty || journalFd < 0) return true;
+    
+    journalDirty = false;
+    return syncFile(journalFd);
+}
+
+void PasswordManager::replayJournal(uint32_t version) {
+    Trace::Scope trace(Trace::Phase::ReplayJournal);
+    closeJournal();
+    journalSequence = 0;
+    journalBytes = 0;
+    
+    // Records are sealed, so they can be read straight from the mapping
+    MappedFile file;
+    if (!file.open(journalPath())) return;
+    const char* data = reinterpret_cast<const char*>(file.data());
+    size_t fileSize = file.size();
+    
+    RecordReader reader(data, fileSize);
+    try {
+        if (std::string(reader.take(sizeof(JOURNAL_MAGIC)), sizeof(JOURNAL_MAGIC)) !=
+                std::string(JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC)) ||
+            reader.readFixed(4) != version) {
+            return;
+        }
+        uint32_t idSize = reader.readFixed(4);
+        const uint8_t* id = reinterpret_cast<const uint8_t*>(reader.take(idSize));
+        if (idSize != snapshotId.size() || !std::equal(snapshotId.begin(), snapshotId.end(), id)) {
+            // Left over from before the last compaction; the snapshot has it all
+            return;
+        }
+    } catch (const std::exception&) {
+        return;
+    }
+    
+    // Legacy journals predate the data key and cipher suites: their
+    // records are sealed with AES-256-GCM under a subkey of the session key
+    std::unique_ptr<Crypto::Cipher> legacyCipher;
+    if (version == LEGACY_JOURNAL_VERSION) {
+        legacyCipher.reset(new Crypto::Cipher(
+            Crypto::deriveSubkey(sessionKey, JOURNAL_KEY_LABEL), Crypto::CipherSuite::Aes256Gcm));
+    }
+    const Crypto::Cipher& cipher = legacyCipher ? *legacyCipher : *journalCipher;
+    size_t validBytes = reader.consumed(data);
+    Crypto::SecureString record;
+    while (!reader.atEnd()) {
+        // Only a frame cut short at the end of the file is an append that
+        // was interrupted; it is dropped below
+        if (reader.remaining() < 4) break;
+        uint32_t sealedSize = reader.readFixed(4);
+        if (reader.remaining() < sealedSize) break;
+        const char* sealed = reader.take(sealedSize);
+        
+        // A complete frame that does not open is damage, not a torn
+        // append: refuse to load rather than drop it and what follows
+        auto damaged = [&]() {
+            return std::runtime_error("journal record " + std::to_string(journalSequence + 1) +
+                                      " is corrupt; move " + journalPath() +
+                                      " aside to open the snapshot without it");
+        };
+        std::vector<uint8_t> aad = journalAad(journalSequence);
+        if (!cipher.open(reinterpret_cast<const uint8_t*>(sealed), sealedSize,
+                         aad.data(), aad.size(), record)) {
+            throw damaged();
+        }
+        
+        try {
+            RecordReader fields(record.data(), record.size());
+            uint8_t op = static_cast<uint8_t>(fields.readFixed(1));
+            std::string_view service = fields.readField();
+            if (op == JOURNAL_PUT && !service.empty()) {
+                std::string_view username = fields.readField();
+                std::string_view secret = fields.readField();
+                if (version == LEGACY_JOURNAL_VERSION) {
+                    credentials.put(service, username, sealSecret(service, secret));
+                } else {
+                    credentials.put(service, username, secret);
+                }
+            } else if (op == JOURNAL_REMOVE) {
+                credentials.erase(service);
+            } else {
+                throw std::runtime_error("unknown operation");
+            }
+        } catch (const std::runtime_error&) {
+            throw damaged();
+        }
+        record.clear();
+        
+        ++journalSequence;
+        validBytes = reader.consumed(data);
+    }
+    file.close();
+    
+    // Drop a torn tail so new records follow the last good one
+    journalBytes = validBytes;
+    if (validBytes < fileSize && truncate(journalPath().c_str(), validBytes) != 0) {
+        std::cerr << "Error loading vault: could not trim journal" << std::endl;
+    }
+}
+
 void PasswordManager::clearSensitiveData() {
-    Utils::secureErase(masterPassword);
+    // Locking discards an open transaction along with everything else
+    if (inTransaction) {
+        undoLog.clear();
+        inTransaction = false;
+        journaling = journalingBeforeTransaction;
+    }
+    closeJournal();
+    sessionKey.clear();
+    dataCipher.reset();
+    wrappedDataKey.clear();
+    journalCipher.reset();
+    revealedPassword = Crypto::SecureString();
+    legacyAuth = Crypto::EncryptedData();
+    snapshotId.clear();
+    journalSequence = 0;
+    journalBytes = 0;
+    vaultSalt.clear();
     credentials.clear();
+    snapshotFile.close();
+    // Every secret block is wiped as it is freed; hand the emptied pages back
+    Crypto::secureArena().trim();
 }
 
 std::pair<int, std::string> PasswordManager::validatePasswordStrength(const std::string& password) {
@@ -2,50 +2,341 @@
 #define VAULT_HPP
 
 #include "crypto.hpp"
+#include "store.hpp"
+#include "mapped_file.hpp"
 #include <string>
+#include <string_view>
 #include <vector>
-#include <map>
 #include <memory>
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <unordered_map>
 
 namespace Vault {
+    // Journal size at which mutations are folded into a new snapshot
+    const size_t JOURNAL_COMPACTION_BYTES = 1024 * 1024;
+
+    // Default upper bound on how long a mutation may stay unsynced
+    const std::chrono::milliseconds DEFAULT_GROUP_COMMIT_WINDOW(50);
+
+    // How long a mutation waits for the disk
+    enum class Durability {
+        None,        // Never fsync; the OS writes data back when it likes
+        GroupCommit, // A background flush syncs each burst once per window
+        Full         // fsync before every mutation returns
+    };
+
     // Structure to represent a credential entry
     struct Credential {
         std::string service;
         std::string username;
-        std::string password;
+        Crypto::SecureString password;
         
         Credential() = default;
-        Credential(const std::string& srv, const std::string& user, const std::string& pass)
+        Credential(const std::string& srv, const std::string& user, std::string_view pass)
             : service(srv), username(user), password(pass) {}
     };
 
+    /**
+     * A credential with its password decrypted. The views stay valid until
+     * the next lookup, mutation or lock().
+     */
+    struct CredentialView {
+        std::string_view service;
+        std::string_view username;
+        std::string_view password;
+
+        explicit operator bool() const { return !service.empty(); }
+    };
+
+    /**
+     * Service and username of a stored credential, without its password.
+     * The views stay valid until the next mutation or lock().
+     */
+    struct CredentialSummary {
+        std::string_view service;
+        std::string_view username;
+    };
+
+    /**
+     * Memory held by an unlocked vault, in bytes. The store and undo log
+     * are counted from their allocated capacity; heapInUse and the peaks
+     * come from Memory accounting and are 0 when it is compiled out.
+     */
+    struct MemoryUsage {
+        StoreMemory store;          // Credential store
+        Crypto::SecureArena::Usage secure;  // Locked memory for keys and plaintext
+        size_t transaction = 0;     // Undo log of the open transaction
+        size_t snapshot = 0;        // Mapped snapshot file (page cache, not heap)
+        size_t heapInUse = 0;       // Whole process heap
+        size_t resident = 0;        // Whole process resident set
+        size_t unlockPeak = 0;      // Process heap high-water mark during the last unlock
+        size_t savePeak = 0;        // Process heap high-water mark during the last save
+        size_t limit = 0;           // Memory cap, 0 if none
+        bool boundedLoad = false;   // The last load took the bounded-memory path
+        bool boundedSave = false;   // The last save took the bounded-memory path
+    };
+
+    /**
+     * Memory cap from the SPM_MEMORY_LIMIT environment variable: a byte
+     * count with an optional K, M or G suffix, e.g. "64M"
+     * @return Limit in bytes, 0 if unset
+     * @throws std::invalid_argument if set but malformed
+     */
+    size_t defaultMemoryLimit();
+
     // Password Manager class
     class PasswordManager {
     private:
         std::string vaultFilePath;
-        std::string masterPassword;
-        std::map<std::string, Credential> credentials;
+        Crypto::SecureBuffer sessionKey;   // Derived once per unlock, wiped on lock
+        std::vector<uint8_t> vaultSalt;    // Salt sessionKey was derived with
+        Crypto::KdfParams kdfParams;       // KDF sessionKey was derived with
+        CredentialStore credentials;       // Index in the clear, passwords sealed
         bool isLocked;
-        Crypto::EncryptedData authData; // Used to verify master password
+
+        // Envelope encryption: every password is sealed on its own under a
+        // random data key, which is stored wrapped under sessionKey
+        std::unique_ptr<Crypto::Cipher> dataCipher;  // Data key; seals secrets and the index
+        std::vector<uint8_t> wrappedDataKey;
+        Crypto::CipherSuite cipherSuite;        // AEAD of the data key, secrets, index and journal
+        MappedFile snapshotFile;                // Loaded snapshot; sealed secrets are read in place
+        Crypto::EncryptedData legacyAuth;       // AUTH_DATA of a text payload, until unlock checks it
+        mutable Crypto::SecureString revealedPassword;  // Backs the last getCredential() view
+
+        // Append-only journal of mutations since the last snapshot
+        std::unique_ptr<Crypto::Cipher> journalCipher;  // Subkey sealing journal records
+        std::vector<uint8_t> snapshotId;   // IV of the snapshot the journal extends
+        uint64_t journalSequence;          // Number of the next journal record
+        size_t journalBytes;               // Current journal file size, 0 if none
+        size_t journalCompactionThreshold;
+        bool journaling;                   // Mutations are appended to the journal
+        int journalFd;                     // Open for appends while unlocked, else -1
+
+        // Durability of journal appends and snapshot writes
+        Durability durability;
+        std::chrono::milliseconds groupCommitWindow;
+        std::mutex journalMutex;           // Guards journalFd against the flusher
+        std::condition_variable journalCv;
+        std::thread flusherThread;
+        bool journalDirty;                 // Appended data not yet synced
+        bool flusherStop;
+
+        // Memory cap and what the last unlock and save used
+        size_t memoryLimit;                // 0 if none
+        size_t unlockPeakBytes;
+        size_t savePeakBytes;
+        bool boundedLoad;                  // Last load took the bounded-memory path
+        bool boundedSave;                  // Last save took the bounded-memory path
+
+        // Open transaction: changes are made in the store and journaling is
+        // off; each touched service keeps its state from before the first
+        // change so rollback() can restore it
+        struct UndoEntry {
+            bool existed = false;
+            std::string username;
+            std::string secret;            // Sealed
+        };
+        bool inTransaction;
+        bool journalingBeforeTransaction;
+        std::unordered_map<std::string, UndoEntry> undoLog;
 
         /**
-         * Serialize credentials to JSON-like string format
-         * @return String representation of all credentials
+         * Remember a service's current state, if this is the first change
+         * to it in the open transaction
+         * @param service Service about to change
          */
-        std::string serializeCredentials() const;
+        void recordUndo(const std::string& service);
 
         /**
-         * Deserialize credentials from JSON-like string format
+         * Estimate the heap the undo log holds
+         * @return Size in bytes
+         */
+        size_t undoLogSize() const;
+
+        /**
+         * Decide whether a load or save should take the bounded-memory path
+         * @param bytes Heap the vault would hold with full-size buffers
+         * @return true if that passes the memory cap
+         */
+        bool exceedsMemoryLimit(size_t bytes) const {
+            return memoryLimit != 0 && bytes > memoryLimit;
+        }
+
+        struct RecordCursor;
+        friend struct RecordFormat;
+
+        /**
+         * Compute the sizes serializeCredentials() and the secrets section
+         * will have, without serializing anything
+         * @param indexSize Receives the index size in bytes
+         * @param secretsSize Receives the total size of the sealed secrets
+         */
+        void measureCredentials(size_t& indexSize, size_t& secretsSize) const;
+
+        /**
+         * Serialize the credential index to the binary record format: a
+         * fixed header followed by varint length-prefixed records. The
+         * output is produced in chunk-sized pieces; the sealed secrets
+         * follow the index in the same order.
+         * @param sink Receives the index
+         */
+        void serializeCredentials(const Crypto::ChunkSink& sink) const;
+
+        /**
+         * Parse as many complete index records as `data` holds, so an index
+         * can be loaded as it is decrypted
+         * @param data Index bytes following those already consumed
+         * @param cursor Parsing progress, carried between calls
+         * @return Bytes of data consumed
+         */
+        size_t parseCredentialRecords(std::string_view data, RecordCursor& cursor);
+
+        /**
+         * Deserialize credentials in a single pass over the buffer. Accepts
+         * the index format, whose secrets live in snapshotSecrets, as well as
+         * the older record and text formats with plaintext passwords, which
+         * are sealed as they are loaded.
+         * @param data Serialized credentials
+         * @param secretsSize Size of the sealed secrets an index refers to
+         */
+        void deserializeCredentials(std::string_view data, size_t secretsSize);
+
+        /**
+         * Decrypt and load an index sealed as a chunked stream
+         * @param stream Sealed index
+         * @param aad Additional data it was sealed with
+         * @param secretsSize Size of the sealed secrets it refers to
+         * @param batchBytes Most plaintext to decrypt at a time
+         */
+        void loadIndexStream(Crypto::ByteSpan stream, const std::vector<uint8_t>& aad,
+                             size_t secretsSize, size_t batchBytes);
+
+        /**
+         * Set up the data and journal ciphers for a data key, under the
+         * current cipher suite
+         * @param dataKey Unwrapped data key
+         */
+        void useDataKey(const Crypto::SecureBuffer& dataKey);
+
+        /**
+         * Seal one password under the data key, bound to its service name
+         * @param service Service name
+         * @param password Plaintext password
+         * @return Sealed secret
+         */
+        std::string sealSecret(std::string_view service, std::string_view password) const;
+
+        /**
+         * Decrypt the secret of a stored credential
+         * @param stored Credential as held by the store
+         * @param password Receives the plaintext password
+         * @return true if the secret is authentic
+         */
+        bool openSecret(const StoredCredential& stored, Crypto::SecureString& password) const;
+
+        /**
+         * Parse the line-oriented text format written by older versions,
+         * keeping its AUTH_DATA block in legacyAuth
          * @param data String containing serialized credentials
+         * @throws std::runtime_error if the auth or credentials block is missing
          */
-        void deserializeCredentials(const std::string& data);
+        void deserializeLegacyCredentials(std::string_view data);
 
         /**
-         * Create authentication data for password verification
+         * Check a text payload's AUTH_DATA block against the password; the
+         * block is discarded either way
          * @param password Master password
-         * @return Encrypted authentication data
+         * @return true if the block opens to the known plaintext
+         */
+        bool verifyLegacyAuth(const std::string& password);
+
+        /**
+         * Rewrite a verified legacy vault in the envelope format, keeping
+         * the original file (and journal) next to it with a ".v1" suffix
+         * @return true if the copy was kept and the new snapshot saved
+         */
+        bool migrateLegacyVault();
+
+        /**
+         * Path of the journal file kept next to the vault snapshot
+         */
+        std::string journalPath() const;
+
+        /**
+         * Additional authenticated data for a journal record: binds it to
+         * the current snapshot and to its position in the journal
+         * @param sequence Record number
+         */
+        std::vector<uint8_t> journalAad(uint64_t sequence) const;
+
+        /**
+         * Append one sealed mutation record to the journal. Mutations call
+         * it before changing the store, so a failed append changes nothing.
+         * @param op Journal operation (put or remove)
+         * @param service Service name
+         * @param username Username (ignored for removals)
+         * @param secret Sealed password (ignored for removals)
+         * @return true if the record was written (and synced, if durability
+         *         asks for it); false leaves the journal as it was
+         */
+        bool appendJournal(uint8_t op, std::string_view service,
+                           std::string_view username, std::string_view secret);
+
+        /**
+         * Fold the journal into a new snapshot once it passes the size
+         * threshold. The mutations are already durable in the journal, so
+         * a failed save is reported and retried after the next append.
+         */
+        void compactJournalIfDue();
+
+        /**
+         * Open the journal for appending, creating it if needed
+         * @return true if journalFd is usable
+         */
+        bool openJournal();
+
+        /**
+         * Sync any pending appends and close the journal descriptor
+         */
+        void closeJournal();
+
+        /**
+         * Record that appended data awaits the group-commit flusher
+         */
+        void markJournalDirty();
+
+        /**
+         * Background loop that syncs each burst of appends once per window
+         */
+        void flusherLoop();
+
+        /**
+         * Apply the journal records belonging to the loaded snapshot. Stops
+         * at the first torn or unauthentic record and cuts the file there.
+         * @param version Journal format the snapshot's journal was written in
+         */
+        void replayJournal(uint32_t version);
+
+        /**
+         * Map and parse the vault file container without copying it
+         * @param file Receives the mapping
+         * @param encrypted Receives the parsed container, pointing into file
+         * @return true if the file could be mapped and parsed
          */
-        Crypto::EncryptedData createAuthData(const std::string& password) const;
+        bool readVaultFile(MappedFile& file, Crypto::EncryptedView& encrypted) const;
+
+        /**
+         * Unwrap the data key and load the credential index of a container.
+         * Older containers are decrypted whole and rewritten in the current
+         * format.
+         * @param file Mapping the container points into; kept as snapshotFile
+         * @param encrypted Parsed vault container
+         * @return true if successful
+         */
+        bool loadCredentials(MappedFile& file, const Crypto::EncryptedView& encrypted);
 
     public:
         /**
@@ -54,15 +345,37 @@ namespace Vault {
          */
         explicit PasswordManager(const std::string& vaultPath = "vault.dat");
 
+        /**
+         * Destructor: syncs pending journal appends and stops the flusher
+         */
+        ~PasswordManager();
+
         /**
          * Initialize vault with master password (for new vault)
          * @param password Master password
+         * @param suite AEAD to seal the vault with; by default the fastest
+         *        one on this CPU
+         * @param kdf KDF for the master password, e.g. from calibrateKdf()
          * @return true if successful, false if vault already exists
          */
-        bool initializeVault(const std::string& password);
+        bool initializeVault(const std::string& password,
+                             Crypto::CipherSuite suite = Crypto::preferredCipherSuite(),
+                             const Crypto::KdfParams& kdf = Crypto::KdfParams());
+
+        /**
+         * Derive the master key with a different KDF or cost. Only the
+         * wrapped data key and the header change, so no secret is
+         * re-encrypted; the new snapshot is saved straight away.
+         * @param password Master password, checked against the session key
+         * @param kdf New KDF parameters
+         * @return true if successful, false if locked or the password is wrong
+         */
+        bool updateKdf(const std::string& password, const Crypto::KdfParams& kdf);
 
         /**
-         * Unlock vault with master password
+         * Unlock vault with master password. The file is read once, the key
+         * derived once and checked against the header, and only the index
+         * decrypted; passwords stay sealed until getCredential().
          * @param password Master password
          * @return true if successful, false if incorrect password
          */
@@ -97,18 +410,61 @@ namespace Vault {
                           const std::string& password);
 
         /**
-         * Get a credential by service name
+         * Add or update many credentials, in order, so a later entry for a
+         * service replaces an earlier one. Passwords are sealed on all
+         * crypto threads before the store is touched.
+         * @param batch Credentials to add; entries without a service name
+         *        are skipped
+         * @return true if every entry was added
+         */
+        bool addCredentials(const std::vector<Credential>& batch);
+
+        /**
+         * Get a credential by service name, decrypting only its password.
+         * The view stays valid until the next lookup, mutation or lock().
+         * @param service Service name
+         * @return View of the credential, empty view if not found
+         */
+        CredentialView getCredential(std::string_view service) const;
+
+        /**
+         * Copy a credential into caller-owned buffers. Unlike getCredential()
+         * this keeps no state, so any number of threads may call it at once
+         * while nothing modifies the vault.
          * @param service Service name
-         * @return Credential if found, empty credential if not found
+         * @param username Receives the username
+         * @param password Receives the password
+         * @return true if found
          */
-        Credential getCredential(const std::string& service) const;
+        bool readCredential(std::string_view service, std::string& username,
+                            Crypto::SecureString& password) const;
+
+        /**
+         * Check whether a credential exists, without decrypting anything
+         * @param service Service name
+         * @return true if present
+         */
+        bool hasCredential(std::string_view service) const;
 
         /**
          * Get all service names
-         * @return Vector of service names
+         * @return Vector of service names, sorted
          */
         std::vector<std::string> getServices() const;
 
+        /**
+         * Visit every credential in service-name order in a single pass,
+         * without copies and without exposing passwords
+         * @param visit Callable taking a const CredentialSummary&
+         */
+        template <typename Visitor>
+        void forEachCredential(Visitor&& visit) const {
+            if (isLocked) return;
+            credentials.forEachSorted([&](const StoredCredential& cred) {
+                visit(CredentialSummary{cred.service, cred.username});
+            });
+        }
+
         /**
          * Remove a credential by service name
          * @param service Service name
@@ -117,17 +473,115 @@ namespace Vault {
         bool removeCredential(const std::string& service);
 
         /**
-         * Save current credentials to encrypted vault file
+         * Write all credentials as a new encrypted snapshot and discard the
+         * journal. Mutations call this only when compacting the journal.
+         * Refused while a transaction is open; commit() saves instead.
          * @return true if successful
          */
         bool saveVault();
 
         /**
-         * Load credentials from encrypted vault file
+         * Start staging changes. Until commit() or rollback(), mutations
+         * change memory only and are visible to lookups straight away.
+         * @return false if locked or a transaction is already open
+         */
+        bool beginTransaction();
+
+        /**
+         * Persist every staged change with a single saveVault(). If the
+         * save fails, the changes are rolled back, so either all of them
+         * reach disk or none do.
+         * @return true if the changes were saved
+         */
+        bool commit();
+
+        /**
+         * Discard every staged change, restoring the credentials as they
+         * were at beginTransaction()
+         */
+        void rollback();
+
+        /**
+         * @return true while a transaction is open
+         */
+        bool isInTransaction() const { return inTransaction; }
+
+        /**
+         * Load credentials from the encrypted snapshot and replay the journal.
+         * Refused while a transaction is open.
          * @return true if successful
          */
         bool loadVault();
 
+        /**
+         * Set the journal size that triggers compaction into a new snapshot
+         * @param bytes Threshold in bytes (0 compacts on every mutation)
+         */
+        void setJournalCompactionThreshold(size_t bytes) { journalCompactionThreshold = bytes; }
+
+        /**
+         * Turn journal appends on or off. While off, mutations only change
+         * memory: they reach disk with the next saveVault() and are lost if
+         * the vault is locked first. Bulk updates use this to pay for one
+         * snapshot instead of one journal record per change.
+         * @param enabled false to defer every mutation to saveVault()
+         */
+        void setJournaling(bool enabled) { journaling = enabled; }
+
+        /**
+         * Choose how mutations and snapshots are made durable. Snapshots are
+         * always replaced atomically (temp file + rename); the level decides
+         * whether files and directories are fsynced along the way.
+         * @param level Durability level
+         * @param window Longest a mutation stays unsynced under GroupCommit
+         */
+        void setDurability(Durability level,
+                           std::chrono::milliseconds window = DEFAULT_GROUP_COMMIT_WINDOW);
+
+        /**
+         * Make every mutation so far durable, without waiting for the window
+         * @return true if successful
+         */
+        bool flush();
+
+        /**
+         * Get the size of the journal on disk
+         * @return Journal size in bytes, 0 if there is none
+         */
+        size_t getJournalSize() const { return journalBytes; }
+
+        /**
+         * Cipher suite of the unlocked vault
+         */
+        Crypto::CipherSuite getCipherSuite() const { return cipherSuite; }
+
+        /**
+         * KDF parameters of the unlocked vault
+         */
+        const Crypto::KdfParams& getKdfParams() const { return kdfParams; }
+
+        /**
+         * Cap the memory a load or save plans for. One whose footprint
+         * with full-size buffers would pass the cap takes the bounded-memory
+         * path instead: index chunks are sealed and opened one at a time on
+         * one thread, and snapshot pages are dropped from memory once read.
+         * The cap steers that choice; it is not enforced.
+         * @param bytes Limit in bytes (0 for none)
+         */
+        void setMemoryLimit(size_t bytes) { memoryLimit = bytes; }
+
+        /**
+         * Memory cap in bytes, 0 if none
+         */
+        size_t getMemoryLimit() const { return memoryLimit; }
+
+        /**
+         * Memory held by the vault, by subsystem, and the peaks of the
+         * last unlock and save
+         * @return Current usage
+         */
+        MemoryUsage getMemoryUsage() const;
+
         /**
          * Get total number of credentials stored
          * @return Number of credentials
@@ -147,6 +601,89 @@ namespace Vault {
         static std::pair<int, std::string> validatePasswordStrength(const std::string& password);
     };
 
+    /**
+     * The credential index format on its own, without encryption or files,
+     * for tests and benchmarks. Vault code goes through PasswordManager.
+     */
+    struct RecordFormat {
+        /**
+         * @param vault Unlocked vault
+         * @return Its index, as a snapshot holds it before encryption
+         */
+        static std::string serialize(const PasswordManager& vault);
+
+        /**
+         * @param vault Unlocked vault
+         * @return Its sealed secrets in index order, as a snapshot holds them
+         */
+        static std::string secrets(const PasswordManager& vault);
+
+        /**
+         * Replace the vault's credentials with those of a whole index
+         * @param vault Unlocked vault
+         * @param index Index, or a payload in one of the older formats
+         * @param secrets Sealed secrets the index refers to; must outlive
+         *        the vault's contents
+         * @throws std::runtime_error if the index is truncated or malformed
+         */
+        static void deserialize(PasswordManager& vault, std::string_view index,
+                                std::string_view secrets);
+
+        /**
+         * Replace the vault's credentials with the complete records at the
+         * start of an index, as a streamed load does with each chunk
+         * @param vault Unlocked vault
+         * @param data Leading part of an index
+         * @param secrets As for deserialize()
+         * @return Bytes of data consumed; a record cut off at the end is not
+         * @throws std::runtime_error if a record is malformed
+         */
+        static size_t parse(PasswordManager& vault, std::string_view data,
+                            std::string_view secrets);
+    };
+
+    /**
+     * RAII transaction: begins on construction and rolls back on
+     * destruction unless commit() succeeded
+     */
+    class Transaction {
+    public:
+        explicit Transaction(PasswordManager& manager)
+            : vault(manager), active(manager.beginTransaction()) {}
+        ~Transaction() { rollback(); }
+
+        Transaction(const Transaction&) = delete;
+        Transaction& operator=(const Transaction&) = delete;
+
+        /**
+         * @return true if the transaction began and is still open
+         */
+        bool isActive() const { return active; }
+
+        /**
+         * Save the staged changes; see PasswordManager::commit()
+         * @return true if saved; false if not active or the save failed
+         */
+        bool commit() {
+            if (!active) return false;
+            active = false;
+            return vault.commit();
+        }
+
+        /**
+         * Discard the staged changes, if still open
+         */
+        void rollback() {
+            if (!active) return;
+            active = false;
+            vault.rollback();
+        }
+
+    private:
+        PasswordManager& vault;
+        bool active;
+    };
+
     // Utility functions
     namespace Utils {
         /**